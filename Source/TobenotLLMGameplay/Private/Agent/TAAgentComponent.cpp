@@ -6,7 +6,7 @@
 
 UTAAgentComponent::UTAAgentComponent()
 {
-	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bCanEverTick = false;
 	bEnableScheduleShout = true;
     
 	// 默认喊话时间间隔范围
@@ -21,26 +21,48 @@ UTAAgentComponent::UTAAgentComponent()
 void UTAAgentComponent::BeginPlay()
 {
 	Super::BeginPlay();
-	TimeToNextShout = MaxTimeBetweenRetryShouts;
+	if(GetOwner()->GetLocalRole() == ROLE_Authority)
+	{
+		ScheduleShoutIn(MaxTimeBetweenRetryShouts);
+	}
 }
 
-void UTAAgentComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+void UTAAgentComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
-	
-	if(GetOwner()->GetLocalRole() == ROLE_Authority)
+	if (UWorld* World = GetWorld())
 	{
-		if(bEnableScheduleShout)
-		{
-			// 减少等待时间
-			TimeToNextShout -= DeltaTime;
+		World->GetTimerManager().ClearTimer(ShoutTimerHandle);
+	}
+	Super::EndPlay(EndPlayReason);
+}
 
-			// 当等待时间结束时，调用RequestSpeak并计划下一次喊话
-			if(TimeToNextShout <= 0)
-			{
-				RequestSpeak();
-			}
-		}
+void UTAAgentComponent::SetEnableScheduleShout(bool bEnable)
+{
+	bEnableScheduleShout = bEnable;
+	if (bEnable && HasBegunPlay() && GetOwner()->GetLocalRole() == ROLE_Authority)
+	{
+		ScheduleShoutIn(FMath::RandRange(MinTimeBetweenRetryShouts, MaxTimeBetweenRetryShouts));
+	}
+}
+
+void UTAAgentComponent::ScheduleShoutIn(float Seconds)
+{
+	if (UWorld* World = GetWorld())
+	{
+		World->GetTimerManager().SetTimer(ShoutTimerHandle, this, &UTAAgentComponent::OnShoutTimer, FMath::Max(Seconds, 0.01f), false);
+	}
+}
+
+void UTAAgentComponent::OnShoutTimer()
+{
+	if(bEnableScheduleShout)
+	{
+		RequestSpeak();
+	}
+	else
+	{
+		// 蓝图里可能直接改了bEnableScheduleShout，关闭期间低频看一下，打开后不会等太久
+		ScheduleShoutIn(MaxTimeBetweenRetryShouts);
 	}
 }
 
@@ -69,12 +91,12 @@ void UTAAgentComponent::RequestSpeak()
 	{
 		// 如果没有其他接收者，则立即计划一个短时的下次喊话。
 		// 因为这样子可以营造出玩家一走过去，Agent马上说话的情形。
-		TimeToNextShout = FMath::RandRange(MinTimeBetweenRetryShouts, MaxTimeBetweenRetryShouts);
+		ScheduleShoutIn(FMath::RandRange(MinTimeBetweenRetryShouts, MaxTimeBetweenRetryShouts));
 	}
 }
 
 void UTAAgentComponent::ScheduleNextShout()
 {
 	// 在配置的最小和最大时间之间随机选择下次喊话的时间
-	TimeToNextShout = FMath::RandRange(MinTimeBetweenShouts, MaxTimeBetweenShouts);
+	ScheduleShoutIn(FMath::RandRange(MinTimeBetweenShouts, MaxTimeBetweenShouts));
 }
\ No newline at end of file
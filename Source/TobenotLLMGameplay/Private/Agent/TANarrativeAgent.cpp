@@ -6,6 +6,8 @@
 
 ATANarrativeAgent::ATANarrativeAgent()
 {
+	PrimaryActorTick.bCanEverTick = false;
+	
 	// 设置默认值
 	AgentInfo.AgentName = TEXT("NarrativeAgent");
 	SystemPrompt = TEXT("Default System Prompt");
@@ -68,7 +70,7 @@ void ATANarrativeAgent::InitAgentByID(int32 NewAgentID)
 			SystemPrompt = GenerateSystemPrompt(AgentData->SystemPromptType, AgentData->SystemPromptParameters);
 
 			// 使Agent可以开始说话
-			AgentComponent->bEnableScheduleShout = true;
+			AgentComponent->SetEnableScheduleShout(true);
 
 			InitAgentByID_BP(AgentID);
 			
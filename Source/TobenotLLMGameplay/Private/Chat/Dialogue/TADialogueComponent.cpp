@@ -14,7 +14,7 @@
 
 UTADialogueComponent::UTADialogueComponent()
 {
-	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bCanEverTick = false;
 	IsPlayer = false;
 	IsRequestingMessage = false;
 }
@@ -22,14 +22,110 @@ UTADialogueComponent::UTADialogueComponent()
 void UTADialogueComponent::BeginPlay()
 {
 	Super::BeginPlay();
-	DialogueHistory.Add(FChatLog{EOAChatRole::SYSTEM,""});
-	//DialogueHistory.Add(FChatLog{EOAChatRole::SYSTEM,""});//留两个系统prompt
 }
 
 
 void UTADialogueComponent::SetCurrentDialogue(UTADialogueInstance* NewDialogueInstance)
 {
+	if (CurrentDialogueInstance == NewDialogueInstance)
+	{
+		return;
+	}
+	ArchiveCurrentDialogue();
 	CurrentDialogueInstance = NewDialogueInstance;
+	DialogueCursor = NewDialogueInstance ? NewDialogueInstance->GetNumMessages() : 0;
+}
+
+void UTADialogueComponent::ArchiveCurrentDialogue()
+{
+	if (!CurrentDialogueInstance)
+	{
+		return;
+	}
+	// 只在换对话时拷一次，平时每条消息都只存在对话实例里
+	const FString RecentDialogue = JoinDialogueHistory();
+	DialogueHistoryCompressedStr = GetDialogueHistoryCompressedStr();
+	if (!RecentDialogue.IsEmpty())
+	{
+		DialogueHistoryCompressedStr += (DialogueHistoryCompressedStr.IsEmpty() ? TEXT("") : TEXT(" ")) + RecentDialogue;
+	}
+	CurrentDialogueInstance->BuildHistoryFor(GetOwner(), DialogueCursor, PreviousDialogueHistory, true);
+	CurrentDialogueInstance = nullptr;
+	DialogueCursor = 0;
+	CompressCarriedMemoryIfNeeded();
+}
+
+void UTADialogueComponent::CompressCarriedMemoryIfNeeded()
+{
+	if (!bEnableCompressDialogue || bIsCompressingCarriedMemory || DialogueHistoryCompressedStr.Len() <= CarriedMemoryCompressLength)
+	{
+		return;
+	}
+	bIsCompressingCarriedMemory = true;
+	const int32 CompressedLength = DialogueHistoryCompressedStr.Len();
+	const int32 Serial = CarriedMemorySerial;
+
+	TArray<FChatLog> TempMessagesList;
+	TempMessagesList.Add({EOAChatRole::SYSTEM, UTALLMLibrary::PromptToStr(PromptCompressDialogueHistory)});
+	TempMessagesList.Add({EOAChatRole::USER, DialogueHistoryCompressedStr});
+
+	FChatSettings ChatSettings{
+		UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast),
+		TempMessagesList
+	};
+	ChatSettings.jsonFormat = true;
+
+	TWeakObjectPtr<UTADialogueComponent> WeakThis(this);
+	UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings,
+		[WeakThis, CompressedLength, Serial](const FChatCompletion& Message, const FString& ErrorMessage, bool bWasSuccessful)
+		{
+			UTADialogueComponent* This = WeakThis.Get();
+			if (!This || This->CarriedMemorySerial != Serial)
+			{
+				return;
+			}
+			This->bIsCompressingCarriedMemory = false;
+			if (bWasSuccessful)
+			{
+				// 压缩期间又并进来的记忆接在后面
+				This->DialogueHistoryCompressedStr = Message.message.content + This->DialogueHistoryCompressedStr.Mid(CompressedLength);
+				UE_LOG(LogTAChat, Log, TEXT("Carried dialogue memory compressed: %d -> %d"), CompressedLength, Message.message.content.Len());
+			}
+			else
+			{
+				UE_LOG(LogTAChat, Error, TEXT("Carried dialogue memory compression failed: %s"), *ErrorMessage);
+			}
+		}, GetOwner());
+}
+
+TArray<FChatLog> UTADialogueComponent::GetDialogueHistory() const
+{
+	TArray<FChatLog> History;
+	if (CurrentDialogueInstance)
+	{
+		CurrentDialogueInstance->BuildHistoryFor(GetOwner(), DialogueCursor, History);
+	}
+	return History;
+}
+
+TArray<FChatLog> UTADialogueComponent::GetFullDialogueHistory() const
+{
+	TArray<FChatLog> History = PreviousDialogueHistory;
+	if (CurrentDialogueInstance)
+	{
+		CurrentDialogueInstance->BuildHistoryFor(GetOwner(), DialogueCursor, History, true);
+	}
+	return History;
+}
+
+FString UTADialogueComponent::GetDialogueHistoryCompressedStr() const
+{
+	const FString DialogueSummary = CurrentDialogueInstance ? CurrentDialogueInstance->GetSummaryFor(DialogueCursor) : FString();
+	if (DialogueSummary.IsEmpty())
+	{
+		return DialogueHistoryCompressedStr;
+	}
+	return DialogueHistoryCompressedStr.IsEmpty() ? DialogueSummary : DialogueHistoryCompressedStr + TEXT(" ") + DialogueSummary;
 }
 
 void UTADialogueComponent::SendMessageToDialogue(const FChatCompletion& Message)
@@ -58,29 +154,33 @@ void UTADialogueComponent::RequestToSpeak()
 	{
 		return;
 	}
-	auto& TempMessagesList = DialogueHistory;
-	// 构造系统提示的ChatLog对象
+	CacheChat = SendSpeakRequest([this](const FChatCompletion& Message, bool Success)
+	{
+		CacheChat = nullptr;
+		CommitSpokenReply(Message, Success);
+	});
+}
+
+UOpenAIChat* UTADialogueComponent::SendSpeakRequest(TFunction<void(const FChatCompletion& Message, bool Success)> Callback)
+{
+	if(!CurrentDialogueInstance)
+	{
+		return nullptr;
+	}
+	// 系统提示是自己私有的，后面接上对话实例里共用的记录
+	TArray<FChatLog> TempMessagesList;
 	const FString SystemPrompt = FString::Printf(
 		TEXT(
 			"Now you are in a group conversation with [%s], You remember the conversation just now and the one before, which summary as [%s], please speak according to the conversation history."
 			)
-		, *CurrentDialogueInstance->GetParticipantsNamesStringFromAgents(), *DialogueHistoryCompressedStr) + GetSystemPromptFromOwner();
-	const FChatLog SystemPromptLog{EOAChatRole::SYSTEM, SystemPrompt};
+		, *CurrentDialogueInstance->GetParticipantsNamesStringFromAgents(), *GetDialogueHistoryCompressedStr()) + GetSystemPromptFromOwner();
+	TempMessagesList.Add(FChatLog{EOAChatRole::SYSTEM, SystemPrompt});
+	CurrentDialogueInstance->BuildHistoryFor(GetOwner(), DialogueCursor, TempMessagesList);
 
 	/*const FChatLog DialogueLog{EOAChatRole::SYSTEM, FString::Printf(
 		TEXT("Now you are in a group conversation with [%s], please speak according to the conversation history.")
 		, *CurrentDialogueInstance->GetParticipantsNamesStringFromAgents())};*/
 	
-	// 设置系统提示为TempMessagesList的首个元素
-	if(!TempMessagesList.Num() || TempMessagesList[0].role != EOAChatRole::SYSTEM)
-	{
-		TempMessagesList.Insert(SystemPromptLog,0);
-	}
-	else if(TempMessagesList[0].role == EOAChatRole::SYSTEM)
-	{
-		TempMessagesList[0] = SystemPromptLog;
-	}
-	
 	// 设置对话请求的配置
 	FChatSettings ChatSettings{
 		UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast),
@@ -89,23 +189,27 @@ void UTADialogueComponent::RequestToSpeak()
 	};
 	ChatSettings.jsonFormat = true;
 	
-	CacheChat = UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [this](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+	return UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [Callback = MoveTemp(Callback)](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
 	{
-		if (Success)
-		{
-			SendMessageToDialogue(Message);
-			if (bEnableFunctionInvoke)
-			{
-				PerformFunctionInvokeBasedOnResponse(Message.message.content);
-			}
-		}
-		else
+		Callback(Message, Success);
+	},GetOwner());
+}
+
+void UTADialogueComponent::CommitSpokenReply(const FChatCompletion& Message, bool Success)
+{
+	if (Success)
+	{
+		SendMessageToDialogue(Message);
+		if (bEnableFunctionInvoke)
 		{
-			RefuseToSay();
+			PerformFunctionInvokeBasedOnResponse(Message.message.content);
 		}
-		IsRequestingMessage = false;
-		CacheChat = nullptr;
-	},GetOwner());
+	}
+	else
+	{
+		RefuseToSay();
+	}
+	IsRequestingMessage = false;
 }
 
 void UTADialogueComponent::RefuseToSay()
@@ -116,81 +220,49 @@ void UTADialogueComponent::RefuseToSay()
 	}
 }
 
-void UTADialogueComponent::UpdateDialogueHistory(const FChatCompletion& NewChatCompletion)
+void UTADialogueComponent::ResetDialogueHistory()
 {
-	DialogueHistory.Add(NewChatCompletion.message);
-	FullDialogueHistory.Add(NewChatCompletion.message);
-	
-	if (bEnableCompressDialogue && NewChatCompletion.totalTokens > 2400)
+	CurrentDialogueInstance = nullptr;
+	DialogueCursor = 0;
+	PreviousDialogueHistory.Empty();
+	DialogueHistoryCompressedStr.Empty();
+	++CarriedMemorySerial;
+	bIsCompressingCarriedMemory = false;
+	IsRequestingMessage = false;
+}
+
+void UTADialogueComponent::RestoreDialogueHistory(const TArray<FChatLog>& History, const TArray<FChatLog>& FullHistory, const FString& CompressedStr)
+{
+	// 原来的对话实例已经不在了，没压缩的部分并进记忆里
+	CurrentDialogueInstance = nullptr;
+	DialogueCursor = 0;
+	PreviousDialogueHistory = FullHistory;
+	DialogueHistoryCompressedStr = CompressedStr;
+	for (const FChatLog& LogEntry : History)
 	{
-		RequestDialogueCompression();
+		if (LogEntry.role != EOAChatRole::SYSTEM && !LogEntry.content.IsEmpty())
+		{
+			DialogueHistoryCompressedStr += (DialogueHistoryCompressedStr.IsEmpty() ? TEXT("") : TEXT(" ")) + LogEntry.content;
+		}
 	}
+	++CarriedMemorySerial;
+	bIsCompressingCarriedMemory = false;
+	CompressCarriedMemoryIfNeeded();
 }
 
 void UTADialogueComponent::RequestDialogueCompression()
 {
-	// Implement your compression logic here. As an example, you might:
-	// - Aggregate similar messages
-	// - Remove older messages from the history
-	// - Summarize certain parts of the dialogue
-	if(bIsCompressingDialogue)
+	// 压缩由对话实例统一做，一段对话只压一次
+	if (CurrentDialogueInstance)
 	{
-		return;
+		CurrentDialogueInstance->RequestCompression();
 	}
-	bIsCompressingDialogue = true;
-	LastCompressedIndex = DialogueHistory.Num() - 1;
-	LastCompressedIndex -= 3;
-	if(LastCompressedIndex < 1)
-	{
-		LastCompressedIndex = 1;
-	}
-	const FString DialogueHistoryString = DialogueHistoryCompressedStr + JoinDialogueHistory();
-
-	// Prepare the chat message to send to OpenAI for dialogue compression
-	TArray<FChatLog> TempMessagesList;
-	const FString FormattedPrompt = UTALLMLibrary::PromptToStr(PromptCompressDialogueHistory);
-	TempMessagesList.Add({EOAChatRole::SYSTEM, FormattedPrompt});
-	TempMessagesList.Add({EOAChatRole::USER, DialogueHistoryString});
-
-	FChatSettings ChatSettings{
-		UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast),
-		TempMessagesList
-	};
-	ChatSettings.jsonFormat = true;
-
-	// Send the request asynchronously
-	UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, 
-	[this](const FChatCompletion& Message, const FString& ErrorMessage, bool bWasSuccessful)
-		{
-		if(bWasSuccessful)
-		{
-			// 在清空当前对话历史之前，保留新的历史记录
-			TArray<FChatLog> NewHistory;
-			if (DialogueHistory.Num() > LastCompressedIndex + 1)
-			{
-				NewHistory.Append(DialogueHistory.GetData() + LastCompressedIndex + 1, DialogueHistory.Num() - LastCompressedIndex - 1);
-			}
-		        
-			DialogueHistory.Empty();
-			DialogueHistoryCompressedStr = Message.message.content;
-		        
-			// 将新历史记录加回到当前对话历史
-			DialogueHistory.Append(NewHistory);
-
-			UE_LOG(LogTAChat, Log, TEXT("Dialogue compression successful: %s"), *Message.message.content);
-		}
-		else
-		{
-			UE_LOG(LogTAChat, Error, TEXT("Dialogue compression failed: %s"), *ErrorMessage);
-		}
-		bIsCompressingDialogue = false;
-		},GetOwner());
 }
 
 FString UTADialogueComponent::JoinDialogueHistory()
 {
 	FString Result;
-	for (const FChatLog& LogEntry : DialogueHistory)
+	for (const FChatLog& LogEntry : GetDialogueHistory())
 	{
 		if(LogEntry.role != EOAChatRole::SYSTEM)
 		{
@@ -204,10 +276,7 @@ FString UTADialogueComponent::JoinDialogueHistory()
 
 void UTADialogueComponent::HandleReceivedMessage(const FChatCompletion& ReceivedMessage, AActor* Sender)
 {
-	// 更新对话历史记录
-	UpdateDialogueHistory(ReceivedMessage);
-
-	// 向UI通知更新
+	// 对话记录已经在对话实例里了，这里只向UI通知更新
 	NotifyUIOfDialogueHistoryUpdate(ReceivedMessage, Sender);
 }
 
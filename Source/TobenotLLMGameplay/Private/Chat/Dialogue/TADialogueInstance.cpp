@@ -3,34 +3,20 @@
 #include "Chat/Dialogue/TADialogueInstance.h"
 
 #include "OpenAIDefinitions.h"
+#include "Algo/Count.h"
 #include "Chat/Dialogue/TADialogueComponent.h"
+#include "Chat/Dialogue/TADialogueManager.h"
 #include "Agent/TAAgentInterface.h"
 #include "Engine/World.h"
 #include "Chat/TAChatLogCategory.h"
-
-// 帮助根据说话优先级排序的结构体
-struct FParticipantPriority
-{
-	AActor* Participant;
-	int32 Priority;
-
-	FParticipantPriority(AActor* InParticipant, int32 InPriority)
-		: Participant(InParticipant)
-		, Priority(InPriority)
-	{
-	}
-
-	// 排序规则，优先级高的在前
-	bool operator<(const FParticipantPriority& Other) const
-	{
-		return Priority > Other.Priority;
-	}
-};
+#include "Common/TALLMLibrary.h"
+#include "TASettings.h"
 
 UTADialogueInstance::UTADialogueInstance()
 {
 	DialogueState = EDialogueState::WaitingForParticipants;
 	CurrentParticipantIndex = 0;
+	bEnablePipelinedTurns = GetDefault<UTASettings>()->bPipelineDialogueTurns;
 }
 
 void UTADialogueInstance::AddParticipant(AActor* Participant)
@@ -39,13 +25,13 @@ void UTADialogueInstance::AddParticipant(AActor* Participant)
 	{
 		// 如果Actor不在参与者列表中，添加到列表
 		Participants.Add(Participant);
+		RebuildRotation();
 		if (Participants.Num() >= 2 && DialogueState == EDialogueState::WaitingForParticipants)
 		{
 			DialogueState = EDialogueState::Active;
 
-			// Start the timer (e.g., every 5 seconds)
-			GetWorld()->GetTimerManager().SetTimer(DialogueTimerHandle, this, &UTADialogueInstance::CycleParticipants,
-				1.0f, true, 2.0f);
+			// 人齐了，过一会儿开始第一轮
+			WakeAfter(2.0f);
 		}
 	}
 }
@@ -56,6 +42,57 @@ void UTADialogueInstance::RemoveParticipant(AActor* Participant)
 	{
 		// 如果Actor在参与者列表中，从列表移除
 		Participants.Remove(Participant);
+		RebuildRotation();
+	}
+}
+
+void UTADialogueInstance::RebuildRotation()
+{
+	Rotation.Reset(Participants.Num());
+	for (AActor* Participant : Participants)
+	{
+		if (!Participant)
+		{
+			continue;
+		}
+		FParticipantEntry& Entry = Rotation.AddDefaulted_GetRef();
+		Entry.Actor = Participant;
+		Entry.DialogueComponent = Participant->FindComponentByClass<UTADialogueComponent>();
+		if (const ITAAgentInterface* AgentInterface = Cast<ITAAgentInterface>(Participant))
+		{
+			Entry.Priority = AgentInterface->GetAgentSpeakPriority();
+			Entry.bCanSpeak = true;
+		}
+	}
+	// 优先级高的在前，同优先级保持加入顺序
+	Rotation.StableSort([](const FParticipantEntry& A, const FParticipantEntry& B)
+	{
+		if (A.bCanSpeak != B.bCanSpeak)
+		{
+			return A.bCanSpeak;
+		}
+		return A.Priority > B.Priority;
+	});
+	const int32 NumSpeakers = Algo::CountIf(Rotation, [](const FParticipantEntry& Entry) { return Entry.bCanSpeak; });
+	if (CurrentParticipantIndex >= NumSpeakers)
+	{
+		CurrentParticipantIndex = 0;
+	}
+}
+
+void UTADialogueInstance::WakeAfter(float Delay)
+{
+	if (UTADialogueManager* DialogueManager = GetWorld() ? GetWorld()->GetSubsystem<UTADialogueManager>() : nullptr)
+	{
+		DialogueManager->ScheduleDialogueTurn(this, Delay);
+	}
+}
+
+void UTADialogueInstance::CancelWake()
+{
+	if (UTADialogueManager* DialogueManager = GetWorld() ? GetWorld()->GetSubsystem<UTADialogueManager>() : nullptr)
+	{
+		DialogueManager->CancelDialogueTurn(this);
 	}
 }
 
@@ -63,6 +100,14 @@ void UTADialogueInstance::TryEnterDialogueState(EDialogueState NewState)
 {
 	// 校验权限或者其他逻辑，在适当的条件下更新对话状态
 	DialogueState = NewState;
+	if (NewState == EDialogueState::Active)
+	{
+		WakeAfter(1.0f);
+	}
+	else
+	{
+		CancelWake();
+	}
 }
 
 void UTADialogueInstance::ReceiveMessage(const FChatCompletion& Message, AActor* Sender)
@@ -70,7 +115,30 @@ void UTADialogueInstance::ReceiveMessage(const FChatCompletion& Message, AActor*
 	// 收到消息后，将其添加到历史记录并分发给所有参与者
 	AddMessageToHistory(Message.message,Sender);
 	DistributeMessage(Message,Sender);
-	DialogueState = EDialogueState::Active;
+
+	// 只要有一个参与者开着压缩，整段对话压一次，所有人共用
+	if (Message.totalTokens > 2400)
+	{
+		for (const FParticipantEntry& Entry : Rotation)
+		{
+			const UTADialogueComponent* DialogueComponent = Entry.DialogueComponent.Get();
+			if (DialogueComponent && DialogueComponent->bEnableCompressDialogue)
+			{
+				RequestCompression();
+				break;
+			}
+		}
+	}
+	if (DialogueState != EDialogueState::End)
+	{
+		DialogueState = EDialogueState::Active;
+		WakeAfter(1.0f);
+		if (bEnablePipelinedTurns)
+		{
+			// 等待下一轮的这段时间里下一位已经在生成了
+			StartSpeculativeTurn(Sender);
+		}
+	}
 }
 
 void UTADialogueInstance::CycleParticipants()
@@ -81,94 +149,195 @@ void UTADialogueInstance::CycleParticipants()
 		return;
 	}
 
-	// 遍历所有参与者以检查他们的会话组件中的接受消息标志
-	for (AActor* Participant : Participants)
+	// 检查参与者的会话组件中的接受消息标志，有人不愿意接受消息就结束对话
+	for (const FParticipantEntry& Entry : Rotation)
 	{
-		UTADialogueComponent* DialogueComponent = Participant ? Participant->FindComponentByClass<UTADialogueComponent>() : nullptr;
+		const UTADialogueComponent* DialogueComponent = Entry.DialogueComponent.Get();
 		if (DialogueComponent && !DialogueComponent->GetAcceptMessages())
 		{
-			// 如果有参与者不愿意接受消息，结束对话
 			EndDialogue();
 			return;
 		}
 	}
 
-	// 创建一个数组用于存储带有优先级的参与者
-	TArray<FParticipantPriority> SortedParticipants;
-
-	// 遍历所有参与者并获取他们的优先级
-	for (AActor* Participant : Participants)
+	// 发言顺序在参与者变化时已经排好，能发言的排在前面
+	const int32 NumSpeakers = GetNumSpeakers();
+	if (NumSpeakers == 0)
 	{
-		if (Participant)
+		CurrentParticipantIndex = 0;
+		return;
+	}
+	
+	// 根据当前参与者索引选择下一个发言者
+	const FParticipantEntry& Speaker = Rotation[CurrentParticipantIndex % NumSpeakers];
+	CurrentParticipantIndex = (CurrentParticipantIndex + 1) % NumSpeakers;
+	
+	// 请求选择的参与者发言，等它回复或者拒绝时再被唤醒
+	if (UTADialogueComponent* DialogueComponent = Speaker.DialogueComponent.Get())
+	{
+		DialogueState = EDialogueState::WaitingForSomeOne;
+		if (!TryUseSpeculativeTurn(DialogueComponent))
 		{
-			const ITAAgentInterface* AgentInterface = Cast<ITAAgentInterface>(Participant);
-			if (AgentInterface)
-			{
-				// 获取参与者的优先级并创建FParticipantPriority结构体存入数组
-				int32 Priority = AgentInterface->GetAgentSpeakPriority();
-				SortedParticipants.Add(FParticipantPriority(Participant, Priority));
-			}
+			DialogueComponent->RequestToSpeak();
 		}
 	}
+	else
+	{
+		// 这个参与者没法发言，下一秒轮到下一个
+		WakeAfter(1.0f);
+	}
+}
 
-	// 根据优先级进行排序
-	SortedParticipants.Sort();
+void UTADialogueInstance::EndDialogue()
+{
+	DialogueState = EDialogueState::End;
+	CancelWake();
+	DiscardSpeculativeTurn();
+}
 
-	// 根据当前参与者索引选择下一个发言者
-	if (SortedParticipants.IsValidIndex(CurrentParticipantIndex))
-	{
-		// 获取选择的参与者
-		AActor* ParticipantToSpeak = SortedParticipants[CurrentParticipantIndex].Participant;
-        
-		// 请求选择的参与者发言
-		UTADialogueComponent* DialogueComponent = ParticipantToSpeak->FindComponentByClass<UTADialogueComponent>();
-		if (DialogueComponent)
+int32 UTADialogueInstance::GetNumSpeakers() const
+{
+	int32 NumSpeakers = 0;
+	while (NumSpeakers < Rotation.Num() && Rotation[NumSpeakers].bCanSpeak)
+	{
+		++NumSpeakers;
+	}
+	return NumSpeakers;
+}
+
+void UTADialogueInstance::StartSpeculativeTurn(const AActor* Sender)
+{
+	// 上一个推测是按旧的对话记录生成的，已经用不上了
+	DiscardSpeculativeTurn();
+
+	const int32 NumSpeakers = GetNumSpeakers();
+	if (NumSpeakers == 0)
+	{
+		return;
+	}
+	// 最可能的下一位就是轮换顺序里的下一个
+	const FParticipantEntry& NextSpeaker = Rotation[CurrentParticipantIndex % NumSpeakers];
+	UTADialogueComponent* DialogueComponent = NextSpeaker.DialogueComponent.Get();
+	if (!DialogueComponent || DialogueComponent->IsPlayer || !DialogueComponent->GetAcceptMessages() || NextSpeaker.Actor.Get() == Sender)
+	{
+		return;
+	}
+
+	const int32 Serial = ++SpeculationSerial;
+	SpeculativeTurn.Speaker = DialogueComponent;
+	SpeculativeTurn.PrefixCount = DialogueHistory.Num();
+	SpeculativeTurn.bInFlight = true;
+
+	TWeakObjectPtr<UTADialogueInstance> WeakThis(this);
+	SpeculativeChat = DialogueComponent->SendSpeakRequest([WeakThis, Serial](const FChatCompletion& Message, bool Success)
+	{
+		if (UTADialogueInstance* This = WeakThis.Get())
 		{
-			DialogueState = EDialogueState::WaitingForSomeOne;
-			DialogueComponent->RequestToSpeak();
+			This->OnSpeculativeReply(Serial, Message, Success);
 		}
+	});
+	if (!SpeculativeChat)
+	{
+		SpeculativeTurn = FSpeculativeTurn();
+	}
+}
 
-		// 更新当前参与者索引
-		CurrentParticipantIndex = (CurrentParticipantIndex + 1) % SortedParticipants.Num();
+void UTADialogueInstance::DiscardSpeculativeTurn()
+{
+	if (SpeculativeTurn.bInFlight || SpeculativeTurn.bReady)
+	{
+		++NumSpeculationsDiscarded;
+		UE_LOG(LogTAChat, Verbose, TEXT("Discard speculative dialogue turn conditioned on %d messages, history has %d"), SpeculativeTurn.PrefixCount, DialogueHistory.Num());
 	}
+	// 已经轮到发言者、在等回复时被丢弃，TryUseSpeculativeTurn替它置的请求标记要撤掉，不然一直当它在忙
+	if (SpeculativeTurn.bCommitOnArrival)
+	{
+		if (UTADialogueComponent* Speaker = SpeculativeTurn.Speaker.Get())
+		{
+			Speaker->IsRequestingMessage = false;
+		}
+	}
+	// 请求没法取消，序号变了之后回调会被忽略
+	++SpeculationSerial;
+	SpeculativeTurn = FSpeculativeTurn();
+	SpeculativeChat = nullptr;
+}
 
-	// 如果排序后的参与者数组为空，或者当前索引无效，则重置对话状态
-	if(SortedParticipants.Num() == 0 || !SortedParticipants.IsValidIndex(CurrentParticipantIndex))
+bool UTADialogueInstance::TryUseSpeculativeTurn(UTADialogueComponent* Speaker)
+{
+	if (!SpeculativeTurn.bInFlight && !SpeculativeTurn.bReady)
 	{
-		DialogueState = EDialogueState::Active;
-		CurrentParticipantIndex = 0; // 重置索引
+		return false;
+	}
+	if (SpeculativeTurn.Speaker.Get() != Speaker || SpeculativeTurn.PrefixCount != DialogueHistory.Num())
+	{
+		DiscardSpeculativeTurn();
+		return false;
+	}
+	Speaker->IsRequestingMessage = true;
+	if (SpeculativeTurn.bReady)
+	{
+		CommitSpeculativeTurn();
 	}
+	else
+	{
+		SpeculativeTurn.bCommitOnArrival = true;
+	}
+	return true;
 }
 
-void UTADialogueInstance::EndDialogue()
+void UTADialogueInstance::CommitSpeculativeTurn()
 {
-	DialogueState = EDialogueState::End;
-	DialogueTimerHandle.Invalidate();
+	UTADialogueComponent* Speaker = SpeculativeTurn.Speaker.Get();
+	const FChatCompletion Reply = SpeculativeTurn.Reply;
+	const bool bSucceeded = SpeculativeTurn.bSucceeded;
+	SpeculativeTurn = FSpeculativeTurn();
+	if (!Speaker)
+	{
+		RefuseToSay(nullptr);
+		return;
+	}
+	++NumSpeculationsCommitted;
+	// 提交后会收到新消息，进而开始推测再下一位
+	Speaker->CommitSpokenReply(Reply, bSucceeded);
+}
+
+void UTADialogueInstance::OnSpeculativeReply(int32 Serial, const FChatCompletion& Message, bool Success)
+{
+	if (Serial != SpeculationSerial)
+	{
+		return;
+	}
+	SpeculativeChat = nullptr;
+	SpeculativeTurn.bInFlight = false;
+	SpeculativeTurn.bReady = true;
+	SpeculativeTurn.bSucceeded = Success;
+	SpeculativeTurn.Reply = Message;
+	if (SpeculativeTurn.bCommitOnArrival)
+	{
+		// 轮到它时还在生成，这期间对话记录变了的话ReceiveMessage已经把它丢掉了
+		CommitSpeculativeTurn();
+	}
 }
 
 void UTADialogueInstance::RefuseToSay(AActor* Sender)
 {
 	// 参与者拒绝说话，重置对话状态为Active
 	DialogueState = EDialogueState::Active;
+	WakeAfter(1.0f);
 }
 
 void UTADialogueInstance::AddMessageToHistory(const FChatLog& Message, AActor* Sender)
 {
 	// 将消息添加到对话历史记录
 	DialogueHistory.Add(Message);
-}
 
-void UTADialogueInstance::DistributeMessage(const FChatCompletion& Message, AActor* Sender)
-{
-	// 其他人只收的到message字段
-	// 定义传递给DistributeMessage函数的新消息
-	FChatCompletion NewMessage = Message;
-	bool bIsNewMessageCreated = false;
+	// 其他人只收的到message字段，这里解析一次，之后每个人拼记录时直接用
+	FTADialogueEntry& Entry = DialogueEntries.AddDefaulted_GetRef();
+	Entry.Sender = Sender;
 
 	TSharedPtr<FJsonObject> JsonObject;
-	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Message.message.content);
-
-	// 装载JSON和执行检查
+	TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Message.content);
 	if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid() && JsonObject->HasField(TEXT("message")))
 	{
 		FString MessageContent;
@@ -180,24 +349,31 @@ void UTADialogueInstance::DistributeMessage(const FChatCompletion& Message, AAct
 		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&NewRawJson);
 		FJsonSerializer::Serialize(NewJsonMessage.ToSharedRef(), Writer);
 
-		NewMessage.message.content = NewRawJson;
-		bIsNewMessageCreated = true;
+		Entry.SharedMessage = FChatLog{Message.role, NewRawJson};
+		Entry.bHasSharedMessage = true;
 	}
+}
 
-	// 广播消息给参与者
-	for (AActor* Participant : Participants)
+void UTADialogueInstance::DistributeMessage(const FChatCompletion& Message, AActor* Sender)
+{
+	// 记录已经在实例里了，参与者只需要通知UI
+	const FTADialogueEntry& Entry = DialogueEntries.Last();
+	FChatCompletion NewMessage = Message;
+	NewMessage.message = Entry.SharedMessage;
+
+	// 广播消息给参与者，会话组件在加入时已经缓存
+	for (const FParticipantEntry& ParticipantEntry : Rotation)
 	{
-		UTADialogueComponent* ChatComponent = Participant->FindComponentByClass<UTADialogueComponent>();
-		if (ChatComponent)
+		AActor* Participant = ParticipantEntry.Actor.Get();
+		UTADialogueComponent* ChatComponent = ParticipantEntry.DialogueComponent.Get();
+		if (Participant && ChatComponent)
 		{
-			// 参与者通过其会话组件来处理接收到的消息
-			// 如果接收者不是发送者且新消息已被创建，则发送处理过的消息
 			// 如果接收者是发送者，即使没有message字段，也应发送原始消息
 			if(Participant == Sender)
 			{
 				ChatComponent->HandleReceivedMessage(Message, Sender);
 			}
-			else if(bIsNewMessageCreated)
+			else if(Entry.bHasSharedMessage)
 			{
 				ChatComponent->HandleReceivedMessage(NewMessage, Sender);
 			}
@@ -206,9 +382,116 @@ void UTADialogueInstance::DistributeMessage(const FChatCompletion& Message, AAct
 	}
 }
 
+void UTADialogueInstance::BuildHistoryFor(const AActor* Participant, int32 Cursor, TArray<FChatLog>& OutHistory, bool bIncludeSummarized) const
+{
+	// 用不了摘要的参与者（摘要开始后才加入）拼完整记录
+	const bool bSkipSummarized = !bIncludeSummarized && CanUseSummary(Cursor);
+	const int32 Start = FMath::Clamp(bSkipSummarized ? FMath::Max(Cursor, SummarizedCount) : Cursor, 0, DialogueHistory.Num());
+	OutHistory.Reserve(OutHistory.Num() + DialogueHistory.Num() - Start);
+	for (int32 Index = Start; Index < DialogueHistory.Num(); ++Index)
+	{
+		const FTADialogueEntry& Entry = DialogueEntries[Index];
+		if (Participant && Entry.Sender.Get() == Participant)
+		{
+			OutHistory.Add(DialogueHistory[Index]);
+		}
+		else if (Entry.bHasSharedMessage)
+		{
+			OutHistory.Add(Entry.SharedMessage);
+		}
+	}
+}
+
+FString UTADialogueInstance::GetSummaryFor(int32 Cursor) const
+{
+	return CanUseSummary(Cursor) && SummarizedCount > SummaryStartIndex ? DialogueSummary : FString();
+}
+
+void UTADialogueInstance::RequestCompression()
+{
+	// 留最近三条不压，和原来每个参与者各自压缩时一样
+	const int32 TargetCount = DialogueHistory.Num() - 3;
+	if (bIsCompressing)
+	{
+		return;
+	}
+
+	// 摘要只能覆盖在场所有人都看过的消息。原来的摘要在场的人都用不了时从最早的游标重新开始
+	int32 MinCursor = DialogueHistory.Num();
+	for (const FParticipantEntry& ParticipantEntry : Rotation)
+	{
+		if (const UTADialogueComponent* DialogueComponent = ParticipantEntry.DialogueComponent.Get())
+		{
+			MinCursor = FMath::Min(MinCursor, DialogueComponent->GetDialogueCursor());
+		}
+	}
+	if (!CanUseSummary(MinCursor))
+	{
+		DialogueSummary.Empty();
+		SummaryStartIndex = MinCursor;
+		SummarizedCount = MinCursor;
+	}
+	if (TargetCount <= SummarizedCount)
+	{
+		return;
+	}
+
+	// 只压大家都看得到的message字段，私有的原文不进共用摘要
+	FString DialogueHistoryString = DialogueSummary;
+	bool bHasNewContent = false;
+	for (int32 Index = SummarizedCount; Index < TargetCount; ++Index)
+	{
+		const FTADialogueEntry& Entry = DialogueEntries[Index];
+		if (Entry.bHasSharedMessage)
+		{
+			DialogueHistoryString += TEXT(" ") + Entry.SharedMessage.content;
+			bHasNewContent = true;
+		}
+	}
+	if (!bHasNewContent)
+	{
+		SummarizedCount = TargetCount;
+		return;
+	}
+	bIsCompressing = true;
+	const int32 StartIndex = SummaryStartIndex;
+
+	TArray<FChatLog> TempMessagesList;
+	TempMessagesList.Add({EOAChatRole::SYSTEM, UTALLMLibrary::PromptToStr(UTADialogueComponent::PromptCompressDialogueHistory)});
+	TempMessagesList.Add({EOAChatRole::USER, DialogueHistoryString.TrimStartAndEnd()});
+
+	FChatSettings ChatSettings{
+		UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast),
+		TempMessagesList
+	};
+	ChatSettings.jsonFormat = true;
+
+	TWeakObjectPtr<UTADialogueInstance> WeakThis(this);
+	UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings,
+		[WeakThis, TargetCount, StartIndex](const FChatCompletion& Message, const FString& ErrorMessage, bool bWasSuccessful)
+		{
+			UTADialogueInstance* This = WeakThis.Get();
+			if (!This)
+			{
+				return;
+			}
+			if (bWasSuccessful && This->SummaryStartIndex == StartIndex)
+			{
+				This->DialogueSummary = Message.message.content;
+				This->SummarizedCount = TargetCount;
+				UE_LOG(LogTAChat, Log, TEXT("Dialogue compression successful: %s"), *Message.message.content);
+			}
+			else
+			{
+				UE_LOG(LogTAChat, Error, TEXT("Dialogue compression failed: %s"), *ErrorMessage);
+			}
+			This->bIsCompressing = false;
+		}, this);
+}
+
 void UTADialogueInstance::BeginDestroy()
 {
-	DialogueTimerHandle.Invalidate();
+	// 调度器只持有弱引用，不需要在这里注销
 	UObject::BeginDestroy();
 }
 
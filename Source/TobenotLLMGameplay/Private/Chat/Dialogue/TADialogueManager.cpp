@@ -5,6 +5,28 @@
 
 #include "Chat/Dialogue/TADialogueComponent.h"
 #include "Chat/TAChatLogCategory.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "TimerManager.h"
+
+static FAutoConsoleCommandWithWorld GTADialogueSchedulerReportCommand(
+	TEXT("TA.Dialogue.Report"),
+	TEXT("打印当前世界里的对话实例数和等待唤醒的对话数"),
+	FConsoleCommandWithWorldDelegate::CreateStatic([](UWorld* World)
+	{
+		if (UTADialogueManager* DialogueManager = World ? World->GetSubsystem<UTADialogueManager>() : nullptr)
+		{
+			UE_LOG(LogTAChat, Log, TEXT("Dialogue scheduler: %d instances, %d turns scheduled"), DialogueManager->GetNumDialogueInstances(), DialogueManager->GetNumScheduledTurns());
+			int32 NumCommitted = 0;
+			int32 NumDiscarded = 0;
+			DialogueManager->ForEachDialogueInstance([&NumCommitted, &NumDiscarded](const UTADialogueInstance* DialogueInstance)
+			{
+				NumCommitted += DialogueInstance->GetNumSpeculationsCommitted();
+				NumDiscarded += DialogueInstance->GetNumSpeculationsDiscarded();
+			});
+			UE_LOG(LogTAChat, Log, TEXT("Pipelined turns: %d speculative replies committed, %d discarded"), NumCommitted, NumDiscarded);
+		}
+	}));
 
 UTADialogueInstance* UTADialogueManager::CreateDialogueInstance(UObject* WorldContext)
 {
@@ -16,11 +38,23 @@ UTADialogueInstance* UTADialogueManager::CreateDialogueInstance(UObject* WorldCo
 
 void UTADialogueManager::DestroyDialogueInstance(FGuid DialogueId)
 {
-	UTADialogueInstance** DialogueInstance = DialogueInstances.Find(DialogueId);
-	if (DialogueInstance)
+	UTADialogueInstance* DialogueInstance = nullptr;
+	// 先取出指针再移除，Find返回的指针在Remove之后就失效了
+	if (DialogueInstances.RemoveAndCopyValue(DialogueId, DialogueInstance) && DialogueInstance)
 	{
-		DialogueInstances.Remove(DialogueId);
-		(*DialogueInstance)->ConditionalBeginDestroy();  // 注意：这里要确保会话实例不被其他地方引用
+		CancelDialogueTurn(DialogueInstance);
+		DialogueInstance->ConditionalBeginDestroy();  // 注意：这里要确保会话实例不被其他地方引用
+	}
+}
+
+void UTADialogueManager::ForEachDialogueInstance(TFunctionRef<void(const UTADialogueInstance*)> Visitor) const
+{
+	for (const TPair<FGuid, UTADialogueInstance*>& Pair : DialogueInstances)
+	{
+		if (Pair.Value)
+		{
+			Visitor(Pair.Value);
+		}
 	}
 }
 
@@ -57,4 +91,106 @@ bool UTADialogueManager::InviteToDialogue(AActor* InvitedActor, UTADialogueInsta
 		return true;
 	}
 	return false;
-}
\ No newline at end of file
+}
+
+void UTADialogueManager::Deinitialize()
+{
+	if (const UWorld* World = GetWorld())
+	{
+		World->GetTimerManager().ClearTimer(SchedulerTimerHandle);
+	}
+	ScheduledTurns.Empty();
+	Super::Deinitialize();
+}
+
+void UTADialogueManager::ScheduleDialogueTurn(UTADialogueInstance* DialogueInstance, float Delay)
+{
+	const UWorld* World = GetWorld();
+	if (!DialogueInstance || !World)
+	{
+		return;
+	}
+	const double WakeTime = World->GetTimeSeconds() + FMath::Max(0.f, Delay);
+	FScheduledTurn* Existing = ScheduledTurns.FindByPredicate([DialogueInstance](const FScheduledTurn& Turn)
+	{
+		return Turn.DialogueInstance.Get() == DialogueInstance;
+	});
+	if (Existing)
+	{
+		Existing->WakeTime = WakeTime;
+	}
+	else
+	{
+		ScheduledTurns.Add({DialogueInstance, WakeTime});
+	}
+	ArmSchedulerTimer();
+}
+
+void UTADialogueManager::CancelDialogueTurn(UTADialogueInstance* DialogueInstance)
+{
+	const int32 NumRemoved = ScheduledTurns.RemoveAllSwap([DialogueInstance](const FScheduledTurn& Turn)
+	{
+		return !Turn.DialogueInstance.IsValid() || Turn.DialogueInstance.Get() == DialogueInstance;
+	});
+	if (NumRemoved > 0)
+	{
+		ArmSchedulerTimer();
+	}
+}
+
+void UTADialogueManager::ArmSchedulerTimer()
+{
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+	FTimerManager& TimerManager = World->GetTimerManager();
+	if (ScheduledTurns.Num() == 0)
+	{
+		TimerManager.ClearTimer(SchedulerTimerHandle);
+		return;
+	}
+	double EarliestWakeTime = TNumericLimits<double>::Max();
+	for (const FScheduledTurn& Turn : ScheduledTurns)
+	{
+		EarliestWakeTime = FMath::Min(EarliestWakeTime, Turn.WakeTime);
+	}
+	// SetTimer的时间必须大于0，已经到点的下一帧就处理
+	const float Delay = FMath::Max(UE_KINDA_SMALL_NUMBER, static_cast<float>(EarliestWakeTime - World->GetTimeSeconds()));
+	TimerManager.SetTimer(SchedulerTimerHandle, this, &UTADialogueManager::RunDueTurns, Delay, false);
+}
+
+void UTADialogueManager::RunDueTurns()
+{
+	const UWorld* World = GetWorld();
+	if (!World)
+	{
+		return;
+	}
+	const double Now = World->GetTimeSeconds();
+
+	// 先把到点的取出来，CycleParticipants里可能会重新排队
+	TArray<TWeakObjectPtr<UTADialogueInstance>> DueInstances;
+	for (int32 Index = ScheduledTurns.Num() - 1; Index >= 0; --Index)
+	{
+		const FScheduledTurn& Turn = ScheduledTurns[Index];
+		if (!Turn.DialogueInstance.IsValid())
+		{
+			ScheduledTurns.RemoveAtSwap(Index);
+		}
+		else if (Turn.WakeTime <= Now)
+		{
+			DueInstances.Add(Turn.DialogueInstance);
+			ScheduledTurns.RemoveAtSwap(Index);
+		}
+	}
+	for (const TWeakObjectPtr<UTADialogueInstance>& DialogueInstance : DueInstances)
+	{
+		if (UTADialogueInstance* Instance = DialogueInstance.Get())
+		{
+			Instance->CycleParticipants();
+		}
+	}
+	ArmSchedulerTimer();
+}
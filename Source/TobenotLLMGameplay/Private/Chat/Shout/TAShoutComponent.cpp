@@ -8,6 +8,7 @@
 #include "OpenAIDefinitions.h"
 #include "Chat/TAFunctionInvokeComponent.h"
 #include "Agent/TAAgentInterface.h"
+#include "Common/TAAsyncParse.h"
 #include "Common/TALLMLibrary.h"
 #include "Chat/TAChatLogCategory.h"
 #include "Save/TAGuidInterface.h"
@@ -471,11 +472,18 @@ void UTAShoutComponent::RequestChoices()
 	{
 		if (Success)
 		{
-			//按照某种定义的JSON格式解析回复选项
-			TArray<FString> Choices = ParseChoicesFromResponse(Message.message.content);
-            
-			// 委托广播备选回复
-			OnProvidePlayerChoices.Broadcast(Choices);
+			//按照某种定义的JSON格式解析回复选项，解析在工作线程做
+			const FString Content = Message.message.content;
+			TAAsyncParse::ParseThenApply<TArray<FString>>(this,
+				[Content]()
+				{
+					return ParseChoicesFromResponse(Content);
+				},
+				[this](TArray<FString>& Choices)
+				{
+					// 委托广播备选回复
+					OnProvidePlayerChoices.Broadcast(Choices);
+				});
 		}
 	},GetOwner());
 }
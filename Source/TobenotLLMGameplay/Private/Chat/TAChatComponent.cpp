@@ -77,37 +77,58 @@ void UTAChatComponent::SendMessageToOpenAI(AActor* OriActor, FString UserMessage
         return;
     }
 
-    // 如果当前正在处理该Actor的消息，将新消息添加到队列中
-    if (ActiveActors.Contains(OriActor))
+    // 如果当前正在处理该Actor的消息，或者同时对话的Actor已满，将新消息添加到队列中
+    FTAActorMessageQueue* ExistingQueue = ActorMessageQueueMap.Find(OriActor);
+    if (ActiveActors.Contains(OriActor) || !HasFreeSlot() || (ExistingQueue && !ExistingQueue->MessageQueue.IsEmpty()))
     {
         FTAActorMessageQueue& ActorQueue = ActorMessageQueueMap.FindOrAdd(OriActor);
-        ActorQueue.MessageQueue.Add(UserMessage);
+        ActorQueue.MessageQueue.Add(MoveTemp(UserMessage));
         ActorQueue.CallbackObject = CallbackObject;
-        UE_LOG(LogTAChat, Warning, TEXT("Another message is being processed for this Actor. Your message has been added to the queue."));
+        UE_LOG(LogTAChat, Log, TEXT("Another message is being processed for this Actor. Your message has been added to the queue."));
+        // 只是前面还有排队的消息时，有空位就马上按顺序开始
+        CheckMessageQueue();
         return;
     }
 
-    // 如果没有正在处理的消息，开始处理新消息
-    ProcessMessage(OriActor, UserMessage, CallbackObject, IsSystemMessage);
+    // 如果没有正在处理的消息，开始处理新消息。被拒绝时通知调用方，免得一直等回复
+    if (!ProcessMessage(OriActor, UserMessage, CallbackObject, IsSystemMessage) && CallbackObject)
+    {
+        CallbackObject->OnFailure.Broadcast();
+    }
+}
+
+bool UTAChatComponent::HasPendingRequests() const
+{
+    if (ActiveActors.Num() > 0)
+    {
+        return true;
+    }
+    for (const TPair<AActor*, FTAActorMessageQueue>& Elem : ActorMessageQueueMap)
+    {
+        if (!Elem.Value.MessageQueue.IsEmpty())
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
-void UTAChatComponent::ProcessMessage(AActor* OriActor, const FString& UserMessage, UTAChatCallback* CallbackObject, bool IsSystemMessage)
+bool UTAChatComponent::ProcessMessage(AActor* OriActor, const FString& UserMessage, UTAChatCallback* CallbackObject, bool IsSystemMessage)
 {
     if (!OriActor)
     {
         UE_LOG(LogTAChat, Warning, TEXT("OriActor is nullptr"));
-        return;
+        return false;
     }
     if(!bAcceptMessages)
     {
         UE_LOG(LogTAChat, Log, TEXT("Reject message from %s"), *OriActor->GetName());
-        return;
+        return false;
     }
     
+    // 回调对象只用来通知调用方，完成后由OnChatCompleted直接处理，不再往回调对象上绑定
     ActiveActors.Add(OriActor);
     CallbackMap.Add(OriActor, CallbackObject);
-    CallbackObject->OnSuccessWithSender.AddDynamic(this, &UTAChatComponent::HandleSuccessfulMessage);
-    CallbackObject->OnFailure.AddDynamic(this, &UTAChatComponent::HandleFailedMessage);
 
     auto& TempMessagesList = GetChatHistoryWithActor(OriActor);
     // 构造系统提示的ChatLog对象
@@ -129,31 +150,43 @@ void UTAChatComponent::ProcessMessage(AActor* OriActor, const FString& UserMessa
     FChatSettings ChatSettings{UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast), TempMessagesList};
     ChatSettings.jsonFormat = ChatMessageJsonFormat;
 
-    CacheChat = UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [this,OriActor](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+    UOpenAIChat* Chat = UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [this,OriActor](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+    {
+        OnChatCompleted(OriActor, Message, Success);
+    },this->GetOwner());
+    if (Chat && ActiveActors.Contains(OriActor))
     {
-        //消息处理前移出激活，因为可能会连续激活
-        ActiveActors.Remove(OriActor);
-        if (Success)
+        ActiveChats.Add(OriActor, Chat);
+    }
+    return true;
+}
+
+void UTAChatComponent::OnChatCompleted(AActor* OriActor, const FChatCompletion& Message, bool Success)
+{
+    //消息处理前移出激活，因为可能会连续激活
+    ActiveActors.Remove(OriActor);
+    ActiveChats.Remove(OriActor);
+    UTAChatCallback* CallbackObject = nullptr;
+    CallbackMap.RemoveAndCopyValue(OriActor, CallbackObject);
+    if (Success)
+    {
+        auto& TempMessagesList = GetChatHistoryWithActor(OriActor);
+        TempMessagesList.Add({EOAChatRole::ASSISTANT, Message.message.content});
+        if(CallbackObject)
         {
-            auto& TempMessagesList = GetChatHistoryWithActor(OriActor);
-            TempMessagesList.Add({EOAChatRole::ASSISTANT, Message.message.content});
-            if(CallbackMap.Contains(OriActor))
-            {
-                CallbackMap[OriActor]->OnSuccess.Broadcast(Message);
-                CallbackMap[OriActor]->OnSuccessWithSender.Broadcast(Message,OriActor);
-            }
-            CallbackMap.Remove(OriActor);
+            CallbackObject->OnSuccess.Broadcast(Message);
+            CallbackObject->OnSuccessWithSender.Broadcast(Message,OriActor);
         }
-        else
+        HandleSuccessfulMessage(Message, OriActor);
+    }
+    else
+    {
+        if(CallbackObject)
         {
-            if(CallbackMap.Contains(OriActor))
-            {
-                CallbackMap[OriActor]->OnFailure.Broadcast();
-            }
-            CallbackMap.Remove(OriActor);
+            CallbackObject->OnFailure.Broadcast();
         }
-        CacheChat = nullptr;
-    },this->GetOwner());
+        HandleFailedMessage();
+    }
 }
 
 FString UTAChatComponent::GetSystemPromptFromOwner() const
@@ -220,22 +253,46 @@ void UTAChatComponent::HandleFailedMessage()
 
 void UTAChatComponent::CheckMessageQueue()
 {
+    // 不同Actor之间并行，有空位就继续开始下一个Actor的消息
+    // 被拒绝的回调等遍历完再通知，回调里可能重新发消息，改到正在遍历的ActorMessageQueueMap
+    TArray<UTAChatCallback*> RejectedCallbacks;
     for (auto& Elem : ActorMessageQueueMap)
     {
+        if (!HasFreeSlot())
+        {
+            break;
+        }
         // 如果当前正在处理该Actor的消息，跳过
-        if (ActiveActors.Contains(Elem.Key))
+        TRingBuffer<FString>& MessageQueue = Elem.Value.MessageQueue;
+        if (ActiveActors.Contains(Elem.Key) || MessageQueue.IsEmpty())
+        {
             continue;
+        }
 
-        if (Elem.Value.MessageQueue.Num() > 0)
+        FString NextMessage = MessageQueue.PopFrontValue();
+        if (bCoalesceQueuedMessages)
         {
-            FString NextMessage = Elem.Value.MessageQueue[0];
-            Elem.Value.MessageQueue.RemoveAt(0);
+            // 排队期间连续发来的几句合成一轮，只走一次完整历史的请求
+            while (!MessageQueue.IsEmpty())
+            {
+                NextMessage += TEXT("\n") + MessageQueue.PopFrontValue();
+            }
+        }
 
-            // 处理下一条消息
-            ProcessMessage(Elem.Key, NextMessage, Elem.Value.CallbackObject, false);
-            break;
+        // 处理下一条消息，不接受消息时这个Actor排着的消息都丢掉，并通知调用方
+        if (!ProcessMessage(Elem.Key, NextMessage, Elem.Value.CallbackObject, false))
+        {
+            MessageQueue.Empty();
+            if (Elem.Value.CallbackObject)
+            {
+                RejectedCallbacks.Add(Elem.Value.CallbackObject);
+            }
         }
     }
+    for (UTAChatCallback* CallbackObject : RejectedCallbacks)
+    {
+        CallbackObject->OnFailure.Broadcast();
+    }
 }
 
 void UTAChatComponent::PerformFunctionInvokeBasedOnResponse(const FString& Response)
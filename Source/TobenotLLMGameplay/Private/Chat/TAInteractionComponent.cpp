@@ -9,7 +9,7 @@
 
 UTAInteractionComponent::UTAInteractionComponent()
 {
-	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bCanEverTick = false;
 }
 
 void UTAInteractionComponent::BeginPlay()
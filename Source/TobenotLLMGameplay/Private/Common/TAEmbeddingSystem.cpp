@@ -4,87 +4,197 @@
 
 #include "OpenAIEmbedding.h"
 #include "OpenAIUtils.h"
+#include "Algo/Count.h"
 #include "Serialization/ArrayReader.h"
 #include "Serialization/BufferArchive.h"
+#include "TASettings.h"
+#include "Event/Data/TABakedEmbeddingAsset.h"
+#include "Event/Plot/TAPlotManager.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
 #include "TobenotToolkit/Debug/CategoryLogSubsystem.h"
 
 
 const float RetryDelaySeconds = 5.0f;
+const FString EmbeddingModelName = TEXT("TEXT_EMBEDDING_3_LARGE");
+
+static FAutoConsoleCommand GTAEmbeddingQuantizationReportCommand(
+	TEXT("TA.Embedding.QuantizationReport"),
+	TEXT("用本地原始精度词嵌存档比较F32/F16/I8三种存储精度的召回率。参数：[阈值，默认剧情标签匹配阈值] [最多向量数，默认400]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		const float Threshold = Args.Num() > 0 ? FCString::Atof(*Args[0]) : UTAPlotManager::TagSimilarityThreshold;
+		const int32 MaxVectors = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 400;
+		UE_LOG(LogTemp, Log, TEXT("%s"), *UTAEmbeddingSystem::BuildQuantizationReportFromSavedEmbeddings(Threshold, MaxVectors));
+	}));
+
+static FAutoConsoleCommand GTAEmbeddingBenchmarkCommand(
+	TEXT("TA.Embedding.Benchmark"),
+	TEXT("对比256/512/1024/3072维下各存储精度的相似度计算耗时、内存和召回率。优先用本地词嵌存档，没有存档时用随机向量。参数：[最多向量数，默认300] [重复次数，默认5]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		const int32 MaxVectors = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 300;
+		const int32 Iterations = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 5;
+		
+		TArray<FHighDimensionalVector> Vectors = UTAEmbeddingSystem::LoadSavedFullPrecisionEmbeddings(MaxVectors);
+		if (Vectors.Num() < 2)
+		{
+			// 随机向量之间几乎不相关，召回率没有参考价值，只看耗时
+			UE_LOG(LogTemp, Warning, TEXT("TA.Embedding.Benchmark: 本地词嵌存档不足，改用随机向量"));
+			FRandomStream RandomStream(1024);
+			Vectors.SetNum(MaxVectors);
+			for (FHighDimensionalVector& Vector : Vectors)
+			{
+				Vector.Components.SetNumUninitialized(3072);
+				for (auto& Component : Vector.Components)
+				{
+					Component = RandomStream.FRandRange(-1.f, 1.f);
+				}
+			}
+		}
+		UE_LOG(LogTemp, Log, TEXT("%s"), *UTAEmbeddingSystem::BuildDimensionBenchmarkReport(Vectors, UTAPlotManager::TagSimilarityThreshold, Iterations));
+	}));
+
+void UTAEmbeddingSystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	if (const UTASettings* Settings = GetDefault<UTASettings>())
+	{
+		StorageMode = Settings->EmbeddingStorageMode;
+		Dimensions = FMath::Max(0, Settings->EmbeddingDimensions);
+	}
+}
 
 bool UTAEmbeddingSystem::GetTagEmbedding(const FName& Tag, FHighDimensionalVector& OutEmbeddingVec)
+{
+	const TSharedPtr<const FTAPackedEmbedding> PackedEmbedding = GetPackedTagEmbedding(Tag);
+	if (!PackedEmbedding.IsValid())
+	{
+		return false;
+	}
+	PackedEmbedding->Unpack(OutEmbeddingVec);
+	return true;
+}
+
+TSharedPtr<const FTAPackedEmbedding> UTAEmbeddingSystem::GetPackedTagEmbedding(const FName& Tag)
 {
 	// 检查嵌入缓存是否已经有我们的Tag
-	if (EmbeddingsCache.Contains(Tag))
+	if (const FTagEmbeddingData* FoundTagEmbeddingData = EmbeddingsCache.Find(Tag))
 	{
-		if (EmbeddingsCache[Tag].Status == ETagEmbeddingStatus::Embedded)
+		if (FoundTagEmbeddingData->Status == ETagEmbeddingStatus::Embedded)
 		{
 			// 如果Tag已经被嵌入，我们直接从缓存中取出嵌入的向量返回
-			OutEmbeddingVec = EmbeddingsCache[Tag].EmbeddingVector;
-			return true;
-		}
-		// 如果Tag正在嵌入过程中，那么我们立刻返回false
-		else if (EmbeddingsCache[Tag].Status == ETagEmbeddingStatus::Embedding)
-		{
-			return false;
+			return FoundTagEmbeddingData->PackedEmbedding;
 		}
+		// 如果Tag正在嵌入过程中，那么我们立刻返回空
+		return nullptr;
 	}
-	else 
+	
+	// 如果Tag还未开始嵌入
+	if (RestoreTagFromArchive(Tag))
 	{
-		// 如果Tag还未开始嵌入
-		if(LoadEmbeddingFromArchive(Tag,TEXT("TEXT_EMBEDDING_3_LARGE"), OutEmbeddingVec))
-		{
-			// 如果本地存档中有结果，直接返回true，表示成功获取到了词嵌结果
-			return true;
-		}
-		
-		// 看看有没有Tag在嵌入，因为Http并发限制，我们一次就嵌一个Tag就好
-		if(bHasTagEmbedding)
-		{
-			return false;
-		}
-		bHasTagEmbedding = true;
-		
-		// 如果没有Tag正在嵌入我们需要将新的Tag加入到嵌入缓存中，启动嵌入请求，并立刻返回false
-		FTagEmbeddingData NewEmbeddingData;
-		NewEmbeddingData.Tag = Tag;
-		NewEmbeddingData.Status = ETagEmbeddingStatus::Embedding;
-
-		EmbeddingsCache.Add(Tag, NewEmbeddingData);
-		FEmbeddingSettings EmbeddingSettings;
-		EmbeddingSettings.model = EEmbeddingEngineType::TEXT_EMBEDDING_3_LARGE;
-		EmbeddingSettings.input = Tag.ToString(); // 假设FEmbeddingSettings有一个tag字段用来标识请求
-		
-		SendEmbeddingToOpenAIWithRetry(EmbeddingSettings, [this, Tag](const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)
+		// 如果本地存档中有结果，直接返回，表示成功获取到了词嵌结果
+		return EmbeddingsCache[Tag].PackedEmbedding;
+	}
+	
+	// 看看有没有Tag在嵌入，因为Http并发限制，我们一次就嵌一个Tag就好
+	if(bHasTagEmbedding)
+	{
+		return nullptr;
+	}
+	bHasTagEmbedding = true;
+	
+	// 如果没有Tag正在嵌入我们需要将新的Tag加入到嵌入缓存中，启动嵌入请求，并立刻返回空
+	FTagEmbeddingData NewEmbeddingData;
+	NewEmbeddingData.Tag = Tag;
+	NewEmbeddingData.Status = ETagEmbeddingStatus::Embedding;
+
+	EmbeddingsCache.Add(Tag, NewEmbeddingData);
+	FEmbeddingSettings EmbeddingSettings;
+	EmbeddingSettings.model = EEmbeddingEngineType::TEXT_EMBEDDING_3_LARGE;
+	EmbeddingSettings.input = Tag.ToString(); // 假设FEmbeddingSettings有一个tag字段用来标识请求
+	
+	SendEmbeddingToOpenAIWithRetry(EmbeddingSettings, [this, Tag](const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)
+	{
+		if (Success)
 		{
-			if (Success)
-			{
-				UE_LOG(LogTemp, Log, TEXT("[%s] SendEmbeddingToOpenAIWithRetry Success"), *Tag.ToString());
+			UE_LOG(LogTemp, Log, TEXT("[%s] SendEmbeddingToOpenAIWithRetry Success"), *Tag.ToString());
 
-				// 更新状态和EmbeddingVector
-				if (EmbeddingsCache.Contains(Tag))
+			// 更新状态和压缩后的向量
+			if (EmbeddingsCache.Contains(Tag))
+			{
+				const TSharedPtr<const FTAPackedEmbedding> PackedEmbedding = AddEmbeddedTag(Tag, Result.embeddingVector);
+				// 原始精度的向量总是留一份，之后改降维或精度设置时从它重新打包，不用重新请求
+				SaveEmbeddingToArchive(Tag, Result.embeddingVector, EmbeddingModelName);
+				if (!UsesFullPrecisionArchive())
 				{
-					FTagEmbeddingData& EmbeddingData = EmbeddingsCache[Tag];
-					EmbeddingData.Status = ETagEmbeddingStatus::Embedded;
-					EmbeddingData.EmbeddingVector = Result.embeddingVector;
-					SaveEmbeddingToArchive(Tag, Result.embeddingVector, TEXT("TEXT_EMBEDDING_3_LARGE"));
+					// 当前设置下的打包结果只是加载缓存，对不上设置时会被忽略
+					SavePackedEmbeddingToArchive(Tag, *PackedEmbedding);
 				}
 			}
-			else
-			{
-				UE_LOG(LogTemp, Log, TEXT("[%s] SendEmbeddingToOpenAIWithRetry Fail: %s"), *Tag.ToString(), *ErrorMessage);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Log, TEXT("[%s] SendEmbeddingToOpenAIWithRetry Fail: %s"), *Tag.ToString(), *ErrorMessage);
 
-				// 如果失败，将状态更新为NotEmbedded以便之后重试
-				if (EmbeddingsCache.Contains(Tag))
-				{
-					EmbeddingsCache[Tag].Status = ETagEmbeddingStatus::NotEmbedded;
-				}
+			// 如果失败，将状态更新为NotEmbedded以便之后重试
+			if (EmbeddingsCache.Contains(Tag))
+			{
+				EmbeddingsCache[Tag].Status = ETagEmbeddingStatus::NotEmbedded;
 			}
-			bHasTagEmbedding = false;
-		}, this);
+		}
+		bHasTagEmbedding = false;
+	}, this);
 
-		return false;
+	return nullptr;
+}
+
+const FString& UTAEmbeddingSystem::GetEmbeddingModelName()
+{
+	return EmbeddingModelName;
+}
+
+int32 UTAEmbeddingSystem::RegisterBakedEmbeddings(const UTABakedEmbeddingAsset* BakedAsset)
+{
+	if (!BakedAsset)
+	{
+		return 0;
 	}
-	return false;
+	if (BakedAsset->ModelName != EmbeddingModelName)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("[%s] 烘焙词嵌的模型 %s 与当前模型 %s 不一致，忽略"), *BakedAsset->GetName(), *BakedAsset->ModelName, *EmbeddingModelName);
+		return 0;
+	}
+	
+	int32 AddedCount = 0;
+	for (const FTABakedTagEmbedding& Baked : BakedAsset->Embeddings)
+	{
+		// 正在网络请求中的标签也直接用烘焙结果覆盖，请求回来时会再覆盖一次，结果相同
+		const FTagEmbeddingData* Existing = EmbeddingsCache.Find(Baked.Tag);
+		if ((Existing && Existing->Status == ETagEmbeddingStatus::Embedded) || Baked.Components.Num() == 0)
+		{
+			continue;
+		}
+		FHighDimensionalVector EmbeddingVector;
+		EmbeddingVector.Components.Reserve(Baked.Components.Num());
+		for (const float Component : Baked.Components)
+		{
+			EmbeddingVector.Components.Add(Component);
+		}
+		AddEmbeddedTag(Baked.Tag, EmbeddingVector);
+		++AddedCount;
+	}
+	UE_LOG(LogTemp, Log, TEXT("[%s] 载入烘焙词嵌 %d 个"), *BakedAsset->GetName(), AddedCount);
+	return AddedCount;
+}
+
+TSharedPtr<const FTAPackedEmbedding> UTAEmbeddingSystem::AddEmbeddedTag(const FName& Tag, const FHighDimensionalVector& EmbeddingVector)
+{
+	FTagEmbeddingData& EmbeddingData = EmbeddingsCache.FindOrAdd(Tag);
+	EmbeddingData.Tag = Tag;
+	EmbeddingData.Status = ETagEmbeddingStatus::Embedded;
+	EmbeddingData.PackedEmbedding = MakeShared<FTAPackedEmbedding>(FTAPackedEmbedding::Pack(EmbeddingVector, StorageMode, Dimensions));
+	return EmbeddingData.PackedEmbedding;
 }
 
 UOpenAIEmbedding* UTAEmbeddingSystem::SendEmbeddingToOpenAIWithRetry(const FEmbeddingSettings& EmbeddingSettings,
@@ -191,7 +301,12 @@ FTagEmbeddingData UTAEmbeddingSystem::GetTagEmbeddingData(const FName& Tag) cons
 		DefaultData.Status = ETagEmbeddingStatus::NotEmbedded;
 		return DefaultData;
 	}
-	return *FoundTagEmbeddingData;
+	FTagEmbeddingData TagEmbeddingData = *FoundTagEmbeddingData;
+	if (TagEmbeddingData.PackedEmbedding.IsValid())
+	{
+		TagEmbeddingData.PackedEmbedding->Unpack(TagEmbeddingData.EmbeddingVector);
+	}
+	return TagEmbeddingData;
 }
 
 float UTAEmbeddingSystem::CalculateCosineSimilarity(const FHighDimensionalVector& VectorA,const FHighDimensionalVector& VectorB)
@@ -199,19 +314,210 @@ float UTAEmbeddingSystem::CalculateCosineSimilarity(const FHighDimensionalVector
 	return UOpenAIUtils::HDVectorCosineSimilaritySIMD(VectorA, VectorB);
 }
 
-FString UTAEmbeddingSystem::GetSaveFilePath(const FName& Tag, const FString& ModelName) const
+FString UTAEmbeddingSystem::BuildQuantizationReport(const TArray<FHighDimensionalVector>& Vectors, float Threshold)
+{
+	struct FModeStats
+	{
+		ETAEmbeddingStorageMode Mode;
+		TArray<FTAPackedEmbedding> Packed;
+		SIZE_T DataSize = 0;
+		int64 TruePositives = 0;
+		int64 FalsePositives = 0;
+		double SumAbsError = 0.0;
+		double MaxAbsError = 0.0;
+	};
+
+	TArray<FModeStats> AllStats;
+	for (const ETAEmbeddingStorageMode Mode : {ETAEmbeddingStorageMode::Float32, ETAEmbeddingStorageMode::Float16, ETAEmbeddingStorageMode::Int8})
+	{
+		FModeStats& Stats = AllStats.AddDefaulted_GetRef();
+		Stats.Mode = Mode;
+		Stats.Packed.Reserve(Vectors.Num());
+		for (const FHighDimensionalVector& Vector : Vectors)
+		{
+			Stats.DataSize += Stats.Packed.Add_GetRef(FTAPackedEmbedding::Pack(Vector, Mode)).GetDataSize();
+		}
+	}
+
+	// 以原始精度的余弦相似度为准，统计各精度在阈值上的判定差异
+	const TArray<FTAPackedEmbedding>& Reference = AllStats[0].Packed;
+	int64 PairCount = 0;
+	int64 Positives = 0;
+	for (int32 IndexA = 0; IndexA < Vectors.Num(); ++IndexA)
+	{
+		for (int32 IndexB = IndexA + 1; IndexB < Vectors.Num(); ++IndexB)
+		{
+			const float Exact = FTAPackedEmbedding::DotProduct(Reference[IndexA], Reference[IndexB]);
+			const bool bExactMatch = Exact > Threshold;
+			++PairCount;
+			Positives += bExactMatch ? 1 : 0;
+			
+			for (FModeStats& Stats : AllStats)
+			{
+				const float Similarity = FTAPackedEmbedding::DotProduct(Stats.Packed[IndexA], Stats.Packed[IndexB]);
+				const double AbsError = FMath::Abs(static_cast<double>(Similarity) - Exact);
+				Stats.SumAbsError += AbsError;
+				Stats.MaxAbsError = FMath::Max(Stats.MaxAbsError, AbsError);
+				if (Similarity > Threshold)
+				{
+					bExactMatch ? ++Stats.TruePositives : ++Stats.FalsePositives;
+				}
+			}
+		}
+	}
+
+	FString Report = FString::Printf(TEXT("词嵌精度报告：%d 个向量，%lld 对，阈值 %.2f，原始精度命中 %lld 对\n"), Vectors.Num(), PairCount, Threshold, Positives);
+	for (const FModeStats& Stats : AllStats)
+	{
+		const double Recall = Positives > 0 ? 100.0 * Stats.TruePositives / Positives : 100.0;
+		const double MeanAbsError = PairCount > 0 ? Stats.SumAbsError / PairCount : 0.0;
+		const SIZE_T BytesPerVector = Vectors.Num() > 0 ? Stats.DataSize / Vectors.Num() : 0;
+		Report += FString::Printf(TEXT("  %s: 召回率 %.2f%% (%lld/%lld)，误报 %lld，平均误差 %.5f，最大误差 %.5f，每向量 %llu 字节\n"),
+			FTAPackedEmbedding::GetModeSuffix(Stats.Mode), Recall, Stats.TruePositives, Positives, Stats.FalsePositives,
+			MeanAbsError, Stats.MaxAbsError, static_cast<uint64>(BytesPerVector));
+	}
+	return Report;
+}
+
+FString UTAEmbeddingSystem::BuildQuantizationReportFromSavedEmbeddings(float Threshold, int32 MaxVectors)
+{
+	return BuildQuantizationReport(LoadSavedFullPrecisionEmbeddings(MaxVectors), Threshold);
+}
+
+FString UTAEmbeddingSystem::BuildDimensionBenchmarkReport(const TArray<FHighDimensionalVector>& Vectors, float Threshold, int32 Iterations)
+{
+	Iterations = FMath::Max(1, Iterations);
+	const int32 PairCount = Vectors.Num() * (Vectors.Num() - 1) / 2;
+	if (PairCount <= 0)
+	{
+		return TEXT("词嵌维度基准：向量不足两个");
+	}
+
+	// 完整维度原始精度的判定结果作为基准
+	TArray<bool> ReferenceMatches;
+	ReferenceMatches.Reserve(PairCount);
+	{
+		TArray<FTAPackedEmbedding> Reference;
+		Reference.Reserve(Vectors.Num());
+		for (const FHighDimensionalVector& Vector : Vectors)
+		{
+			Reference.Add(FTAPackedEmbedding::Pack(Vector, ETAEmbeddingStorageMode::Float32));
+		}
+		for (int32 IndexA = 0; IndexA < Reference.Num(); ++IndexA)
+		{
+			for (int32 IndexB = IndexA + 1; IndexB < Reference.Num(); ++IndexB)
+			{
+				ReferenceMatches.Add(FTAPackedEmbedding::DotProduct(Reference[IndexA], Reference[IndexB]) > Threshold);
+			}
+		}
+	}
+	const int32 Positives = Algo::Count(ReferenceMatches, true);
+
+	FString Report = FString::Printf(TEXT("词嵌维度基准：%d 个向量，%d 对，重复 %d 次，阈值 %.2f，完整维度命中 %d 对\n"),
+		Vectors.Num(), PairCount, Iterations, Threshold, Positives);
+	for (const int32 Dimension : {256, 512, 1024, 3072})
+	{
+		for (const ETAEmbeddingStorageMode Mode : {ETAEmbeddingStorageMode::Float32, ETAEmbeddingStorageMode::Float16, ETAEmbeddingStorageMode::Int8})
+		{
+			TArray<FTAPackedEmbedding> Packed;
+			Packed.Reserve(Vectors.Num());
+			SIZE_T DataSize = 0;
+			for (const FHighDimensionalVector& Vector : Vectors)
+			{
+				DataSize += Packed.Add_GetRef(FTAPackedEmbedding::Pack(Vector, Mode, Dimension)).GetDataSize();
+			}
+
+			int32 TruePositives = 0;
+			int32 FalsePositives = 0;
+			double Checksum = 0.0;
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+			{
+				int32 PairIndex = 0;
+				for (int32 IndexA = 0; IndexA < Packed.Num(); ++IndexA)
+				{
+					for (int32 IndexB = IndexA + 1; IndexB < Packed.Num(); ++IndexB, ++PairIndex)
+					{
+						const float Similarity = FTAPackedEmbedding::DotProduct(Packed[IndexA], Packed[IndexB]);
+						Checksum += Similarity;
+						if (Iteration == 0 && Similarity > Threshold)
+						{
+							ReferenceMatches[PairIndex] ? ++TruePositives : ++FalsePositives;
+						}
+					}
+				}
+			}
+			const double ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
+
+			const double NanosecondsPerPair = ElapsedSeconds * 1e9 / (static_cast<double>(PairCount) * Iterations);
+			const double Recall = Positives > 0 ? 100.0 * TruePositives / Positives : 100.0;
+			Report += FString::Printf(TEXT("  %4d维 %s: %.1f ns/对，每向量 %llu 字节，召回率 %.2f%%，误报 %d (校验和 %.3f)\n"),
+				Packed.Num() > 0 ? Packed[0].Num() : Dimension, FTAPackedEmbedding::GetModeSuffix(Mode), NanosecondsPerPair,
+				static_cast<uint64>(DataSize / Vectors.Num()), Recall, FalsePositives, Checksum);
+		}
+	}
+	return Report;
+}
+
+TArray<FHighDimensionalVector> UTAEmbeddingSystem::LoadSavedFullPrecisionEmbeddings(int32 MaxVectors)
+{
+	// 只读原始精度的旧格式存档，压缩存档已经丢了精度，不能当基准
+	TArray<FString> FileNames;
+	IFileManager::Get().FindFiles(FileNames, *(GetSaveDirectory() / FString::Printf(TEXT("*_%s.embedding"), *EmbeddingModelName)), true, false);
+
+	TArray<FHighDimensionalVector> Vectors;
+	for (const FString& FileName : FileNames)
+	{
+		if (Vectors.Num() >= MaxVectors)
+		{
+			break;
+		}
+		FArrayReader FromBinary;
+		if (FFileHelper::LoadFileToArray(FromBinary, *(GetSaveDirectory() / FileName)))
+		{
+			FEmbeddingArchive ArchiveData;
+			FromBinary << ArchiveData;
+			if (ArchiveData.EmbeddingVector.Components.Num() > 0)
+			{
+				Vectors.Add(ArchiveData.EmbeddingVector);
+			}
+		}
+	}
+	return Vectors;
+}
+
+FString UTAEmbeddingSystem::GetModelKey() const
+{
+	if (UsesFullPrecisionArchive())
+	{
+		return EmbeddingModelName;
+	}
+	FString ModelKey = EmbeddingModelName;
+	if (Dimensions > 0)
+	{
+		ModelKey += FString::Printf(TEXT("_D%d"), Dimensions);
+	}
+	return ModelKey + TEXT("_") + FTAPackedEmbedding::GetModeSuffix(StorageMode);
+}
+
+bool UTAEmbeddingSystem::UsesFullPrecisionArchive() const
+{
+	return StorageMode == ETAEmbeddingStorageMode::Float32 && Dimensions == 0;
+}
+
+FString UTAEmbeddingSystem::GetSaveDirectory()
 {
 	// 获取项目的Saved目录路径
-	FString SavedDir = FPaths::ProjectSavedDir();
+	return FPaths::ProjectSavedDir() / TEXT("Embeddings");
+}
 
+FString UTAEmbeddingSystem::GetSaveFilePath(const FName& Tag, const FString& ModelName) const
+{
 	// 使用标签和模型名称生成文件名，确保名称对文件系统是有效的
-	FString FileName = FString::Printf(TEXT("Embeddings/%s_%s.embedding"), *Tag.ToString(), *ModelName);
-
-	// 清洁文件名，移除可能的非法字符
-	FPaths::MakeValidFileName(FileName);
+	const FString FileName = FString::Printf(TEXT("%s_%s.embedding"), *Tag.ToString(), *ModelName);
 
 	// 最后返回完整的文件路径
-	return SavedDir / FileName;
+	return GetSaveDirectory() / FileName;
 }
 
 bool UTAEmbeddingSystem::SaveEmbeddingToArchive(const FName& Tag, const FHighDimensionalVector& EmbeddingVector, const FString& ModelName)
@@ -235,7 +541,7 @@ bool UTAEmbeddingSystem::SaveEmbeddingToArchive(const FName& Tag, const FHighDim
 	return false;
 }
 
-bool UTAEmbeddingSystem::LoadEmbeddingFromArchive(const FName& Tag, const FString& ModelName, FHighDimensionalVector& OutEmbeddingVector)
+bool UTAEmbeddingSystem::LoadEmbeddingFromArchive(const FName& Tag, const FString& ModelName, FHighDimensionalVector& OutEmbeddingVector) const
 {
 	FString FilePath = GetSaveFilePath(Tag, ModelName); // 生成文件路径
 	FArrayReader FromBinary;
@@ -245,13 +551,6 @@ bool UTAEmbeddingSystem::LoadEmbeddingFromArchive(const FName& Tag, const FStrin
 	{
 		FEmbeddingArchive ArchiveData;
 		FromBinary << ArchiveData; // 从二进制反序列化数据
-		
-		FTagEmbeddingData NewEmbeddingData;
-		NewEmbeddingData.Tag = Tag;
-		NewEmbeddingData.Status = ETagEmbeddingStatus::Embedded;
-		NewEmbeddingData.EmbeddingVector = ArchiveData.EmbeddingVector;
-		EmbeddingsCache.Add(Tag, NewEmbeddingData);
-		
 		OutEmbeddingVector = ArchiveData.EmbeddingVector;
 		FromBinary.FlushCache();
 		FromBinary.Empty();
@@ -259,3 +558,67 @@ bool UTAEmbeddingSystem::LoadEmbeddingFromArchive(const FName& Tag, const FStrin
 	}
 	return false;
 }
+
+bool UTAEmbeddingSystem::SavePackedEmbeddingToArchive(const FName& Tag, const FTAPackedEmbedding& PackedEmbedding)
+{
+	FTAPackedEmbeddingArchive ArchiveData;
+	ArchiveData.Tag = Tag;
+	ArchiveData.ModelKey = GetModelKey();
+	ArchiveData.PackedEmbedding = PackedEmbedding;
+
+	FBufferArchive ToBinary;
+	ToBinary << ArchiveData;
+	const bool bSaved = FFileHelper::SaveArrayToFile(ToBinary, *GetSaveFilePath(Tag, ArchiveData.ModelKey));
+	ToBinary.FlushCache();
+	ToBinary.Empty();
+	return bSaved;
+}
+
+bool UTAEmbeddingSystem::LoadPackedEmbeddingFromArchive(const FName& Tag, FTAPackedEmbedding& OutPackedEmbedding) const
+{
+	FArrayReader FromBinary;
+	if (!FFileHelper::LoadFileToArray(FromBinary, *GetSaveFilePath(Tag, GetModelKey())))
+	{
+		return false;
+	}
+	
+	FTAPackedEmbeddingArchive ArchiveData;
+	FromBinary << ArchiveData;
+	// 版本或精度对不上就当作没有存档，之后会从原始精度存档或者网络重新生成
+	if (FromBinary.IsError() || ArchiveData.Version != FTAPackedEmbeddingArchive::CurrentVersion || ArchiveData.PackedEmbedding.Mode != StorageMode
+		|| (Dimensions > 0 && ArchiveData.PackedEmbedding.Num() > Dimensions))
+	{
+		return false;
+	}
+	OutPackedEmbedding = MoveTemp(ArchiveData.PackedEmbedding);
+	return true;
+}
+
+bool UTAEmbeddingSystem::RestoreTagFromArchive(const FName& Tag)
+{
+	if (!UsesFullPrecisionArchive())
+	{
+		FTAPackedEmbedding PackedEmbedding;
+		if (LoadPackedEmbeddingFromArchive(Tag, PackedEmbedding))
+		{
+			FTagEmbeddingData& EmbeddingData = EmbeddingsCache.Add(Tag);
+			EmbeddingData.Tag = Tag;
+			EmbeddingData.Status = ETagEmbeddingStatus::Embedded;
+			EmbeddingData.PackedEmbedding = MakeShared<FTAPackedEmbedding>(MoveTemp(PackedEmbedding));
+			return true;
+		}
+	}
+
+	// 原始精度存档，降维或压缩存储模式下读到后按当前设置打包，顺便写一份对应的存档，下次就不用再读大文件了
+	FHighDimensionalVector EmbeddingVector;
+	if (LoadEmbeddingFromArchive(Tag, EmbeddingModelName, EmbeddingVector))
+	{
+		const TSharedPtr<const FTAPackedEmbedding> PackedEmbedding = AddEmbeddedTag(Tag, EmbeddingVector);
+		if (!UsesFullPrecisionArchive())
+		{
+			SavePackedEmbeddingToArchive(Tag, *PackedEmbedding);
+		}
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,275 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+#include "Common/TAEmbeddingVector.h"
+
+#include "OpenAIDefinitions.h"
+
+// 编译目标支持AVX2时走AVX2内核，ARM64走NEON内核，其他平台用标量循环
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define TA_EMBEDDING_SIMD_AVX2 1
+#elif PLATFORM_ENABLE_VECTORINTRINSICS_NEON && PLATFORM_CPU_ARM_FAMILY && PLATFORM_64BITS
+	#include <arm_neon.h>
+	#define TA_EMBEDDING_SIMD_NEON 1
+#endif
+
+#ifndef TA_EMBEDDING_SIMD_AVX2
+	#define TA_EMBEDDING_SIMD_AVX2 0
+#endif
+#ifndef TA_EMBEDDING_SIMD_NEON
+	#define TA_EMBEDDING_SIMD_NEON 0
+#endif
+
+// 半精度转换是F16C指令，GCC/Clang上-mavx2不包含-mf16c，没有时半精度点积走标量循环
+// MSVC不定义__F16C__，/arch:AVX2下可以直接用这些内建函数
+#if TA_EMBEDDING_SIMD_AVX2 && (defined(__F16C__) || (defined(_MSC_VER) && !defined(__clang__)))
+	#define TA_EMBEDDING_SIMD_F16C 1
+#else
+	#define TA_EMBEDDING_SIMD_F16C 0
+#endif
+
+namespace TAEmbeddingKernels
+{
+#if TA_EMBEDDING_SIMD_AVX2
+	FORCEINLINE float HorizontalSum(const __m256 Value)
+	{
+		__m128 Sum = _mm_add_ps(_mm256_castps256_ps128(Value), _mm256_extractf128_ps(Value, 1));
+		Sum = _mm_add_ps(Sum, _mm_movehl_ps(Sum, Sum));
+		Sum = _mm_add_ss(Sum, _mm_shuffle_ps(Sum, Sum, 0x55));
+		return _mm_cvtss_f32(Sum);
+	}
+
+	FORCEINLINE int32 HorizontalSum(const __m256i Value)
+	{
+		__m128i Sum = _mm_add_epi32(_mm256_castsi256_si128(Value), _mm256_extracti128_si256(Value, 1));
+		Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(Sum);
+	}
+#endif
+
+	float DotFloat32(const float* A, const float* B, const int32 Count)
+	{
+		int32 Index = 0;
+		float Sum = 0.f;
+#if TA_EMBEDDING_SIMD_AVX2
+		__m256 Acc = _mm256_setzero_ps();
+		for (; Index + 8 <= Count; Index += 8)
+		{
+			Acc = _mm256_add_ps(Acc, _mm256_mul_ps(_mm256_loadu_ps(A + Index), _mm256_loadu_ps(B + Index)));
+		}
+		Sum = HorizontalSum(Acc);
+#elif TA_EMBEDDING_SIMD_NEON
+		float32x4_t Acc = vdupq_n_f32(0.f);
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			Acc = vmlaq_f32(Acc, vld1q_f32(A + Index), vld1q_f32(B + Index));
+		}
+		Sum = vaddvq_f32(Acc);
+#endif
+		for (; Index < Count; ++Index)
+		{
+			Sum += A[Index] * B[Index];
+		}
+		return Sum;
+	}
+
+	float DotFloat16(const FFloat16* A, const FFloat16* B, const int32 Count)
+	{
+		int32 Index = 0;
+		float Sum = 0.f;
+#if TA_EMBEDDING_SIMD_F16C
+		// FFloat16就是一个uint16，可以直接用F16C指令批量转成float
+		__m256 Acc = _mm256_setzero_ps();
+		for (; Index + 8 <= Count; Index += 8)
+		{
+			const __m256 VA = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(A + Index)));
+			const __m256 VB = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(B + Index)));
+			Acc = _mm256_add_ps(Acc, _mm256_mul_ps(VA, VB));
+		}
+		Sum = HorizontalSum(Acc);
+#elif TA_EMBEDDING_SIMD_NEON
+		float32x4_t Acc = vdupq_n_f32(0.f);
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			const float32x4_t VA = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16*>(A + Index))));
+			const float32x4_t VB = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16*>(B + Index))));
+			Acc = vmlaq_f32(Acc, VA, VB);
+		}
+		Sum = vaddvq_f32(Acc);
+#endif
+		for (; Index < Count; ++Index)
+		{
+			Sum += A[Index].GetFloat() * B[Index].GetFloat();
+		}
+		return Sum;
+	}
+
+	// 返回整数点积，调用方再乘上两个向量的缩放
+	int32 DotInt8(const int8* A, const int8* B, const int32 Count)
+	{
+		int32 Index = 0;
+		int32 Sum = 0;
+#if TA_EMBEDDING_SIMD_AVX2
+		// 扩成int16后用madd两两相乘相加，3072维也远不会溢出int32
+		__m256i Acc = _mm256_setzero_si256();
+		for (; Index + 16 <= Count; Index += 16)
+		{
+			const __m256i VA = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(A + Index)));
+			const __m256i VB = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(B + Index)));
+			Acc = _mm256_add_epi32(Acc, _mm256_madd_epi16(VA, VB));
+		}
+		Sum = HorizontalSum(Acc);
+#elif TA_EMBEDDING_SIMD_NEON
+		int32x4_t Acc = vdupq_n_s32(0);
+		for (; Index + 16 <= Count; Index += 16)
+		{
+			const int8x16_t VA = vld1q_s8(A + Index);
+			const int8x16_t VB = vld1q_s8(B + Index);
+			Acc = vpadalq_s16(Acc, vmull_s8(vget_low_s8(VA), vget_low_s8(VB)));
+			Acc = vpadalq_s16(Acc, vmull_high_s8(VA, VB));
+		}
+		Sum = vaddvq_s32(Acc);
+#endif
+		for (; Index < Count; ++Index)
+		{
+			Sum += static_cast<int32>(A[Index]) * static_cast<int32>(B[Index]);
+		}
+		return Sum;
+	}
+}
+
+int32 FTAPackedEmbedding::Num() const
+{
+	switch (Mode)
+	{
+	case ETAEmbeddingStorageMode::Float16: return Float16Data.Num();
+	case ETAEmbeddingStorageMode::Int8: return Int8Data.Num();
+	default: return Float32Data.Num();
+	}
+}
+
+SIZE_T FTAPackedEmbedding::GetDataSize() const
+{
+	return Float32Data.GetAllocatedSize() + Float16Data.GetAllocatedSize() + Int8Data.GetAllocatedSize();
+}
+
+FTAPackedEmbedding FTAPackedEmbedding::Pack(const FHighDimensionalVector& Source, ETAEmbeddingStorageMode InMode, int32 MaxDimension)
+{
+	FTAPackedEmbedding Packed;
+	Packed.Mode = InMode;
+
+	// text-embedding-3系列的前N维本身就是一个可用的低维嵌入，截断后重新归一化即可
+	const int32 Count = MaxDimension > 0 ? FMath::Min(MaxDimension, Source.Components.Num()) : Source.Components.Num();
+
+	// 用double累加，避免3072维的平方和丢精度
+	double SquaredSum = 0.0;
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		const double Value = Source.Components[Index];
+		SquaredSum += Value * Value;
+	}
+	const double InvLength = SquaredSum > 0.0 ? 1.0 / FMath::Sqrt(SquaredSum) : 0.0;
+
+	switch (InMode)
+	{
+	case ETAEmbeddingStorageMode::Float16:
+		{
+			Packed.Float16Data.SetNumUninitialized(Count);
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				Packed.Float16Data[Index] = FFloat16(static_cast<float>(Source.Components[Index] * InvLength));
+			}
+			break;
+		}
+	case ETAEmbeddingStorageMode::Int8:
+		{
+			double MaxAbs = 0.0;
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				MaxAbs = FMath::Max(MaxAbs, FMath::Abs(Source.Components[Index] * InvLength));
+			}
+			// 对称量化，最大分量映射到127
+			Packed.Scale = MaxAbs > 0.0 ? static_cast<float>(MaxAbs / 127.0) : 1.f;
+			const double InvScale = 1.0 / Packed.Scale;
+			Packed.Int8Data.SetNumUninitialized(Count);
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				const int32 Quantized = FMath::RoundToInt(Source.Components[Index] * InvLength * InvScale);
+				Packed.Int8Data[Index] = static_cast<int8>(FMath::Clamp(Quantized, -127, 127));
+			}
+			break;
+		}
+	default:
+		{
+			Packed.Float32Data.SetNumUninitialized(Count);
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				Packed.Float32Data[Index] = static_cast<float>(Source.Components[Index] * InvLength);
+			}
+			break;
+		}
+	}
+	return Packed;
+}
+
+void FTAPackedEmbedding::Unpack(FHighDimensionalVector& OutVector) const
+{
+	const int32 Count = Num();
+	OutVector.Components.Reset(Count);
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		OutVector.Components.Add(GetComponent(Index));
+	}
+}
+
+float FTAPackedEmbedding::GetComponent(int32 Index) const
+{
+	switch (Mode)
+	{
+	case ETAEmbeddingStorageMode::Float16: return Float16Data[Index].GetFloat();
+	case ETAEmbeddingStorageMode::Int8: return Int8Data[Index] * Scale;
+	default: return Float32Data[Index];
+	}
+}
+
+float FTAPackedEmbedding::DotProduct(const FTAPackedEmbedding& A, const FTAPackedEmbedding& B)
+{
+	const int32 Count = A.Num();
+	if (Count != B.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FTAPackedEmbedding::DotProduct 维度不一致 %d / %d"), Count, B.Num());
+		return 0.f;
+	}
+
+	if (A.Mode == B.Mode)
+	{
+		switch (A.Mode)
+		{
+		case ETAEmbeddingStorageMode::Float16:
+			return TAEmbeddingKernels::DotFloat16(A.Float16Data.GetData(), B.Float16Data.GetData(), Count);
+		case ETAEmbeddingStorageMode::Int8:
+			return TAEmbeddingKernels::DotInt8(A.Int8Data.GetData(), B.Int8Data.GetData(), Count) * A.Scale * B.Scale;
+		default:
+			return TAEmbeddingKernels::DotFloat32(A.Float32Data.GetData(), B.Float32Data.GetData(), Count);
+		}
+	}
+
+	// 精度不同（比如切换了存储模式，旧缓存还在）时逐个解压，比较慢但结果正确
+	float Sum = 0.f;
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		Sum += A.GetComponent(Index) * B.GetComponent(Index);
+	}
+	return Sum;
+}
+
+const TCHAR* FTAPackedEmbedding::GetModeSuffix(ETAEmbeddingStorageMode InMode)
+{
+	switch (InMode)
+	{
+	case ETAEmbeddingStorageMode::Float16: return TEXT("F16");
+	case ETAEmbeddingStorageMode::Int8: return TEXT("I8");
+	default: return TEXT("F32");
+	}
+}
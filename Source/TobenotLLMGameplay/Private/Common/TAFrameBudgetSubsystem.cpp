@@ -0,0 +1,163 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Common/TAFrameBudgetSubsystem.h"
+
+#include "TASettings.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/EngineVersionComparison.h"
+
+static FAutoConsoleCommandWithWorldAndArgs GTAFrameBudgetReportCommand(
+	TEXT("TA.FrameBudget.Report"),
+	TEXT("打印分帧执行器各系统的耗时和超预算次数，加参数 reset 清空统计"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UTAFrameBudgetSubsystem* FrameBudget = World ? World->GetSubsystem<UTAFrameBudgetSubsystem>() : nullptr)
+		{
+			UE_LOG(LogTemp, Log, TEXT("%s"), *FrameBudget->GetReportString());
+			if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			{
+				FrameBudget->ResetStats();
+			}
+		}
+	}));
+
+void UTAFrameBudgetSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	if (const UTASettings* Settings = GetDefault<UTASettings>())
+	{
+		BudgetMs = FMath::Max(0.1f, Settings->FrameBudgetMilliseconds);
+	}
+}
+
+void UTAFrameBudgetSubsystem::Deinitialize()
+{
+	WorkItems.Empty();
+	Super::Deinitialize();
+}
+
+TStatId UTAFrameBudgetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTAFrameBudgetSubsystem, STATGROUP_Tickables);
+}
+
+void UTAFrameBudgetSubsystem::SubmitWork(const UObject* Owner, FName SystemName, TFunction<bool()> Step)
+{
+	if (!Step)
+	{
+		return;
+	}
+	FWorkItem& Item = WorkItems.AddDefaulted_GetRef();
+	Item.Owner = Owner;
+	Item.SystemName = SystemName;
+	Item.Step = MoveTemp(Step);
+}
+
+void UTAFrameBudgetSubsystem::SubmitForEach(const UObject* Owner, FName SystemName, int32 Num, TFunction<void(int32)> Body)
+{
+	if (Num <= 0 || !Body)
+	{
+		return;
+	}
+	SubmitWork(Owner, SystemName, [Num, Body = MoveTemp(Body), Index = 0]() mutable
+	{
+		Body(Index++);
+		return Index >= Num;
+	});
+}
+
+void UTAFrameBudgetSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	if (WorkItems.Num() == 0)
+	{
+		return;
+	}
+
+	const double FrameStart = FPlatformTime::Seconds();
+	double ElapsedMs = 0.0;
+	TSet<FName> SystemsThisFrame;
+	
+	// 至少推进一步，预算再小也不会饿死
+	do
+	{
+		if (NextItemIndex >= WorkItems.Num())
+		{
+			NextItemIndex = 0;
+		}
+		// Step里可能再提交新工作导致数组扩容，先把要用的东西拿出来
+		const bool bOwnerAlive = WorkItems[NextItemIndex].Owner.IsValid() || WorkItems[NextItemIndex].Owner.IsExplicitlyNull();
+		if (!bOwnerAlive)
+		{
+#if UE_VERSION_OLDER_THAN(5, 4, 0)
+			WorkItems.RemoveAt(NextItemIndex, 1, false);
+#else
+			WorkItems.RemoveAt(NextItemIndex, 1, EAllowShrinking::No);
+#endif
+			continue;
+		}
+		const FName SystemName = WorkItems[NextItemIndex].SystemName;
+		TFunction<bool()> Step = MoveTemp(WorkItems[NextItemIndex].Step);
+		const int32 StepItemIndex = NextItemIndex;
+
+		const double StepStart = FPlatformTime::Seconds();
+		const bool bDone = Step();
+		const double StepMs = (FPlatformTime::Seconds() - StepStart) * 1000.0;
+		
+		FSystemStats& SystemStats = Stats.FindOrAdd(SystemName);
+		++SystemStats.Steps;
+		SystemStats.TotalMs += StepMs;
+		SystemStats.MaxStepMs = FMath::Max(SystemStats.MaxStepMs, StepMs);
+		if (StepMs > BudgetMs)
+		{
+			++SystemStats.StepOverruns;
+			UE_LOG(LogTemp, Verbose, TEXT("TAFrameBudget: [%s] 单步耗时 %.2f ms 超过预算 %.2f ms"), *SystemName.ToString(), StepMs, BudgetMs);
+		}
+		SystemsThisFrame.Add(SystemName);
+
+		if (bDone)
+		{
+			++SystemStats.CompletedItems;
+#if UE_VERSION_OLDER_THAN(5, 4, 0)
+			WorkItems.RemoveAt(StepItemIndex, 1, false);
+#else
+			WorkItems.RemoveAt(StepItemIndex, 1, EAllowShrinking::No);
+#endif
+		}
+		else
+		{
+			WorkItems[StepItemIndex].Step = MoveTemp(Step);
+			NextItemIndex = StepItemIndex + 1;
+		}
+		ElapsedMs = (FPlatformTime::Seconds() - FrameStart) * 1000.0;
+	}
+	while (WorkItems.Num() > 0 && ElapsedMs < BudgetMs);
+
+	if (ElapsedMs > BudgetMs)
+	{
+		for (const FName& SystemName : SystemsThisFrame)
+		{
+			++Stats.FindOrAdd(SystemName).FrameOverruns;
+		}
+	}
+}
+
+FString UTAFrameBudgetSubsystem::GetReportString() const
+{
+	FString Report = FString::Printf(TEXT("TAFrameBudget: 预算 %.2f ms/帧，待处理工作 %d\n"), BudgetMs, WorkItems.Num());
+	for (const TPair<FName, FSystemStats>& Pair : Stats)
+	{
+		const FSystemStats& SystemStats = Pair.Value;
+		Report += FString::Printf(TEXT("  [%s] 步数 %d，完成 %d，总耗时 %.2f ms，平均 %.3f ms，最大单步 %.2f ms，单步超预算 %d，整帧超预算 %d\n"),
+			*Pair.Key.ToString(), SystemStats.Steps, SystemStats.CompletedItems, SystemStats.TotalMs,
+			SystemStats.Steps > 0 ? SystemStats.TotalMs / SystemStats.Steps : 0.0,
+			SystemStats.MaxStepMs, SystemStats.StepOverruns, SystemStats.FrameOverruns);
+	}
+	return Report;
+}
+
+void UTAFrameBudgetSubsystem::ResetStats()
+{
+	Stats.Reset();
+}
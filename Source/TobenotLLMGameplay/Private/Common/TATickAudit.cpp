@@ -0,0 +1,123 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TATickAudit.cpp
+// 运行时检查插件里的Actor和组件有没有开着Tick。插件自己的类都应该是事件驱动的，
+// 列出来的要么是蓝图子类自己加了Tick，要么是有类误开了Tick
+
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/UObjectIterator.h"
+#include "GameFramework/Actor.h"
+#include "Components/ActorComponent.h"
+#include "UObject/Package.h"
+
+namespace TATickAudit
+{
+	// 插件自己的原生类，或者继承自插件原生类的蓝图类
+	bool IsPluginClass(const UClass* Class)
+	{
+		static const FName PluginPackageName(TEXT("/Script/TobenotLLMGameplay"));
+		for (const UClass* Current = Class; Current; Current = Current->GetSuperClass())
+		{
+			if (Current->HasAnyClassFlags(CLASS_Native))
+			{
+				return Current->GetOutermost()->GetFName() == PluginPackageName;
+			}
+		}
+		return false;
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GTATickAuditCommand(
+	TEXT("TA.Tick.Audit"),
+	TEXT("列出当前世界里开着Tick的插件Actor和组件，按类统计数量"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+		TMap<const UClass*, int32> TickingCounts;
+		int32 PluginActorNum = 0;
+		int32 PluginComponentNum = 0;
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			AActor* Actor = *It;
+			if (TATickAudit::IsPluginClass(Actor->GetClass()))
+			{
+				++PluginActorNum;
+				if (Actor->IsActorTickEnabled())
+				{
+					++TickingCounts.FindOrAdd(Actor->GetClass());
+				}
+			}
+			for (UActorComponent* Component : Actor->GetComponents())
+			{
+				if (Component && TATickAudit::IsPluginClass(Component->GetClass()))
+				{
+					++PluginComponentNum;
+					if (Component->IsComponentTickEnabled())
+					{
+						++TickingCounts.FindOrAdd(Component->GetClass());
+					}
+				}
+			}
+		}
+
+		int32 TickingNum = 0;
+		FString Report;
+		for (const TPair<const UClass*, int32>& Pair : TickingCounts)
+		{
+			TickingNum += Pair.Value;
+			Report += FString::Printf(TEXT("\n  %s：%d 个在Tick"), *Pair.Key->GetName(), Pair.Value);
+		}
+		UE_LOG(LogTemp, Log, TEXT("Tick检查：插件Actor %d 个，插件组件 %d 个，其中开着Tick的 %d 个%s"),
+			PluginActorNum, PluginComponentNum, TickingNum, *Report);
+	}));
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// 插件的原生Actor和组件在CDO上就不能开Tick，确实需要Tick的类加到白名单里并写明原因
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTATickFreeTest, "TobenotLLMGameplay.Performance.TickFree",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTATickFreeTest::RunTest(const FString& Parameters)
+{
+	static const TSet<FName> TickAllowlist;
+	static const FName PluginPackageName(TEXT("/Script/TobenotLLMGameplay"));
+
+	int32 NumChecked = 0;
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		if (!Class->HasAnyClassFlags(CLASS_Native) || Class->HasAnyClassFlags(CLASS_Deprecated | CLASS_NewerVersionExists)
+			|| Class->GetOutermost()->GetFName() != PluginPackageName || TickAllowlist.Contains(Class->GetFName()))
+		{
+			continue;
+		}
+		if (Class->IsChildOf<AActor>())
+		{
+			++NumChecked;
+			const AActor* ActorCDO = GetDefault<AActor>(Class);
+			if (ActorCDO->PrimaryActorTick.bCanEverTick)
+			{
+				AddError(FString::Printf(TEXT("%s 的PrimaryActorTick.bCanEverTick为true"), *Class->GetName()));
+			}
+		}
+		else if (Class->IsChildOf<UActorComponent>())
+		{
+			++NumChecked;
+			const UActorComponent* ComponentCDO = GetDefault<UActorComponent>(Class);
+			if (ComponentCDO->PrimaryComponentTick.bCanEverTick)
+			{
+				AddError(FString::Printf(TEXT("%s 的PrimaryComponentTick.bCanEverTick为true"), *Class->GetName()));
+			}
+		}
+	}
+	// 一个都没找到说明包名或者类的注册出了问题，也算失败
+	TestTrue(TEXT("找到了插件的Actor和组件类"), NumChecked > 0);
+	return true;
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "Event/Core/TAEventInstance.h"
 
+#include "Event/Core/TAEventPool.h"
 #include "Event/Core/TAEventSubsystem.h"
 #include "Agent/TAAgentInterface.h"
 #include "Event/TAEventLogCategory.h"
@@ -10,6 +11,36 @@
 #include "Scene/TASceneSubsystem.h"
 #include "Chat/Shout/TAShoutComponent.h"
 
+void UTAEventInstance::InitEventInstance(FTAEventHandle InEventHandle)
+{
+	EventHandle = InEventHandle;
+}
+
+void UTAEventInstance::ResetEventInstance()
+{
+	// 欲望应该在OnEventFinished里撤销过了，这里只是兜底
+	DesireAgentMap.Empty();
+	bTriggered = false;
+	EventHandle = FTAEventHandle();
+}
+
+const FTAEventInfo& UTAEventInstance::GetEventInfo() const
+{
+	// 实例由事件池创建，Outer就是事件池
+	const UTAEventPool* EventPool = GetTypedOuter<UTAEventPool>();
+	if (EventPool && EventHandle.IsValid())
+	{
+		return EventPool->GetEventInfo(EventHandle);
+	}
+	static const FTAEventInfo InvalidEventInfo;
+	return InvalidEventInfo;
+}
+
+bool UTAEventInstance::IsBoundToEvent(int32 EventID) const
+{
+	return EventHandle.IsValid() && GetEventInfo().PresetData.EventID == EventID;
+}
+
 void UTAEventInstance::TriggerEvent()
 {
 	if(bTriggered)
@@ -22,7 +53,7 @@ void UTAEventInstance::TriggerEvent()
 	// 在控制台和屏幕上打印事件信息
 	if (GEngine)
 	{
-		FString Message = EventInfo.ToString();
+		FString Message = GetEventInfo().ToString();
 
 		// 在屏幕上显示消息
 		GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Green, Message);
@@ -45,9 +76,9 @@ void UTAEventInstance::TriggerEvent()
 		return;
 	}
 	
-	if(EventInfo.ActivationType == EEventActivationType::Proximity)
+	if(GetEventInfo().ActivationType == EEventActivationType::Proximity)
 	{
-		SceneSubsystem->CreateAndLoadAreaScene(EventInfo);
+		SceneSubsystem->CreateAndLoadAreaScene(GetEventInfo());
 	}
 
 	AssignDesiresToAgent();
@@ -65,9 +96,9 @@ void UTAEventInstance::AssignDesiresToAgent()
 	{
 		if (UTASaveGameSubsystem* SaveGameSubsystem = World->GetGameInstance()->GetSubsystem<UTASaveGameSubsystem>())
 		{
-			UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 开始分配欲望"), *EventInfo.PresetData.EventName);
+			UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 开始分配欲望"), *GetEventInfo().PresetData.EventName);
 
-			for (const FTAAgentDesire& Desire : EventInfo.PresetData.AgentDesires)
+			for (const FTAAgentDesire& Desire : GetEventInfo().PresetData.AgentDesires)
 			{
 				AActor* FoundActor = SaveGameSubsystem->FindActorByName(Desire.AgentName);
 				if (FoundActor) 
@@ -78,7 +109,7 @@ void UTAEventInstance::AssignDesiresToAgent()
 						FGuid DesireGUID = FGuid::NewGuid();
 
 						// 这里添加了事件ID和名字到欲望描述
-						FString DesireWithEventID = FString::Printf(TEXT("[EventID:%d] %s"), EventInfo.PresetData.EventID, *Desire.DesireDescription);
+						FString DesireWithEventID = FString::Printf(TEXT("[EventID:%d] %s"), GetEventInfo().PresetData.EventID, *Desire.DesireDescription);
 						AgentActor->AddOrUpdateDesire(DesireGUID, DesireWithEventID);
 						
 						if(Desire.ImmediatelyWantToSpeak)
@@ -92,7 +123,7 @@ void UTAEventInstance::AssignDesiresToAgent()
 						
 						DesireAgentMap.Add(DesireGUID, FoundActor);
                     
-						UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 分配给 [%s] 的欲望 ： %s"), *EventInfo.PresetData.EventName, *Desire.AgentName.ToString(), *DesireWithEventID);
+						UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 分配给 [%s] 的欲望 ： %s"), *GetEventInfo().PresetData.EventName, *Desire.AgentName.ToString(), *DesireWithEventID);
 					}
 				}
 			}
@@ -102,7 +133,7 @@ void UTAEventInstance::AssignDesiresToAgent()
 
 void UTAEventInstance::RevokeAgentDesires()
 {
-	UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 开始撤销欲望"), *EventInfo.PresetData.EventName);
+	UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 开始撤销欲望"), *GetEventInfo().PresetData.EventName);
     
 	for (const auto& Pair : DesireAgentMap)
 	{
@@ -114,7 +145,7 @@ void UTAEventInstance::RevokeAgentDesires()
 			if (AgentActor)
 			{
 				AgentActor->RemoveDesire(DesireGUID);
-				UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 分配给 [%s] 的欲望 已撤销"), *EventInfo.PresetData.EventName, *AgentActor->GetAgentName());
+				UE_LOG(LogTAEventSystem, Log, TEXT("事件 [%s] 分配给 [%s] 的欲望 已撤销"), *GetEventInfo().PresetData.EventName, *AgentActor->GetAgentName());
 			}
 		}
 	}
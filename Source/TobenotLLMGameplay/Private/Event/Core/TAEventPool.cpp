@@ -3,20 +3,29 @@
 
 #include "Event/Core/TAEventPool.h"
 
+#include "Common/TAFrameBudgetSubsystem.h"
 #include "Event/TAEventLogCategory.h"
+#include "Event/Core/TAProximityTriggerSubsystem.h"
 #include "Event/Plot/TAPlotManager.h"
-#include "Save/TAGuidSubsystem.h"
-#include "Scene/TAPlaceActor.h"
+#include "Save/TANarrativeSnapshot.h"
+#include "Misc/EngineVersionComparison.h"
 
 // 修改后的 AddEvent 方法
 FTAEventInfo& UTAEventPool::AddEvent(FTAEventInfo EventInfo)
 {
-	FTAEventInfo& EventInfoRef = AllEventInfo.Add_GetRef(EventInfo);
-	if(EventInfoRef.PresetData.EventID == 0)
+	const int32 Index = AllEventInfo.Add(MoveTemp(EventInfo));
+	FTAEventHotData& HotData = EventHotData.AddDefaulted_GetRef();
+	const FTAEventInfo& EventInfoRef = AllEventInfo[Index];
+	HotData.bPlotConditionMet = EventInfoRef.PrecedingPlotTagGroupsConditionMet || EventInfoRef.PresetData.PrecedingPlotTagGroups.Num() == 0;
+	HotData.bHasAgentConditions = EventInfoRef.PresetData.AgentConditions.Num() > 0;
+
+	// 建立反向依赖索引，前置事件完成时直接通知到这里
+	for (const FTAEventDependency& Dependency : EventInfoRef.PresetData.PrecedingEvents)
 	{
-		EventInfoRef.PresetData.EventID = AllEventInfo.Num() + 660000;
+		TArray<FTAEventHandle>& Dependents = DependentsByPrecedingEventID.FindOrAdd(Dependency.PrecedingEventID);
+		Dependents.AddUnique(FTAEventHandle(Index));
 	}
-	PendingEventInfos.Add(AllEventInfo.Last());
+	RegisterEventAt(Index);
 
 	if (!bHasStartedProximityCheck)
 	{
@@ -24,22 +33,112 @@ FTAEventInfo& UTAEventPool::AddEvent(FTAEventInfo EventInfo)
 		bHasStartedProximityCheck = true;
 	}
 	
-	return EventInfoRef;
+	return AllEventInfo[Index];
 }
 
-FTAEventInfo& UTAEventPool::GetEventByID(int32 EventID, bool& bSuccess)
+void UTAEventPool::PrepareEventBatch(FTAEventCatalogBatch& Batch)
 {
-	for (FTAEventInfo& EventInfoRef : AllEventInfo)
+	Batch.HotData.SetNum(Batch.EventInfos.Num());
+	Batch.DependentsByPrecedingEventID.Reset();
+	for (int32 LocalIndex = 0; LocalIndex < Batch.EventInfos.Num(); ++LocalIndex)
+	{
+		const FTAEventInfo& EventInfo = Batch.EventInfos[LocalIndex];
+		FTAEventHotData& HotData = Batch.HotData[LocalIndex];
+		HotData.bPlotConditionMet = EventInfo.PrecedingPlotTagGroupsConditionMet || EventInfo.PresetData.PrecedingPlotTagGroups.Num() == 0;
+		HotData.bHasAgentConditions = EventInfo.PresetData.AgentConditions.Num() > 0;
+		for (const FTAEventDependency& Dependency : EventInfo.PresetData.PrecedingEvents)
+		{
+			Batch.DependentsByPrecedingEventID.FindOrAdd(Dependency.PrecedingEventID).AddUnique(LocalIndex);
+		}
+	}
+	Batch.bPrepared = true;
+}
+
+void UTAEventPool::PublishEventBatch(FTAEventCatalogBatch& Batch)
+{
+	check(IsInGameThread());
+	if (!Batch.bPrepared)
+	{
+		PrepareEventBatch(Batch);
+	}
+	const int32 Num = Batch.EventInfos.Num();
+	if (Num == 0)
 	{
-		if (EventInfoRef.PresetData.EventID == EventID)
+		return;
+	}
+	
+	const int32 BaseIndex = AllEventInfo.Num();
+	AllEventInfo.Reserve(BaseIndex + Num);
+	EventHotData.Reserve(BaseIndex + Num);
+	EventIndexByID.Reserve(EventIndexByID.Num() + Num);
+	PendingEventHandles.Reserve(PendingEventHandles.Num() + Num);
+	AllEventInfo.Append(MoveTemp(Batch.EventInfos));
+	EventHotData.Append(MoveTemp(Batch.HotData));
+	
+	for (TPair<int32, TArray<int32>>& Pair : Batch.DependentsByPrecedingEventID)
+	{
+		TArray<FTAEventHandle>& Dependents = DependentsByPrecedingEventID.FindOrAdd(Pair.Key);
+		Dependents.Reserve(Dependents.Num() + Pair.Value.Num());
+		for (const int32 LocalIndex : Pair.Value)
 		{
-			bSuccess = true;
-			return EventInfoRef;
+			Dependents.Add(FTAEventHandle(BaseIndex + LocalIndex));
 		}
 	}
 	
-	bSuccess = false;
-	return ZeroEvent;
+	// 反向依赖索引上面一次建好，这里逐个登记ID、位点和就绪状态
+	for (int32 Index = BaseIndex; Index < BaseIndex + Num; ++Index)
+	{
+		RegisterEventAt(Index);
+	}
+	Batch = FTAEventCatalogBatch();
+	
+	if (!bHasStartedProximityCheck)
+	{
+		StartTriggerCheck();
+		bHasStartedProximityCheck = true;
+	}
+	UE_LOG(LogTAEventSystem, Log, TEXT("批量发布 %d 个事件，事件池共 %d 个"), Num, AllEventInfo.Num());
+}
+
+void UTAEventPool::RegisterEventAt(int32 Index)
+{
+	FTAEventInfo& EventInfoRef = AllEventInfo[Index];
+	if(EventInfoRef.PresetData.EventID == 0)
+	{
+		EventInfoRef.PresetData.EventID = Index + 1 + 660000;
+	}
+	if (EventIndexByID.Contains(EventInfoRef.PresetData.EventID))
+	{
+		UE_LOG(LogTAEventSystem, Warning, TEXT("AddEvent EventID %d 重复，按ID查找将指向新事件 %s"), EventInfoRef.PresetData.EventID, *EventInfoRef.PresetData.EventName);
+	}
+	EventIndexByID.Add(EventInfoRef.PresetData.EventID, Index);
+
+	FTAEventHotData& HotData = EventHotData[Index];
+	HotData.LocationGuid = EventInfoRef.LocationGuid;
+	const FTAEventHandle Handle(Index);
+	AddPendingEvent(Handle);
+	if (HotData.LocationGuid.IsValid())
+	{
+		if (UTAProximityTriggerSubsystem* ProximitySubsystem = GetWorld()->GetSubsystem<UTAProximityTriggerSubsystem>())
+		{
+			ProximitySubsystem->RegisterTrigger(Handle, HotData.LocationGuid);
+		}
+	}
+	HotData.UnmetDependencyCount = CountUnmetDependencies(Handle);
+	RefreshEventReadiness(Handle);
+}
+
+FTAEventInfo& UTAEventPool::GetEventByID(int32 EventID, bool& bSuccess)
+{
+	const FTAEventHandle Handle = FindEventHandle(EventID);
+	bSuccess = Handle.IsValid();
+	return bSuccess ? AllEventInfo[Handle.Index] : ZeroEvent;
+}
+
+FTAEventHandle UTAEventPool::FindEventHandle(int32 EventID) const
+{
+	const int32* FoundIndex = EventIndexByID.Find(EventID);
+	return FoundIndex ? FTAEventHandle(*FoundIndex) : FTAEventHandle();
 }
 
 // 开启周期性检查
@@ -63,92 +162,245 @@ void UTAEventPool::CheckAndTriggerEvents()
 	// 首先执行原来的接近性检查
 	CheckPlayerProximityToEvents();
 
-	// 检测网状叙事系统前置
+	// 检测网状叙事系统前置。剧情标签是异步拆出来、异步词嵌的，这部分只能定时查
+	// 前置事件还没完成的不用查，等它们完成时会被推进来
 	UTAPlotManager* PlotManager = GetWorld()->GetSubsystem<UTAPlotManager>();
-	if (PlotManager)
+	if (PlotManager && !bIsCheckingPlotConditions)
 	{
-		PlotManager->CheckEventsTagGroupCondition(PendingEventInfos);
-	}
-
-	// 接下来遍历处于待触发状态的事件，检查更复杂的条件
-	for (int32 i = PendingEventInfos.Num() - 1; i >= 0; --i) {
-		const auto& EventInfo = PendingEventInfos[i];
-		bool bDependencyMet = EventInfo.PrecedingPlotTagGroupsConditionMet;
-		if(!bDependencyMet)
+		TArray<FTAEventHandle> UnmetHandles;
+		for (int32 i = PlotWaitingHandles.Num() - 1; i >= 0; --i)
 		{
-			continue;
+			const FTAEventHandle Handle = PlotWaitingHandles[i];
+			FTAEventHotData& HotData = EventHotData[Handle.Index];
+			if (HotData.State != ETAEventState::Pending || HotData.bPlotConditionMet)
+			{
+				HotData.bQueuedPlotCheck = false;
+				PlotWaitingHandles.RemoveAtSwap(i);
+				continue;
+			}
+			UnmetHandles.Add(Handle);
 		}
 		
-		// 检查所有前置事件是否满足条件
-		for (const FTAEventDependency& Dependency : EventInfo.PresetData.PrecedingEvents)
+		// 条件检查要算大量相似度，交给分帧执行器分批做，一批检查完的就绪事件当场处理
+		UTAFrameBudgetSubsystem* FrameBudget = GetWorld()->GetSubsystem<UTAFrameBudgetSubsystem>();
+		if (UnmetHandles.Num() > 0 && FrameBudget)
 		{
-			if (!IsDependencyMet(Dependency))
+			bIsCheckingPlotConditions = true;
+			FrameBudget->SubmitWork(this, TEXT("EventPool.PlotConditions"), [this, UnmetHandles = MoveTemp(UnmetHandles), NextIndex = 0]() mutable
 			{
-				bDependencyMet = false; // 如果有任何一个前置事件的条件没有满足，当前事件将不会被触发
-				break;
-			}
+				const int32 EndIndex = FMath::Min(NextIndex + PlotConditionCheckBatchSize, UnmetHandles.Num());
+				CheckPlotConditions(MakeArrayView(UnmetHandles.GetData() + NextIndex, EndIndex - NextIndex));
+				NextIndex = EndIndex;
+				ProcessReadyEvents();
+				if (NextIndex >= UnmetHandles.Num())
+				{
+					bIsCheckingPlotConditions = false;
+					return true;
+				}
+				return false;
+			});
+		}
+		else if (UnmetHandles.Num() > 0)
+		{
+			CheckPlotConditions(UnmetHandles);
+		}
+	}
+
+	// 接下来只处理已经就绪的事件
+	ProcessReadyEvents();
+}
+
+void UTAEventPool::CheckPlotConditions(TArrayView<const FTAEventHandle> Handles)
+{
+	UTAPlotManager* PlotManager = GetWorld()->GetSubsystem<UTAPlotManager>();
+	if (!PlotManager)
+	{
+		return;
+	}
+	// 分批检查时中间可能有事件被触发，只查还在等剧情前置的
+	TArray<FTAEventHandle> CheckedHandles;
+	TArray<FTAEventInfo*> UnmetEvents;
+	for (const FTAEventHandle Handle : Handles)
+	{
+		const FTAEventHotData& HotData = EventHotData[Handle.Index];
+		if (HotData.State == ETAEventState::Pending && !HotData.bPlotConditionMet)
+		{
+			CheckedHandles.Add(Handle);
+			UnmetEvents.Add(&AllEventInfo[Handle.Index]);
 		}
+	}
+	if (UnmetEvents.Num() == 0)
+	{
+		return;
+	}
+	PlotManager->CheckEventsTagGroupCondition(UnmetEvents);
+	for (const FTAEventHandle Handle : CheckedHandles)
+	{
+		EventHotData[Handle.Index].bPlotConditionMet = AllEventInfo[Handle.Index].PrecedingPlotTagGroupsConditionMet;
+		RefreshEventReadiness(Handle);
+	}
+}
 
-		if(bDependencyMet)
+void UTAEventPool::ProcessReadyEvents()
+{
+	// 先出队再统一触发，触发过程中可能会有事件完成，再次进入这里
+	TArray<FTAEventHandle> HandlesToActivate;
+	for (int32 i = ReadyEventHandles.Num() - 1; i >= 0; --i) {
+		const FTAEventHandle Handle = ReadyEventHandles[i];
+		FTAEventHotData& HotData = EventHotData[Handle.Index];
+		// 可能已经被接近性检查触发了
+		if (HotData.State != ETAEventState::Pending)
 		{
-			bool bConditionsMet = true;
+			HotData.bQueuedReady = false;
+			ReadyEventHandles.RemoveAtSwap(i);
+			continue;
+		}
 
-			// 检查每个事件的所有Agent条件
-			for (auto& Condition : EventInfo.PresetData.AgentConditions) {
+		bool bConditionsMet = true;
+
+		// 检查每个事件的所有Agent条件，不满足就留在就绪队列里下次再查
+		if (HotData.bHasAgentConditions)
+		{
+			for (auto& Condition : AllEventInfo[Handle.Index].PresetData.AgentConditions) {
 				if (!CheckAgentCondition(Condition)) {
 					bConditionsMet = false;
 					break; // 如果任何条件失败了，跳过剩余的检查
 				}
 			}
+		}
 
-			if (bConditionsMet) {
-				// 若所有条件都满足，则触发事件
-				UE_LOG(LogTAEventSystem, Log, TEXT("CheckAndTriggerEvents, trigger %s") , *EventInfo.PresetData.EventName);
-				UTAEventInstance* NewEventInstance = NewObject<UTAEventInstance>(this, UTAEventInstance::StaticClass());
-				if(NewEventInstance) {
-					// 使用生成的事件信息初始化NewEvent
-					NewEventInstance->EventInfo = EventInfo;
-					ActiveEvents.Add(NewEventInstance);
-					NewEventInstance->TriggerEvent();
-				}
-				PendingEventInfos.RemoveAt(i);
-			}
+		if (bConditionsMet) {
+			// 若所有条件都满足，则触发事件
+			UE_LOG(LogTAEventSystem, Log, TEXT("CheckAndTriggerEvents, trigger %s") , *AllEventInfo[Handle.Index].PresetData.EventName);
+			HotData.bQueuedReady = false;
+			ReadyEventHandles.RemoveAtSwap(i);
+			HandlesToActivate.Add(Handle);
 		}
 	}
+
+	for (const FTAEventHandle Handle : HandlesToActivate)
+	{
+		ActivateEvent(Handle);
+	}
+}
+
+void UTAEventPool::RefreshEventReadiness(FTAEventHandle Handle)
+{
+	FTAEventHotData& HotData = EventHotData[Handle.Index];
+	if (HotData.State != ETAEventState::Pending || HotData.bQueuedReady)
+	{
+		return;
+	}
+	if (HotData.UnmetDependencyCount != 0)
+	{
+		return;
+	}
+	if (HotData.bPlotConditionMet)
+	{
+		HotData.bQueuedReady = true;
+		ReadyEventHandles.Add(Handle);
+	}
+	else if (!HotData.bQueuedPlotCheck)
+	{
+		HotData.bQueuedPlotCheck = true;
+		PlotWaitingHandles.Add(Handle);
+	}
+}
+
+void UTAEventPool::AddPendingEvent(FTAEventHandle Handle)
+{
+	FTAEventHotData& HotData = EventHotData[Handle.Index];
+	if (HotData.PendingSlot == INDEX_NONE)
+	{
+		HotData.PendingSlot = PendingEventHandles.Add(Handle);
+	}
+}
+
+void UTAEventPool::RemovePendingEvent(FTAEventHandle Handle)
+{
+	FTAEventHotData& HotData = EventHotData[Handle.Index];
+	const int32 Slot = HotData.PendingSlot;
+	if (Slot == INDEX_NONE)
+	{
+		return;
+	}
+	const FTAEventHandle LastHandle = PendingEventHandles.Last();
+	PendingEventHandles[Slot] = LastHandle;
+	EventHotData[LastHandle.Index].PendingSlot = Slot;
+#if UE_VERSION_OLDER_THAN(5, 4, 0)
+	PendingEventHandles.Pop(false);
+#else
+	PendingEventHandles.Pop(EAllowShrinking::No);
+#endif
+	HotData.PendingSlot = INDEX_NONE;
+}
+
+int32 UTAEventPool::CountUnmetDependencies(FTAEventHandle Handle)
+{
+	int32 UnmetCount = 0;
+	for (const FTAEventDependency& Dependency : AllEventInfo[Handle.Index].PresetData.PrecedingEvents)
+	{
+		if (!IsDependencyMet(Dependency))
+		{
+			++UnmetCount;
+		}
+	}
+	return UnmetCount;
 }
 
 // 定义检查函数
 void UTAEventPool::CheckPlayerProximityToEvents() {
-	// 循环遍历待激活事件信息
-	for (int32 i = PendingEventInfos.Num() - 1; i >= 0; --i) {
-		const auto& EventInfo = PendingEventInfos[i];
-        
-		// 获取玩家位置
-		const APawn* PlayerPawn = GetWorld()->GetFirstPlayerController()->GetPawn();
-		if(PlayerPawn) {
-			FVector PlayerLocation = PlayerPawn->GetActorLocation();
-            
-			// 获取位点Actor
-			UTAGuidSubsystem* GuidSubsystem = GetWorld()->GetSubsystem<UTAGuidSubsystem>();
-			if(GuidSubsystem) {
-				const ATAPlaceActor* PlaceActor = Cast<ATAPlaceActor>(GuidSubsystem->GetActorByGUID(EventInfo.LocationGuid));
-                
-				// 检查玩家是否在位点附近
-				if(PlaceActor && FVector::Dist(PlayerLocation, PlaceActor->GetActorLocation()) <= PlaceActor->PlaceRadius) {
-					// 玩家在范围内，激活事件并从待激活列表移除
-					UE_LOG(LogTAEventSystem, Log, TEXT("CheckPlayerProximityToEvents, trigger one , remain pending %d") , PendingEventInfos.Num() - 1);
-					UTAEventInstance* NewEventInstance = NewObject<UTAEventInstance>(this, UTAEventInstance::StaticClass());
-					if(NewEventInstance) {
-						// 使用生成的事件信息初始化NewEvent
-						NewEventInstance->EventInfo = EventInfo;
-						ActiveEvents.Add(NewEventInstance);
-						NewEventInstance->TriggerEvent();
-					}					
-                    
-					PendingEventInfos.RemoveAt(i);
-				}
-			}
+	// 位点的空间索引在接近触发子系统里，这里每次对所有玩家查一遍
+	UTAProximityTriggerSubsystem* ProximitySubsystem = GetWorld()->GetSubsystem<UTAProximityTriggerSubsystem>();
+	if (!ProximitySubsystem)
+	{
+		return;
+	}
+	TArray<FTAEventHandle> TriggeredHandles;
+	ProximitySubsystem->QueryPlayers(TriggeredHandles);
+	
+	for (const FTAEventHandle Handle : TriggeredHandles)
+	{
+		if (EventHotData[Handle.Index].State != ETAEventState::Pending)
+		{
+			continue;
 		}
+		// 玩家在范围内，激活事件，ActivateEvent里会从待激活列表移除
+		UE_LOG(LogTAEventSystem, Log, TEXT("CheckPlayerProximityToEvents, trigger one , remain pending %d") , PendingEventHandles.Num() - 1);
+		ActivateEvent(Handle);
+	}
+}
+
+void UTAEventPool::ActivateEvent(FTAEventHandle Handle)
+{
+	// 就绪队列、接近触发和读档都会走到这里，一个事件只能有一个实例
+	if (EventHotData[Handle.Index].State != ETAEventState::Pending)
+	{
+		return;
+	}
+	RemovePendingEvent(Handle);
+	EventHotData[Handle.Index].State = ETAEventState::Active;
+	if (EventHotData[Handle.Index].LocationGuid.IsValid())
+	{
+		if (UTAProximityTriggerSubsystem* ProximitySubsystem = GetWorld()->GetSubsystem<UTAProximityTriggerSubsystem>())
+		{
+			ProximitySubsystem->UnregisterTrigger(Handle);
+		}
+	}
+#if UE_VERSION_OLDER_THAN(5, 4, 0)
+	UTAEventInstance* NewEventInstance = InstancePool.Num() > 0 ? InstancePool.Pop(false).Get() : nullptr;
+#else
+	UTAEventInstance* NewEventInstance = InstancePool.Num() > 0 ? InstancePool.Pop(EAllowShrinking::No).Get() : nullptr;
+#endif
+	if (!NewEventInstance)
+	{
+		NewEventInstance = NewObject<UTAEventInstance>(this, UTAEventInstance::StaticClass());
+	}
+	if(NewEventInstance) {
+		// 实例只记句柄，事件信息始终读事件池里的那一份
+		NewEventInstance->InitEventInstance(Handle);
+		ActiveEvents.Add(AllEventInfo[Handle.Index].PresetData.EventID, NewEventInstance);
+		NewEventInstance->TriggerEvent();
 	}
 }
 
@@ -167,23 +419,63 @@ void UTAEventPool::AddCompletedEvent(int32 EventID, int32 OutcomeID)
 {
 	// 将事件添加到已完成的事件映射中
 	CompletedEventsOutcomeMap.Add(EventID, OutcomeID);
-}
+	
+	const FTAEventHandle Handle = FindEventHandle(EventID);
+	if (Handle.IsValid())
+	{
+		EventHotData[Handle.Index].State = ETAEventState::Completed;
+	}
+	RetireEventInstance(EventID, OutcomeID);
 
-UTAEventInstance* UTAEventPool::GetEventInstanceByID(int32 EventID)
-{
-	// 遍历活动事件数组
-	for (UTAEventInstance* EventInstance : ActiveEvents)
+	// 只重新计算依赖这个事件的事件，就绪的当帧触发
+	if (const TArray<FTAEventHandle>* Dependents = DependentsByPrecedingEventID.Find(EventID))
 	{
-		// 检查当前事件实例的事件ID是否匹配
-		if (EventInstance && EventInstance->EventInfo.PresetData.EventID == EventID)
+		for (const FTAEventHandle Dependent : *Dependents)
 		{
-			// 如果找到匹配的事件实例，返回该实例
-			return EventInstance;
+			FTAEventHotData& DependentHotData = EventHotData[Dependent.Index];
+			if (DependentHotData.State == ETAEventState::Pending)
+			{
+				DependentHotData.UnmetDependencyCount = CountUnmetDependencies(Dependent);
+				RefreshEventReadiness(Dependent);
+			}
 		}
+		ProcessReadyEvents();
+	}
+}
+
+void UTAEventPool::RetireEventInstance(int32 EventID, int32 OutcomeID)
+{
+	TObjectPtr<UTAEventInstance> EventInstance;
+	if (!ActiveEvents.RemoveAndCopyValue(EventID, EventInstance) || !EventInstance)
+	{
+		return;
+	}
+	
+	// 归档只留最近的，满了丢最早的一条
+	if (ArchivedEvents.Num() >= MaxArchivedEvents)
+	{
+#if UE_VERSION_OLDER_THAN(5, 4, 0)
+		ArchivedEvents.RemoveAt(0, ArchivedEvents.Num() - MaxArchivedEvents + 1, false);
+#else
+		ArchivedEvents.RemoveAt(0, ArchivedEvents.Num() - MaxArchivedEvents + 1, EAllowShrinking::No);
+#endif
+	}
+	FTAArchivedEventRecord& Record = ArchivedEvents.AddDefaulted_GetRef();
+	Record.Handle = EventInstance->GetEventHandle();
+	Record.OutcomeID = OutcomeID;
+	Record.FinishedTime = GetWorld() ? GetWorld()->GetTimeSeconds() : 0.f;
+	
+	EventInstance->ResetEventInstance();
+	if (InstancePool.Num() < MaxPooledInstances)
+	{
+		InstancePool.Add(EventInstance);
 	}
+}
 
+UTAEventInstance* UTAEventPool::GetEventInstanceByID(int32 EventID)
+{
 	// 如果没有找到匹配的事件实例，返回nullptr
-	return nullptr;
+	return ActiveEvents.FindRef(EventID);
 }
 
 bool UTAEventPool::IsDependencyMet(const FTAEventDependency& Dependency)
@@ -198,3 +490,166 @@ bool UTAEventPool::IsDependencyMet(const FTAEventDependency& Dependency)
 	// 如果该前置事件未完成，返回false
 	return false;
 }
+
+void UTAEventPool::WriteSnapshot(FTASnapshotWriter& Writer) const
+{
+	Writer.WriteUInt(AllEventInfo.Num());
+	for (int32 Index = 0; Index < AllEventInfo.Num(); ++Index)
+	{
+		const FTAEventInfo& EventInfo = AllEventInfo[Index];
+		const FTAPresetEventData& PresetData = EventInfo.PresetData;
+		Writer.WriteUInt(static_cast<uint8>(EventHotData[Index].State));
+		Writer.WriteGuid(EventInfo.LocationGuid);
+		Writer.WriteUInt(static_cast<uint8>(EventInfo.ActivationType));
+		Writer.WriteBool(EventInfo.PrecedingPlotTagGroupsConditionMet);
+		Writer.WriteInt(PresetData.EventID);
+		Writer.WriteString(PresetData.EventName);
+		Writer.WriteString(PresetData.LocationName);
+		Writer.WriteString(PresetData.Description);
+		Writer.WriteUInt(static_cast<uint8>(PresetData.EventType));
+		Writer.WriteInt(PresetData.Weight);
+		Writer.WriteString(PresetData.PeculiarPoint);
+		Writer.WriteUInt(PresetData.AgentConditions.Num());
+		for (const FTAAgentCondition& Condition : PresetData.AgentConditions)
+		{
+			Writer.WriteName(Condition.AgentName);
+			Writer.WriteString(Condition.RequiredState);
+		}
+		Writer.WriteUInt(PresetData.AgentDesires.Num());
+		for (const FTAAgentDesire& Desire : PresetData.AgentDesires)
+		{
+			Writer.WriteName(Desire.AgentName);
+			Writer.WriteString(Desire.DesireDescription);
+			Writer.WriteBool(Desire.ImmediatelyWantToSpeak);
+		}
+		Writer.WriteUInt(PresetData.PrecedingEvents.Num());
+		for (const FTAEventDependency& Dependency : PresetData.PrecedingEvents)
+		{
+			Writer.WriteInt(Dependency.PrecedingEventID);
+			Writer.WriteInt(Dependency.RequiredOutcomeID);
+		}
+		Writer.WriteUInt(PresetData.PrecedingPlotTagGroups.Num());
+		for (const FTATagGroup& TagGroup : PresetData.PrecedingPlotTagGroups)
+		{
+			UTAPlotManager::WriteTagGroup(Writer, TagGroup);
+		}
+	}
+
+	Writer.WriteUInt(CompletedEventsOutcomeMap.Num());
+	for (const TPair<int32, int32>& Pair : CompletedEventsOutcomeMap)
+	{
+		Writer.WriteInt(Pair.Key);
+		Writer.WriteInt(Pair.Value);
+	}
+}
+
+bool UTAEventPool::ReadSnapshot(FTASnapshotReader& Reader)
+{
+	if (AllEventInfo.Num() > 0)
+	{
+		UE_LOG(LogTAEventSystem, Warning, TEXT("ReadSnapshot 事件池不是空的，放弃恢复"));
+		return false;
+	}
+	
+	// 先完整读出来，读的过程中出错就什么都不改
+	FTAEventCatalogBatch Batch;
+	TArray<ETAEventState> States;
+	const int32 EventCount = Reader.ReadCount();
+	Batch.EventInfos.SetNum(EventCount);
+	States.SetNumUninitialized(EventCount);
+	for (int32 Index = 0; Index < EventCount && Reader.IsValid(); ++Index)
+	{
+		FTAEventInfo& EventInfo = Batch.EventInfos[Index];
+		FTAPresetEventData& PresetData = EventInfo.PresetData;
+		States[Index] = static_cast<ETAEventState>(FMath::Min<uint64>(Reader.ReadUInt(), static_cast<uint64>(ETAEventState::Completed)));
+		EventInfo.LocationGuid = Reader.ReadGuid();
+		EventInfo.ActivationType = static_cast<EEventActivationType>(Reader.ReadUInt());
+		EventInfo.PrecedingPlotTagGroupsConditionMet = Reader.ReadBool();
+		PresetData.EventID = static_cast<int32>(Reader.ReadInt());
+		PresetData.EventName = Reader.ReadString();
+		PresetData.LocationName = Reader.ReadString();
+		PresetData.Description = Reader.ReadString();
+		PresetData.EventType = static_cast<ETAEventType>(Reader.ReadUInt());
+		PresetData.Weight = static_cast<int32>(Reader.ReadInt());
+		PresetData.PeculiarPoint = Reader.ReadString();
+		PresetData.AgentConditions.SetNum(Reader.ReadCount());
+		for (FTAAgentCondition& Condition : PresetData.AgentConditions)
+		{
+			Condition.AgentName = Reader.ReadName();
+			Condition.RequiredState = Reader.ReadString();
+		}
+		PresetData.AgentDesires.SetNum(Reader.ReadCount());
+		for (FTAAgentDesire& Desire : PresetData.AgentDesires)
+		{
+			Desire.AgentName = Reader.ReadName();
+			Desire.DesireDescription = Reader.ReadString();
+			Desire.ImmediatelyWantToSpeak = Reader.ReadBool();
+		}
+		PresetData.PrecedingEvents.SetNum(Reader.ReadCount());
+		for (FTAEventDependency& Dependency : PresetData.PrecedingEvents)
+		{
+			Dependency.PrecedingEventID = static_cast<int32>(Reader.ReadInt());
+			Dependency.RequiredOutcomeID = static_cast<int32>(Reader.ReadInt());
+		}
+		PresetData.PrecedingPlotTagGroups.SetNum(Reader.ReadCount());
+		for (FTATagGroup& TagGroup : PresetData.PrecedingPlotTagGroups)
+		{
+			UTAPlotManager::ReadTagGroup(Reader, TagGroup);
+		}
+	}
+
+	TMap<int32, int32> CompletedOutcomes;
+	const int32 CompletedCount = Reader.ReadCount();
+	CompletedOutcomes.Reserve(CompletedCount);
+	for (int32 Index = 0; Index < CompletedCount && Reader.IsValid(); ++Index)
+	{
+		const int32 EventID = static_cast<int32>(Reader.ReadInt());
+		CompletedOutcomes.Add(EventID, static_cast<int32>(Reader.ReadInt()));
+	}
+	
+	if (!Reader.IsValid())
+	{
+		UE_LOG(LogTAEventSystem, Error, TEXT("ReadSnapshot 事件快照损坏"));
+		return false;
+	}
+
+	// 完成记录要在发布前放好，发布时算依赖才是对的
+	CompletedEventsOutcomeMap = MoveTemp(CompletedOutcomes);
+	PublishEventBatch(Batch);
+
+	// 发布时每个事件都进了待触发列表，这里按存档状态重建一次，不逐个移除
+	PendingEventHandles.Reset();
+	for (FTAEventHotData& HotData : EventHotData)
+	{
+		HotData.PendingSlot = INDEX_NONE;
+	}
+	TArray<FTAEventHandle> HandlesToActivate;
+	UTAProximityTriggerSubsystem* ProximitySubsystem = GetWorld()->GetSubsystem<UTAProximityTriggerSubsystem>();
+	for (int32 Index = 0; Index < EventCount; ++Index)
+	{
+		const FTAEventHandle Handle(Index);
+		if (States[Index] == ETAEventState::Completed)
+		{
+			EventHotData[Index].State = ETAEventState::Completed;
+			if (ProximitySubsystem)
+			{
+				ProximitySubsystem->UnregisterTrigger(Handle);
+			}
+		}
+		else if (States[Index] == ETAEventState::Active)
+		{
+			// 新开的世界里场景和欲望都要重新建，直接重新触发
+			HandlesToActivate.Add(Handle);
+		}
+		else
+		{
+			AddPendingEvent(Handle);
+		}
+	}
+	for (const FTAEventHandle Handle : HandlesToActivate)
+	{
+		ActivateEvent(Handle);
+	}
+	UE_LOG(LogTAEventSystem, Log, TEXT("ReadSnapshot 恢复 %d 个事件，已完成 %d 个"), EventCount, CompletedEventsOutcomeMap.Num());
+	return true;
+}
@@ -8,9 +8,13 @@
 #include "Event/Core/TAEventPool.h"
 #include "Event/TAEventLogCategory.h"
 #include "Event/Generator/TAEventGenerator.h"
+#include "Event/Plot/TAPlotManager.h"
 #include "Image/TAImageGenerator.h"
+#include "Save/TANarrativeSnapshot.h"
+#include "HAL/IConsoleManager.h"
 #include "Save/TAGuidInterface.h"
 #include "Scene/TASceneSubsystem.h"
+#include "UObject/UObjectHash.h"
 
 UTAEventPool* UTAEventSubsystem::GetEventPool()
 {
@@ -21,42 +25,118 @@ UTAEventPool* UTAEventSubsystem::GetEventPool()
 	return EventPoolRef;
 }
 
+static FAutoConsoleCommandWithWorld GTAEventStatsCommand(
+	TEXT("TA.Event.Stats"),
+	TEXT("打印活跃、空闲和已归档的事件数，以及事件系统UObject在GC里的估算开销"),
+	FConsoleCommandWithWorldDelegate::CreateStatic([](UWorld* World)
+	{
+		if (UTAEventSubsystem* EventSubsystem = World ? World->GetSubsystem<UTAEventSubsystem>() : nullptr)
+		{
+			UE_LOG(LogTAEventSystem, Log, TEXT("%s"), *EventSubsystem->GetEventStatsString());
+		}
+	}));
+
 void UTAEventSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+	PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddWeakLambda(this, [this]()
+	{
+		GarbageCollectStartTime = FPlatformTime::Seconds();
+	});
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddWeakLambda(this, [this]()
+	{
+		LastGarbageCollectSeconds = FPlatformTime::Seconds() - GarbageCollectStartTime;
+	});
+}
+
+void UTAEventSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	// 储备要在第一次Start之前就开始补，不然第一次Start总是要等大模型
+	// 放到下一帧，等场景系统登记完关卡里的位点，场景信息和Start时一致
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	if (Settings && Settings->EventReserveDepth > 0)
+	{
+		InWorld.GetTimerManager().SetTimerForNextTick(this, &UTAEventSubsystem::WarmUpEventReserve);
+	}
+}
+
+FString UTAEventSubsystem::GetEventStatsString()
+{
+	UTAEventPool* EventPool = GetEventPool();
+	if (!EventPool)
+	{
+		return TEXT("事件池不存在");
+	}
+	// 事件池和它Outer链下的所有对象都算事件系统的
+	TArray<UObject*> EventObjects;
+	GetObjectsWithOuter(EventPool, EventObjects, true);
+	const int32 EventObjectNum = EventObjects.Num() + 1;
+	const int32 TotalObjectNum = FMath::Max(1, GUObjectArray.GetObjectArrayNumMinusAvailable());
+	
+	// GC的标记阶段大致和对象数成正比，按对象数占比分摊上一次GC的耗时，只是个估算
+	const double EventShare = static_cast<double>(EventObjectNum) / TotalObjectNum;
+	return FString::Printf(TEXT("事件：活跃实例 %d，空闲实例 %d，已归档 %d，事件总数 %d\n")
+		TEXT("UObject：事件系统 %d / 全部 %d (%.2f%%)，上次GC %.2f ms，估算事件系统占 %.3f ms"),
+		EventPool->GetNumLiveInstances(), EventPool->GetNumPooledInstances(), EventPool->GetArchivedEvents().Num(), EventPool->GetNumEvents(),
+		EventObjectNum, TotalObjectNum, EventShare * 100.0,
+		LastGarbageCollectSeconds * 1000.0, LastGarbageCollectSeconds * EventShare * 1000.0);
 }
 
 // HandleGeneratedEvents 方法，用于处理生成器成功生成的事件
 void UTAEventSubsystem::HandleGeneratedEvents(TArray<FTAEventInfo>& GeneratedEvents)
 {
 	UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
+	if (!SceneSubsystem)
+	{
+		UE_LOG(LogTAEventSystem, Error, TEXT("HandleGeneratedEvents 无法获取SceneSubsystem"));
+		return;
+	}
 
-	for (FTAEventInfo& EventInfo : GeneratedEvents)
+	// 通过场景子系统查询地点信息，一批事件共用一次异步导航查询，选好位点后再入池
+	TWeakObjectPtr<UTAEventSubsystem> WeakThis(this);
+	SceneSubsystem->QueryEventLocationsAsync(GeneratedEvents, [WeakThis, GeneratedEvents](const TArray<ATAPlaceActor*>& PlaceActors) mutable
 	{
-		// 通过场景子系统查询地点信息，获得位点Actor
-		ATAPlaceActor* PlaceActor = SceneSubsystem->QueryEventLocationByInfo(EventInfo);
-        
-		if (PlaceActor)
+		UTAEventSubsystem* EventSubsystem = WeakThis.Get();
+		if (!EventSubsystem)
 		{
-			// 获取位点Actor的Guid
-			ITAGuidInterface* GuidInterface = Cast<ITAGuidInterface>(PlaceActor);
-			FGuid LocationGuid = GuidInterface->GetTAGuid();
+			return;
+		}
+		for (int32 Index = 0; Index < GeneratedEvents.Num() && Index < PlaceActors.Num(); ++Index)
+		{
+			EventSubsystem->AddGeneratedEventAtPlace(GeneratedEvents[Index], PlaceActors[Index]);
+		}
+	});
+}
 
-			// 为事件设置地点GUID
-			EventInfo.LocationGuid = LocationGuid;
-			EventInfo.ActivationType = EEventActivationType::Proximity;
+void UTAEventSubsystem::AddGeneratedEventAtPlace(FTAEventInfo& EventInfo, ATAPlaceActor* PlaceActor)
+{
+	if (PlaceActor)
+	{
+		// 获取位点Actor的Guid
+		ITAGuidInterface* GuidInterface = Cast<ITAGuidInterface>(PlaceActor);
+		FGuid LocationGuid = GuidInterface->GetTAGuid();
 
-			UTAEventPool* EventPool = GetEventPool();
-			// 将事件和它的地点GUID添加到事件池
-			auto& Info = EventPool->AddEvent(EventInfo);
+		// 为事件设置地点GUID
+		EventInfo.LocationGuid = LocationGuid;
+		EventInfo.ActivationType = EEventActivationType::Proximity;
 
-			// 如果有必要，生成事件对应的图像或者其他资源
-			GenerateImageForEvent(Info);
-		}
-		else
+		UTAEventPool* EventPool = GetEventPool();
+		// 将事件和它的地点GUID添加到事件池
+		auto& Info = EventPool->AddEvent(EventInfo);
+
+		// 事件记进位点所在区域，区域描述会在后台更新
+		if (UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>())
 		{
-			UE_LOG(LogTAEventSystem, Warning, TEXT("无法为EventID %d 找到对应的位点Actor"), EventInfo.PresetData.EventID);
+			SceneSubsystem->AddRegionFact(PlaceActor->GetActorLocation(), Info.PresetData.EventName + TEXT(": ") + Info.PresetData.Description);
 		}
+
+		// 如果有必要，生成事件对应的图像或者其他资源
+		GenerateImageForEvent(Info);
+	}
+	else
+	{
+		UE_LOG(LogTAEventSystem, Warning, TEXT("无法为EventID %d 找到对应的位点Actor"), EventInfo.PresetData.EventID);
 	}
 }
 
@@ -72,6 +152,74 @@ void UTAEventSubsystem::AddEventToPoolByData(FTAPresetEventData EventData)
 	}
 }
 
+void UTAEventSubsystem::PublishEventCatalog(FTAEventCatalogBatch& Batch)
+{
+	if(UTAEventPool* EventPool = GetEventPool())
+	{
+		EventPool->PublishEventBatch(Batch);
+	}
+}
+
+void UTAEventSubsystem::WriteNarrativeSnapshot(TArray<uint8>& OutBytes)
+{
+	FTASnapshotWriter Writer;
+	// 位点在事件前面，恢复时事件池登记触发器的时候位点已经在了
+	UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
+	Writer.WriteBool(SceneSubsystem != nullptr);
+	if (SceneSubsystem)
+	{
+		SceneSubsystem->WritePlacesSnapshot(Writer);
+	}
+	if (UTAEventPool* EventPool = GetEventPool())
+	{
+		EventPool->WriteSnapshot(Writer);
+	}
+	UTAPlotManager* PlotManager = GetWorld()->GetSubsystem<UTAPlotManager>();
+	Writer.WriteBool(PlotManager != nullptr);
+	if (PlotManager)
+	{
+		PlotManager->WriteSnapshot(Writer);
+	}
+	Writer.Finish(OutBytes);
+}
+
+bool UTAEventSubsystem::RestoreNarrativeSnapshot(const TArray<uint8>& Bytes)
+{
+	FTASnapshotReader Reader(Bytes);
+	if (!Reader.IsValid())
+	{
+		UE_LOG(LogTAEventSystem, Warning, TEXT("RestoreNarrativeSnapshot 快照无效或版本不支持"));
+		return false;
+	}
+	// 版本1的快照没有位点
+	UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
+	TArray<ATAPlaceActor*> RestoredPlaces;
+	if (Reader.GetVersion() >= 2 && Reader.ReadBool())
+	{
+		if (!SceneSubsystem || !SceneSubsystem->ReadPlacesSnapshot(Reader, RestoredPlaces))
+		{
+			UE_LOG(LogTAEventSystem, Warning, TEXT("RestoreNarrativeSnapshot 位点恢复失败"));
+			return false;
+		}
+	}
+	UTAEventPool* EventPool = GetEventPool();
+	if (!EventPool || !EventPool->ReadSnapshot(Reader))
+	{
+		// 事件池没恢复，刚建的位点也收回去，不留在世界里
+		for (ATAPlaceActor* PlaceActor : RestoredPlaces)
+		{
+			SceneSubsystem->RemovePlace(PlaceActor);
+		}
+		return false;
+	}
+	UTAPlotManager* PlotManager = GetWorld()->GetSubsystem<UTAPlotManager>();
+	if (Reader.ReadBool() && PlotManager)
+	{
+		PlotManager->ReadSnapshot(Reader);
+	}
+	return true;
+}
+
 void UTAEventSubsystem::FinishEvent(int32 EventID, int32 OutcomeID)
 {
 	if (UTAEventPool* EventPool = GetEventPool())
@@ -90,6 +238,13 @@ void UTAEventSubsystem::Deinitialize()
 {
 	// 清理事件池里面的事件实例等
 	// ...
+	if (UWorld* World = GetWorld())
+	{
+		World->GetTimerManager().ClearTimer(ReserveRefillTimerHandle);
+	}
+	ReservedEvents.Empty();
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
 
 	Super::Deinitialize();
 }
@@ -99,39 +254,171 @@ void UTAEventSubsystem::Start(const int32& GenEventNum)
 	// 确保事件池创建成功
 	if (UTAEventPool* EventPool = GetEventPool())
 	{
-		UClass* EventGeneratorClass;
-		const UTASettings* Settings = GetDefault<UTASettings>();
-		if (Settings)
+		UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
+		if (!SceneSubsystem)
 		{
-			FString ClassPath = Settings->EventGeneratorClass.ToString();
-			EventGeneratorClass = LoadClass<UTAEventGenerator>(nullptr, *ClassPath);
-			if (EventGeneratorClass != nullptr)
-			{
-				// 创建事件生成器实例
-				UTAEventGenerator* EventGenerator = NewObject<UTAEventGenerator>(this, EventGeneratorClass);
-				if (EventGenerator)
-				{
-					// 给生成成功的委托绑定一个lambda函数，用以处理生成的事件
-					EventGenerator->OnEventGenerationSuccess.AddDynamic(this, &UTAEventSubsystem::HandleGeneratedEvents);
-			
-					UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
-					if (SceneSubsystem)
-					{
-						FString CurrentSceneInfo = SceneSubsystem->QuerySceneMapInfo();
-                
-						// 请求生成事件，传入场景信息
-						EventGenerator->RequestEventGeneration(CurrentSceneInfo, GenEventNum);
-					}
-				}
-			}else
+			return;
+		}
+		FString CurrentSceneInfo = SceneSubsystem->QuerySceneMapInfo();
+		
+		// 先从储备里取，取到的直接放置，不用等大模型
+		PruneStaleReservedEvents(GetTypeHash(CurrentSceneInfo));
+		TArray<FTAEventInfo> ReservedEventInfos;
+		const int32 DrawnNum = DrawReservedEvents(GenEventNum, ReservedEventInfos);
+		if (DrawnNum > 0)
+		{
+			UE_LOG(LogTAEventSystem, Log, TEXT("从事件储备中取出 %d 个事件，储备剩余 %d"), DrawnNum, ReservedEvents.Num());
+			HandleGeneratedEvents(ReservedEventInfos);
+		}
+
+		const int32 RemainingNum = GenEventNum - DrawnNum;
+		if (RemainingNum > 0)
+		{
+			// 创建事件生成器实例
+			if (UTAEventGenerator* EventGenerator = CreateEventGenerator())
 			{
-				UE_LOG(LogTAEventSystem, Error, TEXT("EventGeneratorClass 未配置，你可以在项目设置里找到设置位置，建议自己继承一个事件生成器类UTAEventGenerator"));
+				// 给生成成功的委托绑定一个lambda函数，用以处理生成的事件
+				EventGenerator->OnEventGenerationSuccess.AddDynamic(this, &UTAEventSubsystem::HandleGeneratedEvents);
+				
+				// 请求生成事件，传入场景信息
+				EventGenerator->RequestEventGeneration(CurrentSceneInfo, RemainingNum);
 			}
 		}
 		
+		WarmUpEventReserve();
+	}
+}
+
+UTAEventGenerator* UTAEventSubsystem::CreateEventGenerator()
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	if (!Settings)
+	{
+		return nullptr;
+	}
+	FString ClassPath = Settings->EventGeneratorClass.ToString();
+	UClass* EventGeneratorClass = LoadClass<UTAEventGenerator>(nullptr, *ClassPath);
+	if (EventGeneratorClass == nullptr)
+	{
+		UE_LOG(LogTAEventSystem, Error, TEXT("EventGeneratorClass 未配置，你可以在项目设置里找到设置位置，建议自己继承一个事件生成器类UTAEventGenerator"));
+		return nullptr;
+	}
+	return NewObject<UTAEventGenerator>(this, EventGeneratorClass);
+}
+
+void UTAEventSubsystem::WarmUpEventReserve()
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	if (!Settings || Settings->EventReserveDepth <= 0 || GetWorld()->GetTimerManager().IsTimerActive(ReserveRefillTimerHandle))
+	{
+		return;
+	}
+	GetWorld()->GetTimerManager().SetTimer(ReserveRefillTimerHandle, this, &UTAEventSubsystem::RefillEventReserve, Settings->EventReserveRefillInterval, true);
+	RefillEventReserve();
+}
+
+void UTAEventSubsystem::RefillEventReserve()
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
+	if (!Settings || !SceneSubsystem)
+	{
+		return;
+	}
+
+	// 生成结束会清掉发起时间，超过两分钟还没结束就当它丢了
+	const double Now = FPlatformTime::Seconds();
+	if (ReserveRefillStartTime >= 0.0)
+	{
+		if (Now - ReserveRefillStartTime < 120.0)
+		{
+			return;
+		}
+		UE_LOG(LogTAEventSystem, Warning, TEXT("事件储备补货请求超时，重新发起"));
+	}
+	
+	const FString CurrentSceneInfo = SceneSubsystem->QuerySceneMapInfo();
+	const uint32 SceneInfoHash = GetTypeHash(CurrentSceneInfo);
+	PruneStaleReservedEvents(SceneInfoHash);
+	
+	const int32 MissingNum = Settings->EventReserveDepth - ReservedEvents.Num();
+	if (MissingNum <= 0)
+	{
+		ReserveRefillStartTime = -1.0;
+		return;
+	}
+	
+	UTAEventGenerator* EventGenerator = CreateEventGenerator();
+	if (!EventGenerator)
+	{
+		return;
+	}
+	ReserveRefillStartTime = Now;
+	ReserveRefillSceneInfoHash = SceneInfoHash;
+	EventGenerator->OnEventGenerationSuccess.AddDynamic(this, &UTAEventSubsystem::HandleReserveGeneratedEvents);
+	EventGenerator->OnEventGenerationFinished.AddDynamic(this, &UTAEventSubsystem::HandleReserveGenerationFinished);
+	EventGenerator->RequestEventGeneration(CurrentSceneInfo, MissingNum);
+	UE_LOG(LogTAEventSystem, Log, TEXT("事件储备补货：请求 %d 个"), MissingNum);
+}
+
+void UTAEventSubsystem::HandleReserveGenerationFinished()
+{
+	// 拆分请求时每个子请求都会单独回调一次成功，要等全部结束才能发起下一次补货
+	ReserveRefillStartTime = -1.0;
+}
+
+void UTAEventSubsystem::HandleReserveGeneratedEvents(TArray<FTAEventInfo>& GeneratedEvents)
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	const int32 Depth = Settings ? Settings->EventReserveDepth : 0;
+	const double Now = FPlatformTime::Seconds();
+	
+	for (FTAEventInfo& EventInfo : GeneratedEvents)
+	{
+		// 只收下字段完整的事件，放置留到取用时再做，避免储备的事件在地图上提前出现位点
+		if (EventInfo.PresetData.LocationName.IsEmpty() || EventInfo.PresetData.Description.IsEmpty())
+		{
+			UE_LOG(LogTAEventSystem, Warning, TEXT("事件储备：丢弃不完整的事件 %s"), *EventInfo.PresetData.EventName);
+			continue;
+		}
+		if (ReservedEvents.Num() >= Depth)
+		{
+			break;
+		}
+		FTAReservedEvent& Reserved = ReservedEvents.AddDefaulted_GetRef();
+		Reserved.EventInfo = MoveTemp(EventInfo);
+		Reserved.SceneInfoHash = ReserveRefillSceneInfoHash;
+		Reserved.CreatedTime = Now;
+	}
+	UE_LOG(LogTAEventSystem, Log, TEXT("事件储备补货完成，当前储备 %d/%d"), ReservedEvents.Num(), Depth);
+}
+
+void UTAEventSubsystem::PruneStaleReservedEvents(uint32 CurrentSceneInfoHash)
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	const double MaxAge = Settings ? Settings->EventReserveMaxAgeSeconds : 0.0;
+	const double Now = FPlatformTime::Seconds();
+	const int32 RemovedNum = ReservedEvents.RemoveAll([CurrentSceneInfoHash, MaxAge, Now](const FTAReservedEvent& Reserved)
+	{
+		return Reserved.SceneInfoHash != CurrentSceneInfoHash || (MaxAge > 0.0 && Now - Reserved.CreatedTime > MaxAge);
+	});
+	if (RemovedNum > 0)
+	{
+		UE_LOG(LogTAEventSystem, Log, TEXT("事件储备：%d 个事件因场景变化或过期被丢弃"), RemovedNum);
 	}
 }
 
+int32 UTAEventSubsystem::DrawReservedEvents(int32 Num, TArray<FTAEventInfo>& OutEvents)
+{
+	const int32 DrawnNum = FMath::Clamp(Num, 0, ReservedEvents.Num());
+	for (int32 Index = 0; Index < DrawnNum; ++Index)
+	{
+		OutEvents.Add(MoveTemp(ReservedEvents[Index].EventInfo));
+	}
+	ReservedEvents.RemoveAt(0, DrawnNum);
+	return DrawnNum;
+}
+
 bool UTAEventSubsystem::HasAnyEventsInPool() const
 {
 	if (EventPoolRef)
@@ -147,36 +434,22 @@ bool UTAEventSubsystem::HasAnyEventsInPool() const
 
 void UTAEventSubsystem::GenerateEventByDescriptionInLocation(const FString& Description, const FVector& InLocation)
 {
-	if (UTAEventPool* EventPool = GetEventPool())
+	// 指定了主题，储备里的事件用不上，只能现生成
+	if (GetEventPool())
 	{
-		UClass* EventGeneratorClass;
-		const UTASettings* Settings = GetDefault<UTASettings>();
-		if (Settings)
+		if (UTAEventGenerator* EventGenerator = CreateEventGenerator())
 		{
-			FString ClassPath = Settings->EventGeneratorClass.ToString();
-			EventGeneratorClass = LoadClass<UTAEventGenerator>(nullptr, *ClassPath);
-			if (EventGeneratorClass != nullptr)
-			{
-				// 创建事件生成器实例
-				UTAEventGenerator* EventGenerator = NewObject<UTAEventGenerator>(this, EventGeneratorClass);
-				if (EventGenerator)
-				{
-					EventGenerator->OnEventGenerationSuccessInLocation.AddDynamic(this, &UTAEventSubsystem::HandleGeneratedEventsByDescriptionInLocation);
-			
-					UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
-					if (SceneSubsystem)
-					{
-						FString CurrentSceneInfo = SceneSubsystem->QuerySceneMapInfo();
-						
-						EventGenerator->RequestEventGenerationByDescription(CurrentSceneInfo, Description, InLocation);
-					}
-				}
-			}else
+			EventGenerator->OnEventGenerationSuccessInLocation.AddDynamic(this, &UTAEventSubsystem::HandleGeneratedEventsByDescriptionInLocation);
+	
+			UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>();
+			if (SceneSubsystem)
 			{
-				UE_LOG(LogTAEventSystem, Error, TEXT("EventGeneratorClass 未配置，你可以在项目设置里找到设置位置，建议自己继承一个事件生成器类UTAEventGenerator"));
+				// 指定了位置，把位置所在区域的描述也带上
+				const FString CurrentSceneInfo = SceneSubsystem->QuerySceneMapInfo() + TEXT("\n") + SceneSubsystem->QueryLocationInfo(InLocation);
+				
+				EventGenerator->RequestEventGenerationByDescription(CurrentSceneInfo, Description, InLocation);
 			}
 		}
-		
 	}
 }
 
@@ -217,6 +490,7 @@ void UTAEventSubsystem::HandleGeneratedEventsByDescriptionInLocation(TArray<FTAE
 			UTAEventPool* EventPool = GetEventPool();
 			// 将事件和它的地点GUID添加到事件池
 			auto& Info = EventPool->AddEvent(EventInfo);
+			SceneSubsystem->AddRegionFact(InLocation, Info.PresetData.EventName + TEXT(": ") + Info.PresetData.Description);
 
 			// 如果有必要，生成事件对应的图像或者其他资源
 			GenerateImageForEvent(Info);
@@ -0,0 +1,186 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Event/Core/TAProximityTriggerSubsystem.h"
+
+#include "TASettings.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Save/TAGuidSubsystem.h"
+#include "Scene/TAPlaceActor.h"
+
+void UTAProximityTriggerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	if (const UTASettings* Settings = GetDefault<UTASettings>())
+	{
+		CellSize = FMath::Max(100.f, Settings->ProximityGridCellSize);
+	}
+}
+
+void UTAProximityTriggerSubsystem::Deinitialize()
+{
+	Triggers.Empty();
+	TriggerIndexByHandle.Empty();
+	Cells.Empty();
+	UnresolvedTriggers.Empty();
+	Super::Deinitialize();
+}
+
+void UTAProximityTriggerSubsystem::RegisterTrigger(FTAEventHandle EventHandle, const FGuid& LocationGuid)
+{
+	if (!EventHandle.IsValid() || !LocationGuid.IsValid())
+	{
+		return;
+	}
+	UnregisterTrigger(EventHandle);
+	if (!TryAddResolvedTrigger(EventHandle, LocationGuid))
+	{
+		UnresolvedTriggers.Add(EventHandle, LocationGuid);
+	}
+}
+
+void UTAProximityTriggerSubsystem::UnregisterTrigger(FTAEventHandle EventHandle)
+{
+	UnresolvedTriggers.Remove(EventHandle);
+	int32 TriggerIndex = INDEX_NONE;
+	if (TriggerIndexByHandle.RemoveAndCopyValue(EventHandle, TriggerIndex))
+	{
+		RemoveTriggerAt(TriggerIndex);
+	}
+}
+
+void UTAProximityTriggerSubsystem::ReleaseTriggersAtLocation(const FGuid& LocationGuid)
+{
+	if (!LocationGuid.IsValid())
+	{
+		return;
+	}
+	// 移除位点不常发生，直接扫一遍
+	TArray<int32> TriggerIndices;
+	for (auto It = Triggers.CreateConstIterator(); It; ++It)
+	{
+		if (It->LocationGuid == LocationGuid)
+		{
+			TriggerIndices.Add(It.GetIndex());
+		}
+	}
+	for (const int32 TriggerIndex : TriggerIndices)
+	{
+		const FTAEventHandle EventHandle = Triggers[TriggerIndex].EventHandle;
+		TriggerIndexByHandle.Remove(EventHandle);
+		RemoveTriggerAt(TriggerIndex);
+		UnresolvedTriggers.Add(EventHandle, LocationGuid);
+	}
+}
+
+void UTAProximityTriggerSubsystem::QueryPlayers(TArray<FTAEventHandle>& OutTriggeredEvents)
+{
+	ResolvePendingTriggers();
+	if (Triggers.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<int32> HitTriggerIndices;
+	for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PlayerController = Iterator->Get();
+		const APawn* PlayerPawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+		if (!PlayerPawn)
+		{
+			continue;
+		}
+
+		// 触发器按外接方框登记进了覆盖到的所有格子，所以只查玩家所在的一个格子就够了
+		const FVector PlayerLocation = PlayerPawn->GetActorLocation();
+		const TArray<int32>* CellTriggers = Cells.Find(GetCell(PlayerLocation));
+		if (!CellTriggers)
+		{
+			continue;
+		}
+		for (const int32 TriggerIndex : *CellTriggers)
+		{
+			const FTrigger& Trigger = Triggers[TriggerIndex];
+			if (FVector::DistSquared(PlayerLocation, Trigger.Center) <= FMath::Square(Trigger.Radius))
+			{
+				HitTriggerIndices.AddUnique(TriggerIndex);
+			}
+		}
+	}
+
+	for (const int32 TriggerIndex : HitTriggerIndices)
+	{
+		const FTAEventHandle EventHandle = Triggers[TriggerIndex].EventHandle;
+		OutTriggeredEvents.Add(EventHandle);
+		TriggerIndexByHandle.Remove(EventHandle);
+		RemoveTriggerAt(TriggerIndex);
+	}
+}
+
+FIntPoint UTAProximityTriggerSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+bool UTAProximityTriggerSubsystem::TryAddResolvedTrigger(FTAEventHandle EventHandle, const FGuid& LocationGuid)
+{
+	UTAGuidSubsystem* GuidSubsystem = GetWorld()->GetSubsystem<UTAGuidSubsystem>();
+	const ATAPlaceActor* PlaceActor = GuidSubsystem ? Cast<ATAPlaceActor>(GuidSubsystem->GetActorByGUID(LocationGuid)) : nullptr;
+	if (!PlaceActor)
+	{
+		return false;
+	}
+
+	// 位点生成后不会移动，中心和半径在登记时取一次
+	FTrigger Trigger;
+	Trigger.EventHandle = EventHandle;
+	Trigger.LocationGuid = LocationGuid;
+	Trigger.Center = PlaceActor->GetActorLocation();
+	Trigger.Radius = PlaceActor->PlaceRadius;
+	Trigger.MinCell = GetCell(Trigger.Center - FVector(Trigger.Radius));
+	Trigger.MaxCell = GetCell(Trigger.Center + FVector(Trigger.Radius));
+
+	const int32 TriggerIndex = Triggers.Add(Trigger);
+	TriggerIndexByHandle.Add(EventHandle, TriggerIndex);
+	for (int32 X = Trigger.MinCell.X; X <= Trigger.MaxCell.X; ++X)
+	{
+		for (int32 Y = Trigger.MinCell.Y; Y <= Trigger.MaxCell.Y; ++Y)
+		{
+			Cells.FindOrAdd(FIntPoint(X, Y)).Add(TriggerIndex);
+		}
+	}
+	return true;
+}
+
+void UTAProximityTriggerSubsystem::RemoveTriggerAt(int32 TriggerIndex)
+{
+	const FTrigger& Trigger = Triggers[TriggerIndex];
+	for (int32 X = Trigger.MinCell.X; X <= Trigger.MaxCell.X; ++X)
+	{
+		for (int32 Y = Trigger.MinCell.Y; Y <= Trigger.MaxCell.Y; ++Y)
+		{
+			const FIntPoint Cell(X, Y);
+			if (TArray<int32>* CellTriggers = Cells.Find(Cell))
+			{
+				CellTriggers->RemoveSingleSwap(TriggerIndex);
+				if (CellTriggers->Num() == 0)
+				{
+					Cells.Remove(Cell);
+				}
+			}
+		}
+	}
+	Triggers.RemoveAt(TriggerIndex);
+}
+
+void UTAProximityTriggerSubsystem::ResolvePendingTriggers()
+{
+	for (auto It = UnresolvedTriggers.CreateIterator(); It; ++It)
+	{
+		if (TryAddResolvedTrigger(It.Key(), It.Value()))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
@@ -0,0 +1,272 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Event/Data/TABakeEmbeddingsCommandlet.h"
+
+#include "HttpManager.h"
+#include "HttpModule.h"
+#include "OpenAIDefinitions.h"
+#include "OpenAIEmbedding.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Common/TAEmbeddingSystem.h"
+#include "Containers/Ticker.h"
+#include "Engine/DataTable.h"
+#include "Event/TAEventLogCategory.h"
+#include "Event/Data/TABakedEmbeddingAsset.h"
+#include "Event/Data/TAEventInfo.h"
+#include "Misc/PackageName.h"
+#include "UObject/SavePackage.h"
+
+UTABakeEmbeddingsCommandlet::UTABakeEmbeddingsCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UTABakeEmbeddingsCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	FString TablesParam;
+	FParse::Value(*Params, TEXT("Tables="), TablesParam);
+	int32 Concurrency = 4;
+	FParse::Value(*Params, TEXT("Concurrency="), Concurrency);
+	double TimeoutSeconds = 600.0;
+	FParse::Value(*Params, TEXT("Timeout="), TimeoutSeconds);
+	const bool bForce = FParse::Param(*Params, TEXT("Force"));
+
+	const TArray<UDataTable*> Tables = FindPresetEventTables(TablesParam);
+	if (Tables.Num() == 0)
+	{
+		UE_LOG(LogTAEventSystem, Warning, TEXT("TABakeEmbeddings: 没有找到预设事件数据表"));
+		return 0;
+	}
+
+	const FString ModelName = UTAEmbeddingSystem::GetEmbeddingModelName();
+
+	// 收集每张表的前置标签，已有烘焙结果且模型一致的标签直接复用
+	TMap<UDataTable*, TArray<FName>> TableTags;
+	TMap<FName, TArray<float>> KnownEmbeddings;
+	TArray<FName> MissingTags;
+	for (UDataTable* DataTable : Tables)
+	{
+		TArray<FName>& Tags = TableTags.Add(DataTable);
+		TArray<FTAPresetEventData*> Events;
+		DataTable->GetAllRows<FTAPresetEventData>(TEXT("TABakeEmbeddings"), Events);
+		for (const FTAPresetEventData* EventData : Events)
+		{
+			for (const FTATagGroup& TagGroup : EventData->PrecedingPlotTagGroups)
+			{
+				for (const FName& Tag : TagGroup.Tags)
+				{
+					if (!Tag.IsNone())
+					{
+						Tags.AddUnique(Tag);
+					}
+				}
+			}
+		}
+
+		const UTABakedEmbeddingAsset* ExistingAsset = bForce ? nullptr : UTABakedEmbeddingAsset::LoadForTable(DataTable);
+		if (ExistingAsset && ExistingAsset->ModelName == ModelName)
+		{
+			for (const FTABakedTagEmbedding& Baked : ExistingAsset->Embeddings)
+			{
+				KnownEmbeddings.Add(Baked.Tag, Baked.Components);
+			}
+		}
+	}
+	for (const TPair<UDataTable*, TArray<FName>>& Pair : TableTags)
+	{
+		for (const FName& Tag : Pair.Value)
+		{
+			if (!KnownEmbeddings.Contains(Tag))
+			{
+				MissingTags.AddUnique(Tag);
+			}
+		}
+	}
+
+	UE_LOG(LogTAEventSystem, Display, TEXT("TABakeEmbeddings: %d 张表，需要请求 %d 个标签，复用 %d 个"), Tables.Num(), MissingTags.Num(), KnownEmbeddings.Num());
+	if (MissingTags.Num() > 0 && !EmbedTags(MissingTags, FMath::Max(1, Concurrency), TimeoutSeconds, KnownEmbeddings))
+	{
+		UE_LOG(LogTAEventSystem, Error, TEXT("TABakeEmbeddings: 部分标签词嵌失败，不写入资源"));
+		return 1;
+	}
+
+	int32 Result = 0;
+	for (const TPair<UDataTable*, TArray<FName>>& Pair : TableTags)
+	{
+		const FString PackageName = UTABakedEmbeddingAsset::GetPackageNameForTable(Pair.Key);
+		UPackage* Package = CreatePackage(*PackageName);
+		Package->FullyLoad();
+
+		const FName AssetName(*FPackageName::GetShortName(PackageName));
+		UTABakedEmbeddingAsset* Asset = FindObject<UTABakedEmbeddingAsset>(Package, *AssetName.ToString());
+		const bool bCreated = Asset == nullptr;
+		if (bCreated)
+		{
+			Asset = NewObject<UTABakedEmbeddingAsset>(Package, AssetName, RF_Public | RF_Standalone);
+		}
+
+		// 按标签名排序，重复烘焙时资源内容稳定，方便版本管理比对
+		TArray<FName> SortedTags = Pair.Value;
+		SortedTags.Sort(FNameLexicalLess());
+
+		Asset->ModelName = ModelName;
+		Asset->Embeddings.Reset(SortedTags.Num());
+		for (const FName& Tag : SortedTags)
+		{
+			FTABakedTagEmbedding& Baked = Asset->Embeddings.AddDefaulted_GetRef();
+			Baked.Tag = Tag;
+			Baked.Components = KnownEmbeddings.FindChecked(Tag);
+		}
+		Package->MarkPackageDirty();
+		if (bCreated)
+		{
+			FAssetRegistryModule::AssetCreated(Asset);
+		}
+
+		const FString FileName = FPackageName::LongPackageNameToFilename(PackageName, FPackageName::GetAssetPackageExtension());
+		FSavePackageArgs SaveArgs;
+		SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+		if (UPackage::SavePackage(Package, Asset, *FileName, SaveArgs))
+		{
+			UE_LOG(LogTAEventSystem, Display, TEXT("TABakeEmbeddings: [%s] 写入 %d 个标签 -> %s"), *Pair.Key->GetName(), SortedTags.Num(), *PackageName);
+		}
+		else
+		{
+			UE_LOG(LogTAEventSystem, Error, TEXT("TABakeEmbeddings: 保存失败 %s"), *FileName);
+			Result = 1;
+		}
+	}
+	return Result;
+#else
+	UE_LOG(LogTAEventSystem, Error, TEXT("TABakeEmbeddings 只能在编辑器中运行"));
+	return 1;
+#endif
+}
+
+TArray<UDataTable*> UTABakeEmbeddingsCommandlet::FindPresetEventTables(const FString& TablesParam) const
+{
+	TArray<UDataTable*> Tables;
+	TArray<FSoftObjectPath> TablePaths;
+	if (!TablesParam.IsEmpty())
+	{
+		TArray<FString> PathStrings;
+		TablesParam.ParseIntoArray(PathStrings, TEXT(","));
+		for (const FString& PathString : PathStrings)
+		{
+			// 允许只写包名
+			const FString ObjectPath = PathString.Contains(TEXT(".")) ? PathString : PathString + TEXT(".") + FPackageName::GetShortName(PathString);
+			TablePaths.Add(FSoftObjectPath(ObjectPath));
+		}
+	}
+	else
+	{
+		IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>(TEXT("AssetRegistry")).Get();
+		AssetRegistry.SearchAllAssets(true);
+		TArray<FAssetData> Assets;
+		AssetRegistry.GetAssetsByClass(UDataTable::StaticClass()->GetClassPathName(), Assets, true);
+		for (const FAssetData& AssetData : Assets)
+		{
+			TablePaths.Add(AssetData.GetSoftObjectPath());
+		}
+	}
+
+	for (const FSoftObjectPath& TablePath : TablePaths)
+	{
+		UDataTable* DataTable = Cast<UDataTable>(TablePath.TryLoad());
+		if (DataTable && DataTable->GetRowStruct() && DataTable->GetRowStruct()->IsChildOf(FTAPresetEventData::StaticStruct()))
+		{
+			Tables.Add(DataTable);
+		}
+		else if (!TablesParam.IsEmpty())
+		{
+			UE_LOG(LogTAEventSystem, Warning, TEXT("TABakeEmbeddings: [%s] 不是预设事件数据表"), *TablePath.ToString());
+		}
+	}
+	return Tables;
+}
+
+bool UTABakeEmbeddingsCommandlet::EmbedTags(const TArray<FName>& Tags, int32 Concurrency, double TimeoutSeconds, TMap<FName, TArray<float>>& OutEmbeddings) const
+{
+	struct FBakeState
+	{
+		TArray<FName> Queue;
+		TMap<FName, int32> RetryCounts;
+		TMap<FName, TArray<float>> Results;
+		int32 InFlight = 0;
+		int32 Failed = 0;
+	};
+	const TSharedRef<FBakeState> State = MakeShared<FBakeState>();
+	State->Queue = Tags;
+
+	// 命令行里没有World，也不会跑GC，请求对象挂到根上防止万一
+	TArray<UOpenAIEmbedding*> Requests;
+	const double StartTime = FPlatformTime::Seconds();
+	double LastTime = StartTime;
+
+	while (State->Results.Num() + State->Failed < Tags.Num())
+	{
+		while (State->InFlight < Concurrency && State->Queue.Num() > 0)
+		{
+			const FName Tag = State->Queue.Pop();
+			FEmbeddingSettings EmbeddingSettings;
+			EmbeddingSettings.model = EEmbeddingEngineType::TEXT_EMBEDDING_3_LARGE;
+			EmbeddingSettings.input = Tag.ToString();
+			++State->InFlight;
+			UOpenAIEmbedding* Request = UOpenAIEmbedding::Embedding(EmbeddingSettings, [State, Tag](const FEmbeddingResult& Result, const FString& ErrorMessage, bool Success)
+			{
+				--State->InFlight;
+				if (Success)
+				{
+					TArray<float>& Components = State->Results.Add(Tag);
+					Components.Reserve(Result.embeddingVector.Components.Num());
+					for (const auto& Component : Result.embeddingVector.Components)
+					{
+						Components.Add(static_cast<float>(Component));
+					}
+					return;
+				}
+				int32& RetryCount = State->RetryCounts.FindOrAdd(Tag);
+				if (++RetryCount <= MaxRetryCount)
+				{
+					UE_LOG(LogTAEventSystem, Warning, TEXT("TABakeEmbeddings: [%s] 失败，重试 %d: %s"), *Tag.ToString(), RetryCount, *ErrorMessage);
+					State->Queue.Add(Tag);
+				}
+				else
+				{
+					UE_LOG(LogTAEventSystem, Error, TEXT("TABakeEmbeddings: [%s] 失败: %s"), *Tag.ToString(), *ErrorMessage);
+					++State->Failed;
+				}
+			});
+			if (Request)
+			{
+				Request->AddToRoot();
+				Requests.Add(Request);
+			}
+		}
+
+		const double Now = FPlatformTime::Seconds();
+		const float DeltaTime = static_cast<float>(Now - LastTime);
+		LastTime = Now;
+		FHttpModule::Get().GetHttpManager().Tick(DeltaTime);
+		FTSTicker::GetCoreTicker().Tick(DeltaTime);
+
+		if (Now - StartTime > TimeoutSeconds)
+		{
+			UE_LOG(LogTAEventSystem, Error, TEXT("TABakeEmbeddings: 超时，完成 %d/%d"), State->Results.Num(), Tags.Num());
+			break;
+		}
+		FPlatformProcess::Sleep(0.01f);
+	}
+
+	for (UOpenAIEmbedding* Request : Requests)
+	{
+		Request->RemoveFromRoot();
+	}
+	OutEmbeddings.Append(State->Results);
+	return State->Failed == 0 && State->Results.Num() == Tags.Num();
+}
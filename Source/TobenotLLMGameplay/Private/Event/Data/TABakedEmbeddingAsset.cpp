@@ -0,0 +1,29 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Event/Data/TABakedEmbeddingAsset.h"
+
+#include "Engine/DataTable.h"
+#include "Misc/PackageName.h"
+
+FString UTABakedEmbeddingAsset::GetPackageNameForTable(const UDataTable* DataTable)
+{
+	if (!DataTable)
+	{
+		return FString();
+	}
+	const FString TablePackageName = DataTable->GetOutermost()->GetName();
+	return FPackageName::GetLongPackagePath(TablePackageName) / (DataTable->GetName() + TEXT("_Embeddings"));
+}
+
+UTABakedEmbeddingAsset* UTABakedEmbeddingAsset::LoadForTable(const UDataTable* DataTable)
+{
+	const FString PackageName = GetPackageNameForTable(DataTable);
+	// 先确认包存在，避免没烘焙过的表每次加载都刷加载失败的警告
+	if (PackageName.IsEmpty() || !FPackageName::DoesPackageExist(PackageName))
+	{
+		return nullptr;
+	}
+	const FString ObjectPath = PackageName + TEXT(".") + FPackageName::GetShortName(PackageName);
+	return LoadObject<UTABakedEmbeddingAsset>(nullptr, *ObjectPath);
+}
@@ -3,9 +3,14 @@
 
 #include "Event/Data/TAEventWarehouse.h"
 
+#include "Async/Async.h"
+#include "Common/TAEmbeddingSystem.h"
 #include "Engine/DataTable.h"
 #include "Event/TAEventLogCategory.h"
+#include "Event/Core/TAEventPool.h"
 #include "Event/Core/TAEventSubsystem.h"
+#include "Event/Data/TABakedEmbeddingAsset.h"
+#include "UObject/StrongObjectPtr.h"
 
 void UTAEventWarehouse::LoadEventsFromDataTable(UDataTable* DataTable)
 {
@@ -15,23 +20,99 @@ void UTAEventWarehouse::LoadEventsFromDataTable(UDataTable* DataTable)
 		UE_LOG(LogTAEventSystem, Error, TEXT("LoadEventsFromDataTable 数据表无效"));
 		return;
 	}
+	
+	UE_LOG(LogTAEventSystem, Log, TEXT("导入预设事件数据：[%s]"), *DataTable->GetName());
+	RegisterBakedEmbeddings(DataTable);
+	
+	// 整表一次性建好再发布，不再逐行走AddEvent
+	FTAEventCatalogBatch Batch;
+	BuildEventCatalogBatch(DataTable, Batch);
+	PublishEventCatalogBatch(Batch);
+}
+
+void UTAEventWarehouse::LoadEventsFromDataTableAsync(UDataTable* DataTable)
+{
+	if (!DataTable)
+	{
+		UE_LOG(LogTAEventSystem, Error, TEXT("LoadEventsFromDataTableAsync 数据表无效"));
+		return;
+	}
+	
+	UE_LOG(LogTAEventSystem, Log, TEXT("异步导入预设事件数据：[%s]"), *DataTable->GetName());
+	RegisterBakedEmbeddings(DataTable);
+	++NumImportsInFlight;
+	
+	// 工作线程期间数据表不能被回收，强引用只在游戏线程上创建和释放
+	struct FImportState
+	{
+		TStrongObjectPtr<UDataTable> DataTable;
+		FTAEventCatalogBatch Batch;
+	};
+	TSharedRef<FImportState> State = MakeShared<FImportState>();
+	State->DataTable.Reset(DataTable);
+	TWeakObjectPtr<UTAEventWarehouse> WeakThis(this);
+	
+	Async(EAsyncExecution::ThreadPool, [State, WeakThis]()
+	{
+		BuildEventCatalogBatch(State->DataTable.Get(), State->Batch);
+		
+		AsyncTask(ENamedThreads::GameThread, [State, WeakThis]()
+		{
+			UDataTable* ImportedTable = State->DataTable.Get();
+			if (UTAEventWarehouse* Warehouse = WeakThis.Get())
+			{
+				--Warehouse->NumImportsInFlight;
+				const int32 Num = Warehouse->PublishEventCatalogBatch(State->Batch);
+				Warehouse->OnEventCatalogImported.Broadcast(ImportedTable, Num);
+			}
+			State->DataTable.Reset();
+		});
+	});
+}
 
+void UTAEventWarehouse::RegisterBakedEmbeddings(UDataTable* DataTable)
+{
+	// 有离线烘焙的前置标签词嵌就先放进缓存，事件条件检查时不用等网络
+	if (const UTABakedEmbeddingAsset* BakedAsset = UTABakedEmbeddingAsset::LoadForTable(DataTable))
+	{
+		if (UTAEmbeddingSystem* EmbeddingSystem = GetWorld()->GetGameInstance()->GetSubsystem<UTAEmbeddingSystem>())
+		{
+			EmbeddingSystem->RegisterBakedEmbeddings(BakedAsset);
+		}
+	}
+	else
+	{
+		UE_LOG(LogTAEventSystem, Log, TEXT("数据表 [%s] 没有烘焙词嵌，前置标签将在运行时词嵌"), *DataTable->GetName());
+	}
+}
+
+void UTAEventWarehouse::BuildEventCatalogBatch(const UDataTable* DataTable, FTAEventCatalogBatch& OutBatch)
+{
 	// 获取数据表行
 	TArray<FTAPresetEventData*> Events;
 	DataTable->GetAllRows<FTAPresetEventData>(TEXT("查找所有预设事件数据"), Events);
 	
-	UE_LOG(LogTAEventSystem, Log, TEXT("导入预设事件数据：[%s]"), *DataTable->GetName());
-	
-	// 将事件添加到事件池中
-	for (FTAPresetEventData* EventData : Events)
+	OutBatch.EventInfos.Reserve(Events.Num());
+	for (const FTAPresetEventData* EventData : Events)
 	{
 		if (EventData)
 		{
-			UTAEventSubsystem* EventSubsystem = GetWorld()->GetSubsystem<UTAEventSubsystem>();
-			if (EventSubsystem)
-			{
-				EventSubsystem->AddEventToPoolByData(*EventData);
-			}
+			FTAEventInfo& EventInfo = OutBatch.EventInfos.AddDefaulted_GetRef();
+			EventInfo.PresetData = *EventData;
+			EventInfo.ActivationType = EEventActivationType::PlotProgress;
 		}
 	}
+	UTAEventPool::PrepareEventBatch(OutBatch);
+}
+
+int32 UTAEventWarehouse::PublishEventCatalogBatch(FTAEventCatalogBatch& Batch)
+{
+	const int32 Num = Batch.EventInfos.Num();
+	UTAEventSubsystem* EventSubsystem = GetWorld() ? GetWorld()->GetSubsystem<UTAEventSubsystem>() : nullptr;
+	if (!EventSubsystem)
+	{
+		return 0;
+	}
+	EventSubsystem->PublishEventCatalog(Batch);
+	return Num;
 }
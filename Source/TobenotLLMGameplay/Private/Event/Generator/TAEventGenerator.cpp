@@ -6,14 +6,50 @@
 
 #include "OpenAIDefinitions.h"
 #include "Chat/TAChatCallback.h"
+#include "Common/TAAsyncParse.h"
 #include "Common/TALLMLibrary.h"
 #include "Common/TASystemLibrary.h"
+#include "TASettings.h"
 #include "Event/TAEventLogCategory.h"
 #include "Event/Data/TAEventInfo.h"
 
 void UTAEventGenerator::RequestEventGeneration(const FString& SceneInfo, const int32& Num)
 {
 	InitPrompt();
+	
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	const int32 MaxEventsPerRequest = Settings ? Settings->EventGenerationMaxEventsPerRequest : 0;
+	if (MaxEventsPerRequest > 0 && Num > MaxEventsPerRequest)
+	{
+		StartFanOut(SceneInfo, Num, MaxEventsPerRequest);
+		return;
+	}
+	
+	const FChatSettings ChatSettings = MakeEventGenerationSettings(SceneInfo, Num, FString());
+
+	// 创建回调对象并注册成功和失败委托
+	UTAChatCallback* CallbackObject = NewObject<UTAChatCallback>();
+	CacheCallbackObject = CallbackObject;
+	CallbackObject->OnSuccess.AddDynamic(this, &UTAEventGenerator::OnChatSuccess);
+	CallbackObject->OnFailure.AddDynamic(this, &UTAEventGenerator::OnChatFailure);
+    
+	// 异步发送消息
+	CacheChat = UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [this](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+	{
+		if (Success)
+		{
+			CacheCallbackObject->OnSuccess.Broadcast(Message);
+		}
+		else
+		{
+			CacheCallbackObject->OnFailure.Broadcast();
+		}
+		CacheChat = nullptr;
+	},this);
+}
+
+FChatSettings UTAEventGenerator::MakeEventGenerationSettings(const FString& SceneInfo, int32 Num, const FString& AvoidHint) const
+{
 	TArray<FChatLog> TempMessagesList;
 	FString NumTag;
 	if(Num>1)
@@ -24,38 +60,148 @@ void UTAEventGenerator::RequestEventGeneration(const FString& SceneInfo, const i
 	{
 		NumTag = "// only 1 event please";
 	}
-	const FString SystemPrompt = UTALLMLibrary::PromptToStr(PromptGenerateEvent)
+	FString SystemPrompt = UTALLMLibrary::PromptToStr(PromptGenerateEvent)
 		.Replace(TEXT("{SceneInfo}"), *SceneInfo)
 		.Replace(TEXT("{Language}"), *UTASystemLibrary::GetGameLanguage())
 		.Replace(TEXT("{NumTag}"), *NumTag)
 		;
+	if (!AvoidHint.IsEmpty())
+	{
+		SystemPrompt += TEXT("\nThese events already exist, do not repeat their location or content:\n") + AvoidHint;
+	}
 	TempMessagesList.Add({EOAChatRole::SYSTEM, SystemPrompt});
+	// 拆分的子请求用同一份提示词，温度为0时会得到几乎一样的结果
 	FChatSettings ChatSettings{
 		UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast),
 		TempMessagesList,
-		0
+		FanOutRequestedNum > 0 ? 0.9f : 0.f
 	};
 	ChatSettings.jsonFormat = true;
+	return ChatSettings;
+}
 
-	// 创建回调对象并注册成功和失败委托
-	UTAChatCallback* CallbackObject = NewObject<UTAChatCallback>();
-	CacheCallbackObject = CallbackObject;
-	CallbackObject->OnSuccess.AddDynamic(this, &UTAEventGenerator::OnChatSuccess);
-	CallbackObject->OnFailure.AddDynamic(this, &UTAEventGenerator::OnChatFailure);
-    
-	// 异步发送消息
-	CacheChat = UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [this](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+void UTAEventGenerator::StartFanOut(const FString& SceneInfo, int32 Num, int32 MaxEventsPerRequest)
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	MaxConcurrentRequests = Settings ? FMath::Max(1, Settings->EventGenerationMaxConcurrentRequests) : 1;
+	FanOutSceneInfo = SceneInfo;
+	FanOutRequestedNum = Num;
+	FanOutDeliveredNum = 0;
+	bFanOutToppedUp = false;
+	GeneratedEventKeys.Reset();
+	GeneratedEventSummaries.Reset();
+	PendingChunkSizes.Reset();
+	for (int32 Remaining = Num; Remaining > 0; Remaining -= MaxEventsPerRequest)
 	{
-		if (Success)
+		PendingChunkSizes.Add(FMath::Min(Remaining, MaxEventsPerRequest));
+	}
+	UE_LOG(LogTAEventSystem, Log, TEXT("事件生成：%d 个事件拆成 %d 个子请求"), Num, PendingChunkSizes.Num());
+	DispatchFanOutRequests();
+}
+
+void UTAEventGenerator::DispatchFanOutRequests()
+{
+	while (FanOutChats.Num() < MaxConcurrentRequests && PendingChunkSizes.Num() > 0)
+	{
+		const int32 ChunkSize = PendingChunkSizes[0];
+		PendingChunkSizes.RemoveAt(0);
+		
+		// 补发的请求能看到已经生成的事件，首批并发请求只能靠温度拉开差异
+		const FChatSettings ChatSettings = MakeEventGenerationSettings(FanOutSceneInfo, ChunkSize, FString::Join(GeneratedEventSummaries, TEXT("\n")));
+		
+		// 请求对象存在FanOutChats里防止被回收，发送前先占位，回调里按序号移除
+		const int32 Serial = ++FanOutSerial;
+		FanOutChats.Add(Serial, nullptr);
+		UOpenAIChat* Chat = UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [this, Serial](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
 		{
-			CacheCallbackObject->OnSuccess.Broadcast(Message);
+			HandleFanOutResponse(Serial, Message, Success);
+		}, this);
+		if (UOpenAIChat** ChatSlot = FanOutChats.Find(Serial))
+		{
+			*ChatSlot = Chat;
+		}
+	}
+}
+
+void UTAEventGenerator::HandleFanOutResponse(int32 Serial, const FChatCompletion& Message, bool Success)
+{
+	if (!Success)
+	{
+		UE_LOG(LogTAEventSystem, Warning, TEXT("事件生成：一个子请求失败，其余结果照常使用"));
+		TArray<FTAEventInfo> NoEvents;
+		FinishFanOutResponse(Serial, NoEvents);
+		return;
+	}
+	
+	const FString Content = Message.message.content;
+	TAAsyncParse::ParseThenApply<TArray<FTAEventInfo>>(this,
+		[Content]()
+		{
+			return ParseEventsFromJson(Content);
+		},
+		[this, Serial](TArray<FTAEventInfo>& ParsedEvents)
+		{
+			FinishFanOutResponse(Serial, ParsedEvents);
+		});
+}
+
+void UTAEventGenerator::FinishFanOutResponse(int32 Serial, TArray<FTAEventInfo>& ParsedEvents)
+{
+	FanOutChats.Remove(Serial);
+	
+	TArray<FTAEventInfo> NewEvents = FilterDuplicateEvents(ParsedEvents);
+	
+	// 拆分后总数可能略多于请求数，多出来的丢掉
+	const int32 Allowed = FanOutRequestedNum - FanOutDeliveredNum;
+	if (NewEvents.Num() > Allowed)
+	{
+		NewEvents.SetNum(FMath::Max(0, Allowed));
+	}
+	if (NewEvents.Num() > 0)
+	{
+		FanOutDeliveredNum += NewEvents.Num();
+		OnEventGenerationSuccess.Broadcast(NewEvents);
+	}
+
+	if (PendingChunkSizes.Num() == 0 && FanOutChats.Num() == 0)
+	{
+		const int32 MissingNum = FanOutRequestedNum - FanOutDeliveredNum;
+		if (MissingNum > 0 && !bFanOutToppedUp)
+		{
+			// 去重或失败导致数量不够，带着已有事件再补一次
+			bFanOutToppedUp = true;
+			UE_LOG(LogTAEventSystem, Log, TEXT("事件生成：去重后缺 %d 个，补发一次"), MissingNum);
+			PendingChunkSizes.Add(MissingNum);
 		}
 		else
 		{
-			CacheCallbackObject->OnFailure.Broadcast();
+			UE_LOG(LogTAEventSystem, Log, TEXT("事件生成：完成 %d/%d"), FanOutDeliveredNum, FanOutRequestedNum);
+			FanOutRequestedNum = 0;
+			OnEventGenerationFinished.Broadcast();
+			return;
 		}
-		CacheChat = nullptr;
-	},this);
+	}
+	DispatchFanOutRequests();
+}
+
+TArray<FTAEventInfo> UTAEventGenerator::FilterDuplicateEvents(TArray<FTAEventInfo>& Events)
+{
+	TArray<FTAEventInfo> NewEvents;
+	for (FTAEventInfo& EventInfo : Events)
+	{
+		// 同一地点同一描述算重复，大小写和首尾空白不计
+		const FString Key = EventInfo.PresetData.LocationName.TrimStartAndEnd().ToLower() + TEXT("|") + EventInfo.PresetData.Description.TrimStartAndEnd().ToLower();
+		bool bAlreadyInSet = false;
+		GeneratedEventKeys.Add(Key, &bAlreadyInSet);
+		if (bAlreadyInSet)
+		{
+			UE_LOG(LogTAEventSystem, Log, TEXT("事件生成：丢弃重复事件 %s"), *EventInfo.PresetData.LocationName);
+			continue;
+		}
+		GeneratedEventSummaries.Add(EventInfo.PresetData.LocationName + TEXT(": ") + EventInfo.PresetData.Description.Left(80));
+		NewEvents.Add(MoveTemp(EventInfo));
+	}
+	return NewEvents;
 }
 
 void UTAEventGenerator::RequestEventGenerationByDescription(const FString& SceneInfo, const FString& Description, const FVector& InLocation)
@@ -101,21 +247,30 @@ void UTAEventGenerator::RequestEventGenerationByDescription(const FString& Scene
 
 void UTAEventGenerator::OnChatSuccess(FChatCompletion ChatCompletion)
 {
-	// 解析返回的消息
-	TArray<FTAEventInfo> GeneratedEvents = ParseEventsFromJson(ChatCompletion.message.content);
-
-	if(IsInLocation)
-	{
-		OnEventGenerationSuccessInLocation.Broadcast(GeneratedEvents, GenerateInLocation);
-	}else
-	{
-		OnEventGenerationSuccess.Broadcast(GeneratedEvents);
-	}
+	// 解析返回的消息，解析在工作线程做，回到游戏线程再广播
+	const FString Content = ChatCompletion.message.content;
+	TAAsyncParse::ParseThenApply<TArray<FTAEventInfo>>(this,
+		[Content]()
+		{
+			return ParseEventsFromJson(Content);
+		},
+		[this](TArray<FTAEventInfo>& GeneratedEvents)
+		{
+			if(IsInLocation)
+			{
+				OnEventGenerationSuccessInLocation.Broadcast(GeneratedEvents, GenerateInLocation);
+			}else
+			{
+				OnEventGenerationSuccess.Broadcast(GeneratedEvents);
+			}
+			OnEventGenerationFinished.Broadcast();
+		});
 }
 
 void UTAEventGenerator::OnChatFailure()
 {
 	// 可以在此处处理失败的逻辑，例如重试或者提供错误信息反馈
+	OnEventGenerationFinished.Broadcast();
 }
 
 TArray<FTAEventInfo> UTAEventGenerator::ParseEventsFromJson(const FString& JsonString)
@@ -134,8 +289,13 @@ TArray<FTAEventInfo> UTAEventGenerator::ParseEventsFromJson(const FString& JsonS
 
 			for (int32 Index = 0; Index < EventsArray.Num(); Index++)
 			{
-				TSharedPtr<FJsonObject> EventObject = EventsArray[Index]->AsObject();
-				ProcessEventObject(EventObject, ParsedEvents);
+				const TSharedPtr<FJsonObject>* EventObject = nullptr;
+				if (!EventsArray[Index].IsValid() || !EventsArray[Index]->TryGetObject(EventObject))
+				{
+					UE_LOG(LogTAEventSystem, Warning, TEXT("事件生成：第 %d 个事件不是对象，跳过"), Index);
+					continue;
+				}
+				ProcessEventObject(*EventObject, ParsedEvents);
 			}
 		}
 		else
@@ -158,11 +318,13 @@ void UTAEventGenerator::ProcessEventObject(const TSharedPtr<FJsonObject>& EventO
 	{
 		FTAEventInfo EventInfo;
 
-		// 获取并设置地点名称
-		EventInfo.PresetData.LocationName = EventObject->GetStringField(TEXT("LocationName"));
-
-		// 获取并设置事件描述
-		EventInfo.PresetData.Description = EventObject->GetStringField(TEXT("Description"));
+		// 地点和描述是必需的，缺了只丢这一个事件，不影响同一批里的其他事件
+		if (!EventObject->TryGetStringField(TEXT("LocationName"), EventInfo.PresetData.LocationName)
+			|| !EventObject->TryGetStringField(TEXT("Description"), EventInfo.PresetData.Description))
+		{
+			UE_LOG(LogTAEventSystem, Warning, TEXT("事件生成：跳过缺少LocationName或Description的事件"));
+			return;
+		}
 
 		int32 EventTypeInt;
 		FString EventTypeStr;
@@ -173,8 +335,7 @@ void UTAEventGenerator::ProcessEventObject(const TSharedPtr<FJsonObject>& EventO
 		}else if (EventObject->TryGetStringField(TEXT("EventType"), EventTypeStr))
 		{
 			// 尝试将字符串的第一个字符转换为数字
-			TCHAR FirstChar = EventTypeStr[0];
-			if (FChar::IsDigit(FirstChar))
+			if (!EventTypeStr.IsEmpty() && FChar::IsDigit(EventTypeStr[0]))
 			{
 				EventTypeInt = FCString::Atoi(*EventTypeStr);
 				EventInfo.PresetData.EventType = static_cast<ETAEventType>(EventTypeInt);
@@ -192,7 +353,7 @@ void UTAEventGenerator::ProcessEventObject(const TSharedPtr<FJsonObject>& EventO
 		}
 
 		// 获取并设置事件权重
-		EventInfo.PresetData.Weight = EventObject->GetIntegerField(TEXT("Weight"));
+		EventObject->TryGetNumberField(TEXT("Weight"), EventInfo.PresetData.Weight);
 				
 		/*if (EventObject->HasField(TEXT("AdventurePoint")))
 		{
@@ -4,10 +4,17 @@
 #include "Event/Plot/TAPlotManager.h"
 
 #include "OpenAIDefinitions.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Common/TAAsyncParse.h"
 #include "Common/TAEmbeddingSystem.h"
 #include "Common/TALLMLibrary.h"
 #include "Event/TAEventLogCategory.h"
 #include "Event/Core/TAEventInstance.h"
+#include "HAL/IConsoleManager.h"
+#include "Save/TANarrativeSnapshot.h"
+#include "TASettings.h"
 
 class UTAEmbeddingSystem;
 
@@ -19,13 +26,35 @@ UTAPlotManager::~UTAPlotManager()
 {
 }
 
+static FAutoConsoleCommandWithWorld GTAPlotSimilarityCacheStatsCommand(
+	TEXT("TA.Plot.SimilarityCacheStats"),
+	TEXT("打印剧情标签相似度缓存的容量和命中率"),
+	FConsoleCommandWithWorldDelegate::CreateStatic([](UWorld* World)
+	{
+		if (const UTAPlotManager* PlotManager = World ? World->GetSubsystem<UTAPlotManager>() : nullptr)
+		{
+			UE_LOG(LogTAEventSystem, Log, TEXT("%s"), *PlotManager->GetSimilarityCache().GetStatsString());
+		}
+	}));
+
 void UTAPlotManager::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+	if (const UTASettings* Settings = GetDefault<UTASettings>())
+	{
+		SimilarityCache = FTASimilarityCache(Settings->SimilarityCacheCapacity);
+	}
 }
 
 void UTAPlotManager::Deinitialize()
 {
+	if (UWorld* World = GetWorld())
+	{
+		World->GetTimerManager().ClearTimer(TagDebounceTimerHandle);
+	}
+	bIsTaggingInFlight = false;
+	TaggingStartTime = -1.0;
+	UE_LOG(LogTAEventSystem, Log, TEXT("UTAPlotManager::Deinitialize %s"), *SimilarityCache.GetStatsString());
 	Super::Deinitialize();
 }
 
@@ -38,12 +67,13 @@ void UTAPlotManager::ReportEventTagGroups(const FTATagGroup& EventTagGroups)
 // Events[0]->PresetData.PrecedingPlotTagGroups.Num()
 // 这个是布尔值
 // Events[0]->PrecedingPlotTagGroupsConditionMet = false
-void UTAPlotManager::CheckEventsTagGroupCondition(TArray<FTAEventInfo>& Events)
+void UTAPlotManager::CheckEventsTagGroupCondition(const TArray<FTAEventInfo*>& Events)
 {
     UTAEmbeddingSystem* EmbeddingSystem = GetWorld()->GetGameInstance()->GetSubsystem<UTAEmbeddingSystem>();
 
-    for (FTAEventInfo& EventInfo : Events)
+    for (FTAEventInfo* EventInfoPtr : Events)
     {
+    	FTAEventInfo& EventInfo = *EventInfoPtr;
         // 如果事件的前置标签组条件已经被满足，跳过这个事件
         if(EventInfo.PrecedingPlotTagGroupsConditionMet) 
         {
@@ -70,7 +100,7 @@ void UTAPlotManager::CheckEventsTagGroupCondition(TArray<FTAEventInfo>& Events)
             {
                 bHasOrGroup = true;
             }
-    		FHighDimensionalVector PresetTagEmbedding;
+    		TSharedPtr<const FTAPackedEmbedding> PresetTagEmbedding;
     		
     		// 迭代此剧情标签组中的所有标签
     		for (int32 PlotTagIndex = 0; PlotTagIndex < PlotTagGroups.Num(); ++PlotTagIndex)
@@ -78,7 +108,8 @@ void UTAPlotManager::CheckEventsTagGroupCondition(TArray<FTAEventInfo>& Events)
     			const FTATagGroup& PlotGroup = PlotTagGroups[PlotTagIndex];
     			// 每个事件记录独立 记录 当前预设组匹配到的下标
     			TagIndex = 0;
-    			if(!EmbeddingSystem->GetTagEmbedding(PresetGroup.Tags[TagIndex], PresetTagEmbedding))
+    			PresetTagEmbedding = EmbeddingSystem->GetPackedTagEmbedding(PresetGroup.Tags[TagIndex]);
+    			if(!PresetTagEmbedding.IsValid())
     			{
     				break;
     			}
@@ -101,21 +132,19 @@ void UTAPlotManager::CheckEventsTagGroupCondition(TArray<FTAEventInfo>& Events)
     				bool IsMatch = PlotTag.IsEqual(PresetGroup.Tags[TagIndex]); //完全相同的直接成功
     				if(!IsMatch)
     				{
-    					FHighDimensionalVector PlotTagEmbedding;
-    					if (EmbeddingSystem->GetTagEmbedding(PlotTag, PlotTagEmbedding)) {
-    						float Similarity = GetCachedCosineSimilarity(PresetGroup.Tags[TagIndex], PlotTag, PresetTagEmbedding, PlotTagEmbedding);
+    					const TSharedPtr<const FTAPackedEmbedding> PlotTagEmbedding = EmbeddingSystem->GetPackedTagEmbedding(PlotTag);
+    					if (PlotTagEmbedding.IsValid()) {
+    						float Similarity = GetCachedCosineSimilarity(PresetGroup.Tags[TagIndex], PlotTag, *PresetTagEmbedding, *PlotTagEmbedding);
     						if(Similarity > 0.5 && Similarity < 1)
     						{
-    							FString LogPairKey = PresetGroup.Tags[TagIndex].ToString() + TEXT("_") + PlotTag.ToString();
-    							if (!PrintedLogPairs.Contains(LogPairKey))
+    							if (SimilarityCache.MarkLogged(FTATagPairKey(PresetGroup.Tags[TagIndex], PlotTag)))
     							{
     								UE_LOG(LogTAEventSystem, Warning,
 										TEXT("大于0.5小于1的日志: 当前的预设前置 '%s' 与剧情标签 '%s' 的嵌入向量余弦相似度为：%f"),
 										*PresetGroup.Tags[TagIndex].ToString(), *PlotTag.ToString(), Similarity);
-    								PrintedLogPairs.Add(LogPairKey);
     							}
     						}
-    						if (Similarity > 0.62) {
+    						if (Similarity > TagSimilarityThreshold) {
     							IsMatch = true;
     						}
     					}
@@ -130,7 +159,8 @@ void UTAPlotManager::CheckEventsTagGroupCondition(TArray<FTAEventInfo>& Events)
     						break;
     					}
 
-    					if (!EmbeddingSystem->GetTagEmbedding(PresetGroup.Tags[TagIndex], PresetTagEmbedding)) {
+    					PresetTagEmbedding = EmbeddingSystem->GetPackedTagEmbedding(PresetGroup.Tags[TagIndex]);
+    					if (!PresetTagEmbedding.IsValid()) {
     						break; // 无法获取下一个预设标签的嵌入向量
     					}
     					continue; // 匹配成功，继续使用当前的剧情标签进行下一轮匹配
@@ -167,16 +197,41 @@ void UTAPlotManager::CheckEventsTagGroupCondition(TArray<FTAEventInfo>& Events)
 
 void UTAPlotManager::ParseNewEventToTagGroups()
 {
-	if(!ShoutHistory.Num())
+	if(!PendingTagLines.Num())
 	{
 		return;
 	}
-	/*TArray<FChatLog> TempMessagesList = ShoutHistory;
-	const FString FormattedPrompt = UTALLMLibrary::PromptToStr(PromptTagEvent);
-	TempMessagesList.Insert({EOAChatRole::SYSTEM, FormattedPrompt}, 0);*/
-	TArray<FChatLog> TempMessagesList = ShoutHistory;
-	TempMessagesList.Insert({EOAChatRole::SYSTEM, UTALLMLibrary::PromptToStr(PromptTagEvent)}, 0);
-	//TempMessagesList.Add({EOAChatRole::SYSTEM, TEXT("Now Break new Event into tags:")});
+	// 上一批还没回来，回来后会接着处理攒下的消息。取消的请求不会回调，超时后不再等它
+	if(bIsTaggingInFlight)
+	{
+		if (FPlatformTime::Seconds() - TaggingStartTime < TaggingTimeoutSeconds)
+		{
+			return;
+		}
+		UE_LOG(LogTAEventSystem, Warning, TEXT("剧情标签请求超时，重新发起"));
+	}
+	GetWorld()->GetTimerManager().ClearTimer(TagDebounceTimerHandle);
+	
+	// 之前处理过的消息作为上下文，新消息一次性编号发过去，一个请求拆出所有新消息的记录
+	FString UserContent = TEXT("CONTEXT:\n");
+	for (const FChatLog& ContextLog : ShoutHistory)
+	{
+		UserContent += ContextLog.content + TEXT("\n");
+	}
+	UserContent += TEXT("NEW MESSAGES:\n");
+	for (int32 Index = 0; Index < PendingTagLines.Num(); ++Index)
+	{
+		UserContent += FString::Printf(TEXT("%d. %s\n"), Index + 1, *PendingTagLines[Index].content);
+	}
+	
+	TArray<FChatLog> TempMessagesList;
+	TempMessagesList.Add({EOAChatRole::SYSTEM, UTALLMLibrary::PromptToStr(PromptTagEvent)});
+	TempMessagesList.Add({EOAChatRole::USER, UserContent});
+	
+	// 发出去的消息转为上下文
+	ShoutHistory.Append(PendingTagLines);
+	PendingTagLines.Reset();
+	TrimShoutHistory();
 	
 	FChatSettings ChatSettings{
 		UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast),
@@ -185,102 +240,35 @@ void UTAPlotManager::ParseNewEventToTagGroups()
 	};
 	ChatSettings.jsonFormat = PromptTagEvent.bUseJsonFormat;
 
+	bIsTaggingInFlight = true;
+	TaggingStartTime = FPlatformTime::Seconds();
 	UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings,
     [this](const FChatCompletion& Message, const FString& ErrorMessage, bool bWasSuccessful)
     {
         if(bWasSuccessful)
-        {   
-            // 转换返回的字符串为Json
-            TSharedRef<TJsonReader<TCHAR>> JsonReader = TJsonReaderFactory<TCHAR>::Create(Message.message.content);
-            TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject);
-
-            if(FJsonSerializer::Deserialize(JsonReader, JsonObject) && JsonObject.IsValid())
-            {
-                // 解析proactive_action并存储tags
-                TSharedPtr<FJsonObject> ProactiveAction = JsonObject->GetObjectField("proactive_action");
-
-                TArray<FName> ProactiveTags;
-                ProactiveTags.Add(FName(*ProactiveAction->GetStringField("character_tag")));
-                ProactiveTags.Add(FName(*ProactiveAction->GetStringField("action_tag")));
-                ProactiveTags.Add(FName(*ProactiveAction->GetStringField("activity_tag")));
-
-                TArray<TSharedPtr<FJsonValue>> ProactiveDetailTagsJsonArray = ProactiveAction->GetArrayField("activity_detail_tags");
-                for (auto& JsonValue : ProactiveDetailTagsJsonArray)
-                {
-                    FName Tag = FName(*JsonValue->AsString());
-                    if (!Tag.IsNone())
-                    {
-                        ProactiveTags.Add(Tag);
-                    }
-                }
-
-                // 在将标签添加到标签组之前进行验证
-                bool bIsValidTagGroup = true;
-                for (const auto& Tag : ProactiveTags)
-                {
-                    if (Tag.IsNone())
-                    {
-                        bIsValidTagGroup = false;
-                        break;
-                    }
-                }
-
-                if (bIsValidTagGroup)
-                {
-                    // 将proactive_tags存入TagGroup结构体中
-                    FTATagGroup ProactiveTagGroup;
-                    ProactiveTagGroup.Tags.Append(ProactiveTags);
-                    PlotTagGroups.Add(ProactiveTagGroup);
-                }
-                
-                // 解析passive_action并存储tags
-                TSharedPtr<FJsonObject> PassiveAction = JsonObject->GetObjectField("passive_action");
-
-                TArray<FName> PassiveTags;
-                PassiveTags.Add(FName(*PassiveAction->GetStringField("character_tag")));
-                PassiveTags.Add(FName(*PassiveAction->GetStringField("action_tag")));
-                PassiveTags.Add(FName(*PassiveAction->GetStringField("activity_tag")));
-
-                TArray<TSharedPtr<FJsonValue>> PassiveDetailTagsJsonArray = PassiveAction->GetArrayField("activity_detail_tags");
-            	for (auto& JsonValue : PassiveDetailTagsJsonArray)
-            	{
-					FName Tag = FName(*JsonValue->AsString());
-					if (!Tag.IsNone())
-					{
-						PassiveTags.Add(Tag);
-					}
-				}
-
-				// 在将标签添加到标签组之前进行验证
-				bIsValidTagGroup = true;
-				for (const auto& Tag : PassiveTags)
-				{
-					if (Tag.IsNone())
-					{
-						bIsValidTagGroup = false;
-						break;
-					}
-				}
-
-				if (bIsValidTagGroup)
-				{
-					// 将passive_tags存入TagGroup结构体中
-					FTATagGroup PassiveTagGroup;
-					PassiveTagGroup.Tags.Append(PassiveTags);
-					PlotTagGroups.Add(PassiveTagGroup);
-				}
-			}
-			else
-			{
-				// 解析JSON失败日志
-				UE_LOG(LogTAEventSystem, Warning, TEXT("解析JSON失败: %s"), *Message.message.content);
-			}
-		}
-		else
-		{
-			// 请求失败打印错误信息
-			UE_LOG(LogTAEventSystem, Error, TEXT("请求失败: %s"), *ErrorMessage);
+        {
+        	// 解析在工作线程做，标签组回到游戏线程再写进PlotTagGroups，期间仍算请求在途
+        	const FString Content = Message.message.content;
+        	TAAsyncParse::ParseThenApply<FTAParsedTagRecords>(this,
+        		[Content]()
+        		{
+        			return ParseTagRecords(Content);
+        		},
+        		[this](FTAParsedTagRecords& Parsed)
+        		{
+        			if (Parsed.bValid)
+        			{
+        				PlotTagGroups.Append(MoveTemp(Parsed.TagGroups));
+        				UE_LOG(LogTAEventSystem, Log, TEXT("剧情标签拆分完成：%d 条记录，%d 个标签组"), Parsed.RecordNum, Parsed.TagGroupNum);
+        			}
+        			OnTaggingRequestFinished();
+        		});
+        	return;
 		}
+		
+		// 请求失败打印错误信息
+		UE_LOG(LogTAEventSystem, Error, TEXT("请求失败: %s"), *ErrorMessage);
+		OnTaggingRequestFinished();
 	},GetWorld());
 	
 	/* 旧版本
@@ -327,6 +315,187 @@ void UTAPlotManager::ParseNewEventToTagGroups()
 }
 
 
+FTAParsedTagRecords UTAPlotManager::ParseTagRecords(const FString& Content)
+{
+	FTAParsedTagRecords Parsed;
+	
+	// 转换返回的字符串为Json
+	TSharedRef<TJsonReader<TCHAR>> JsonReader = TJsonReaderFactory<TCHAR>::Create(Content);
+	TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject);
+	if(!FJsonSerializer::Deserialize(JsonReader, JsonObject) || !JsonObject.IsValid())
+	{
+		// 解析JSON失败日志
+		UE_LOG(LogTAEventSystem, Warning, TEXT("解析JSON失败: %s"), *Content);
+		return Parsed;
+	}
+	
+	// 每条记录都有主动和被动两组标签，旧格式没有records时整个对象就是一条记录
+	TArray<TSharedPtr<FJsonObject>> Records;
+	const TArray<TSharedPtr<FJsonValue>>* RecordsJsonArray = nullptr;
+	if (JsonObject->TryGetArrayField(TEXT("records"), RecordsJsonArray))
+	{
+		for (const TSharedPtr<FJsonValue>& RecordValue : *RecordsJsonArray)
+		{
+			const TSharedPtr<FJsonObject>* RecordObject = nullptr;
+			if (RecordValue.IsValid() && RecordValue->TryGetObject(RecordObject))
+			{
+				Records.Add(*RecordObject);
+			}
+		}
+	}
+	else
+	{
+		Records.Add(JsonObject);
+	}
+
+	for (const TSharedPtr<FJsonObject>& Record : Records)
+	{
+		for (const TCHAR* ActionField : {TEXT("proactive_action"), TEXT("passive_action")})
+		{
+			FTATagGroup TagGroup;
+			const TSharedPtr<FJsonObject>* ActionObject = nullptr;
+			if (Record->TryGetObjectField(ActionField, ActionObject) && ParseActionToTagGroup(*ActionObject, TagGroup))
+			{
+				Parsed.TagGroups.Add(MoveTemp(TagGroup));
+			}
+		}
+	}
+	Parsed.RecordNum = Records.Num();
+	Parsed.TagGroupNum = Parsed.TagGroups.Num();
+	Parsed.bValid = true;
+	return Parsed;
+}
+
+void UTAPlotManager::OnTaggingRequestFinished()
+{
+	bIsTaggingInFlight = false;
+	TaggingStartTime = -1.0;
+	// 请求期间又攒了新消息
+	if (PendingTagLines.Num() > 0)
+	{
+		ScheduleTagging();
+	}
+}
+
+bool UTAPlotManager::ParseActionToTagGroup(const TSharedPtr<FJsonObject>& ActionObject, FTATagGroup& OutTagGroup)
+{
+	if (!ActionObject.IsValid())
+	{
+		return false;
+	}
+	
+	TArray<FName> Tags;
+	Tags.Add(FName(*ActionObject->GetStringField("character_tag")));
+	Tags.Add(FName(*ActionObject->GetStringField("action_tag")));
+	Tags.Add(FName(*ActionObject->GetStringField("activity_tag")));
+	
+	// 在将标签添加到标签组之前进行验证
+	for (const FName& Tag : Tags)
+	{
+		if (Tag.IsNone())
+		{
+			return false;
+		}
+	}
+
+	const TArray<TSharedPtr<FJsonValue>>* DetailTagsJsonArray = nullptr;
+	if (ActionObject->TryGetArrayField(TEXT("activity_detail_tags"), DetailTagsJsonArray))
+	{
+		for (const TSharedPtr<FJsonValue>& JsonValue : *DetailTagsJsonArray)
+		{
+			FName Tag = FName(*JsonValue->AsString());
+			if (!Tag.IsNone())
+			{
+				Tags.Add(Tag);
+			}
+		}
+	}
+	
+	OutTagGroup.Tags.Append(Tags);
+	return true;
+}
+
+void UTAPlotManager::ScheduleTagging()
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	const float DebounceSeconds = Settings ? Settings->PlotTaggingDebounceSeconds : 0.f;
+	const int32 MaxBatchLines = Settings ? Settings->PlotTaggingMaxBatchLines : 1;
+	
+	// 攒够一批或者不防抖时直接发
+	if (DebounceSeconds <= 0.f || PendingTagLines.Num() >= MaxBatchLines)
+	{
+		ParseNewEventToTagGroups();
+		return;
+	}
+	// 重设计时器，安静下来DebounceSeconds秒后再一起拆
+	GetWorld()->GetTimerManager().SetTimer(TagDebounceTimerHandle, this, &UTAPlotManager::ParseNewEventToTagGroups, DebounceSeconds, false);
+}
+
+void UTAPlotManager::TrimShoutHistory()
+{
+	constexpr int32 MaxContextLines = 5;
+	if (ShoutHistory.Num() > MaxContextLines)
+	{
+		ShoutHistory.RemoveAt(0, ShoutHistory.Num() - MaxContextLines);
+	}
+}
+
+bool UTAPlotManager::IsPlotChatter(const FString& Content) const
+{
+	// 喊话一般是 {"message": "..."}，只看message字段
+	FString Text = Content;
+	TSharedPtr<FJsonObject> JsonObject;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Content);
+	if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+	{
+		JsonObject->TryGetStringField(TEXT("message"), Text);
+	}
+
+	// 去掉空白和标点，只留字母数字和中日韩文字
+	// 0x2E80以上除了文字还有全角标点：CJK符号和标点、竖排和小型标点、全角ASCII标点，这些也要去掉
+	auto IsWideSymbol = [](const TCHAR Char)
+	{
+		return (Char >= 0x3000 && Char <= 0x303F)
+			|| (Char >= 0xFE10 && Char <= 0xFE1F)
+			|| (Char >= 0xFE30 && Char <= 0xFE6F)
+			|| (Char >= 0xFF00 && Char <= 0xFF0F)
+			|| (Char >= 0xFF1A && Char <= 0xFF20)
+			|| (Char >= 0xFF3B && Char <= 0xFF40)
+			|| (Char >= 0xFF5B && Char <= 0xFF65);
+	};
+	FString Stripped;
+	Stripped.Reserve(Text.Len());
+	for (const TCHAR Char : Text)
+	{
+		if (FChar::IsPunct(Char) || IsWideSymbol(Char))
+		{
+			continue;
+		}
+		if (FChar::IsAlnum(Char) || Char >= 0x2E80)
+		{
+			Stripped.AppendChar(FChar::ToLower(Char));
+		}
+	}
+	
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	if (!Settings)
+	{
+		return false;
+	}
+	if (Stripped.IsEmpty() || Stripped.Len() < Settings->PlotChatterMinLength)
+	{
+		return true;
+	}
+	for (const FString& Phrase : Settings->PlotChatterPhrases)
+	{
+		if (Stripped.Equals(Phrase, ESearchCase::IgnoreCase))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 bool UTAPlotManager::GetTagEmbeddingsFromSystem(const FName& Tag, FHighDimensionalVector& OutEmbeddingVec)
 {
 	return GetWorld()->GetGameInstance()->GetSubsystem<UTAEmbeddingSystem>()->GetTagEmbedding(Tag,OutEmbeddingVec);
@@ -334,12 +503,16 @@ bool UTAPlotManager::GetTagEmbeddingsFromSystem(const FName& Tag, FHighDimension
 
 void UTAPlotManager::ProcessShoutInGame(const FChatCompletion& Message, AActor* Shouter, float Volume)
 {
-	ShoutHistory.Add(Message.message);
-	if(ShoutHistory.Num() > 5)
+	// 闲聊只留作上下文，不单独发请求
+	if (IsPlotChatter(Message.message.content))
 	{
-		ShoutHistory.RemoveAt(0);
+		UE_LOG(LogTAEventSystem, Verbose, TEXT("跳过闲聊: %s"), *Message.message.content);
+		ShoutHistory.Add(Message.message);
+		TrimShoutHistory();
+		return;
 	}
-	ParseNewEventToTagGroups();
+	PendingTagLines.Add(Message.message);
+	ScheduleTagging();
 	return;
 	// 存储接收到的消息，在FullShoutHistory中始终保留完整记录
 	FullShoutHistory.Add(Message.message);
@@ -432,26 +605,26 @@ FString UTAPlotManager::JoinShoutHistory()
 	return Result;
 }
 
-float UTAPlotManager::GetCachedCosineSimilarity(FName TagA, FName TagB, const FHighDimensionalVector& VectorA, const FHighDimensionalVector& VectorB)
+float UTAPlotManager::GetCachedCosineSimilarity(FName TagA, FName TagB, const FTAPackedEmbedding& VectorA, const FTAPackedEmbedding& VectorB)
 {
-	const TPair<FName, FName> TagPair = TPair<FName, FName>(TagA, TagB);
+	// 相似度是对称的，(A,B)和(B,A)共用一个键
+	const FTATagPairKey TagPair(TagA, TagB);
 
 	// 尝试从缓存中获取结果
-	if (const float* CachedSimilarity = SimilarityCache.Find(TagPair))
+	float Similarity = 0.f;
+	if (SimilarityCache.Find(TagPair, Similarity))
 	{
-		return *CachedSimilarity;
+		return Similarity;
 	}
-	else
-	{
-		// 如果缓存中未找到，需要调用计算相似度的函数
-		// 注意：这里假设UTAEmbeddingSystem类有一个静态方法可以直接使用两个FName标签进行相似度计算
-		const float Similarity = UTAEmbeddingSystem::CalculateCosineSimilarity(VectorA, VectorB);
+	
+	// 如果缓存中未找到，需要调用计算相似度的函数
+	// 向量入库时已经归一化，点积就是余弦相似度
+	Similarity = FTAPackedEmbedding::DotProduct(VectorA, VectorB);
 
-		// 将结果添加到缓存
-		SimilarityCache.Add(TagPair, Similarity);
+	// 将结果添加到缓存，满了会自动淘汰
+	SimilarityCache.Add(TagPair, Similarity);
 
-		return Similarity;
-	}
+	return Similarity;
 }
 
 const FTAPrompt UTAPlotManager::PromptCompressShoutHistory = FTAPrompt{
@@ -480,10 +653,12 @@ Character tags: Identify the subject of the action, such as Joan, Robert, etc.
 Action tags: Describe the actions performed by characters, such as "open", "accept".
 Activity tags: Indicate the general type of action, such as "trade", "quest", "monster".
 Activity detail tags: Provide specific information about the activity, which can be further divided into several tags, such as the name of the quest, target object, who assigned the quest.
-The response should use the following JSON format:
+The response should use the following JSON format. Put one element into records for every action that actually took place in the new messages: one message may produce several records, and pure chit-chat without any action produces none, in which case records is an empty array:
+{
+"records": [
 {
-"guideline":"Faithfully record the actions that have actually occurred, do not conjecture actions that have not yet occurred, reply with Chinese tags, only decompose the latest message, do not leave second_analysis empty",
-"analysis":"What is the latest message, what happened in this message. Analyse the details inside, which may include proactive actions. Lastly, please have second_analysis raise doubts.",
+"guideline":"Faithfully record the actions that have actually occurred, do not conjecture actions that have not yet occurred, reply with Chinese tags, only decompose the new messages, do not leave second_analysis empty",
+"analysis":"What are the new messages, what happened in each of them. Analyse the details inside, which may include proactive actions. Lastly, please have second_analysis raise doubts.",
 "second_analysis":"What analysis says can't actually be confirmed, because X, question",
 "combine_analysis":"The doubt raised by second_analysis about X is indeed reasonable (we generally consider the point of question to be reasonable), so we cannot record X, but should instead record X. Only give proactive records here.",
 "proactive_action":
@@ -504,10 +679,14 @@ The response should use the following JSON format:
 "activity_detail_tags": ["Passive activity detail 1", "Passive activity detail 2", ...]
 }
 }
-Please focus only on the last message, as it represents the newly occurred action. You have already dealt with the actions that happened before. Showing them now is just to keep the context intact without loss.
+]
+}
+Please only decompose the messages listed under NEW MESSAGES, they are the newly occurred actions. You have already dealt with the messages listed under CONTEXT, showing them now is just to keep the context intact without loss.
 Example:
 {
-"guideline":"Faithfully record the actions that have actually occurred, do not conjecture actions that have not yet occurred, reply with Chinese tags, only decompose the latest message, do not leave second_analysis empty",
+"records": [
+{
+"guideline":"Faithfully record the actions that have actually occurred, do not conjecture actions that have not yet occurred, reply with Chinese tags, only decompose the new messages, do not leave second_analysis empty",
 "analysis":"The latest message is 'Adventurer, I've taken it, now let me take a look at this letter', here adventurer refers to Robert, in the previous message Joan had the action of giving out the letter, Robert's reply of taking it shows that he has got the letter, next he wants to check the letter. Decomposed into Joan delivering the letter and Robert checking the letter. Please have second_analysis raise doubts.",
 "second_analysis":"What analysis says can't actually be confirmed, because Robert says he took it, it might just be an expectation, the letter might still be with Joan, Robert might not have reached out to take it. Is the letter definitely in Robert's hands? Does Robert's statement necessarily mean he received it?",
 "combine_analysis":"The doubt raised by second_analysis that Robert might not have the letter is reasonable, because there is no action given by Joan, nor an accepting action by Robert, we need to wait until Robert actively takes the letter, or expresses that he has seen the content of the letter to be fully certain. So it cannot be decomposed into Robert obtained the letter, because we cannot be certain it was obtained, hoping for something does not mean it has already happened, we need to accurately describe the things that have happened, not conjecture about things not clearly occurred, we need to decompose it into Robert asking Joan for the letter",
@@ -529,9 +708,13 @@ Example:
 "activity_detail_tags": ["天山信件", "罗伯特"]
 }
 }
+]
+}
 Next example:
 {
-"guideline":"Faithfully record the actions that have actually occurred, do not conjecture actions that have not yet occurred, reply with Chinese tags, only decompose the latest message, do not leave second_analysis empty",
+"records": [
+{
+"guideline":"Faithfully record the actions that have actually occurred, do not conjecture actions that have not yet occurred, reply with Chinese tags, only decompose the new messages, do not leave second_analysis empty",
 "analysis":"The latest message is 'I nod', Joan is nodding because in the previous message Robert was asking Joan if she accepts the task, the nodding action means Joan accepts the task of finding the sword from Robert. Decompose into accepting task proactive and passive actions. Please have second_analysis raise doubts.",
 "second_analysis":"What analysis says can't actually be confirmed, because Joan might not be agreeing to what Robert said. Does Joan's nodding equal accepting the task?",
 "combine_analysis":"Whether Joan definitely accepted the task as questioned by second_analysis is uncertain because Robert only mentioned the task, he didn't talk about any other topic, and Joan's nodding action is proactive, Joan's intention of nodding can only be towards Robert's task, so it cannot be decomposed into Joan nodding to Robert, we need to accurately describe the events that have taken place, we need to further refine, need to decompose it into Joan accepting the task",
@@ -553,10 +736,12 @@ Next example:
 "activity_detail_tags": ["寻找宝剑", "罗伯特"]
 }
 }
+]
+}
 Please reply with Chinese tags in the tags fields to comply with our system's protocol.
-Extract and tag according to the instructions, focusing on the last content of the following game events/dialogue content:
+Extract and tag according to the instructions, focusing on the NEW MESSAGES of the following game events/dialogue content:
 	)""""),
-	1,
+	2,
 	true
 };
 
@@ -593,4 +778,57 @@ const FTAPrompt UTAPlotManager::PromptTagEvent = FTAPrompt{
 	1,
 	true
 };
-*/
\ No newline at end of file
+*/
+
+void UTAPlotManager::WriteSnapshot(FTASnapshotWriter& Writer) const
+{
+    Writer.WriteUInt(PlotTagGroups.Num());
+    for (const FTATagGroup& TagGroup : PlotTagGroups)
+    {
+        WriteTagGroup(Writer, TagGroup);
+    }
+    Writer.WriteString(ShoutHistoryCompressedStr);
+}
+
+bool UTAPlotManager::ReadSnapshot(FTASnapshotReader& Reader)
+{
+    TArray<FTATagGroup> TagGroups;
+    TagGroups.SetNum(Reader.ReadCount());
+    for (FTATagGroup& TagGroup : TagGroups)
+    {
+        ReadTagGroup(Reader, TagGroup);
+    }
+    FString CompressedStr = Reader.ReadString();
+    if (!Reader.IsValid())
+    {
+        UE_LOG(LogTAEventSystem, Error, TEXT("ReadSnapshot 剧情快照损坏"));
+        return false;
+    }
+    // 标签词嵌不进快照，检查条件时会按需从词嵌缓存或网络取
+    PlotTagGroups = MoveTemp(TagGroups);
+    ShoutHistoryCompressedStr = MoveTemp(CompressedStr);
+    UE_LOG(LogTAEventSystem, Log, TEXT("ReadSnapshot 恢复 %d 条剧情记录"), PlotTagGroups.Num());
+    return true;
+}
+
+void UTAPlotManager::WriteTagGroup(FTASnapshotWriter& Writer, const FTATagGroup& TagGroup)
+{
+    Writer.WriteUInt(TagGroup.Tags.Num());
+    for (const FName& Tag : TagGroup.Tags)
+    {
+        Writer.WriteName(Tag);
+    }
+    Writer.WriteInt(TagGroup.FlagIndex);
+    Writer.WriteBool(TagGroup.Flag);
+}
+
+void UTAPlotManager::ReadTagGroup(FTASnapshotReader& Reader, FTATagGroup& OutTagGroup)
+{
+    OutTagGroup.Tags.SetNum(Reader.ReadCount());
+    for (FName& Tag : OutTagGroup.Tags)
+    {
+        Tag = Reader.ReadName();
+    }
+    OutTagGroup.FlagIndex = static_cast<int32>(Reader.ReadInt());
+    OutTagGroup.Flag = Reader.ReadBool();
+}
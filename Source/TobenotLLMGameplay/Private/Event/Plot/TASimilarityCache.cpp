@@ -0,0 +1,176 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+#include "Event/Plot/TASimilarityCache.h"
+
+namespace
+{
+	uint64 MakeNameId(const FName& Name)
+	{
+		return (static_cast<uint64>(Name.GetComparisonIndex().ToUnstableInt()) << 32) | static_cast<uint32>(Name.GetNumber());
+	}
+}
+
+FTATagPairKey::FTATagPairKey(const FName& TagA, const FName& TagB)
+{
+	const uint64 IdA = MakeNameId(TagA);
+	const uint64 IdB = MakeNameId(TagB);
+	Low = FMath::Min(IdA, IdB);
+	High = FMath::Max(IdA, IdB);
+}
+
+uint32 FTATagPairKey::GetHash() const
+{
+	return HashCombineFast(GetTypeHash(Low), GetTypeHash(High));
+}
+
+FTASimilarityCache::FTASimilarityCache(int32 InCapacity)
+{
+	Capacity = FMath::Max(16, InCapacity);
+	// 装载率控制在75%以内，探测链不会太长
+	const uint32 SlotCount = FMath::RoundUpToPowerOfTwo(static_cast<uint32>(Capacity) * 4 / 3 + 1);
+	Slots.SetNum(SlotCount);
+	SlotMask = SlotCount - 1;
+}
+
+bool FTASimilarityCache::Find(const FTATagPairKey& Key, float& OutSimilarity)
+{
+	const int32 SlotIndex = FindSlot(Key, Key.GetHash());
+	if (SlotIndex == INDEX_NONE)
+	{
+		++Misses;
+		return false;
+	}
+	FEntry& Entry = Slots[SlotIndex];
+	Entry.bReferenced = true;
+	OutSimilarity = Entry.Similarity;
+	++Hits;
+	return true;
+}
+
+void FTASimilarityCache::Add(const FTATagPairKey& Key, float Similarity)
+{
+	const uint32 Hash = Key.GetHash();
+	const int32 ExistingIndex = FindSlot(Key, Hash);
+	if (ExistingIndex != INDEX_NONE)
+	{
+		Slots[ExistingIndex].Similarity = Similarity;
+		Slots[ExistingIndex].bReferenced = true;
+		return;
+	}
+
+	if (NumEntries >= Capacity)
+	{
+		EvictOne();
+	}
+
+	uint32 SlotIndex = Hash & SlotMask;
+	while (Slots[SlotIndex].bOccupied)
+	{
+		SlotIndex = (SlotIndex + 1) & SlotMask;
+	}
+	FEntry& Entry = Slots[SlotIndex];
+	Entry.Key = Key;
+	Entry.Hash = Hash;
+	Entry.Similarity = Similarity;
+	Entry.bOccupied = true;
+	// 新项不设访问位，只有被再次命中过的项才能扛过一轮淘汰
+	Entry.bReferenced = false;
+	Entry.bLogged = false;
+	++NumEntries;
+}
+
+bool FTASimilarityCache::MarkLogged(const FTATagPairKey& Key)
+{
+	const int32 SlotIndex = FindSlot(Key, Key.GetHash());
+	if (SlotIndex == INDEX_NONE || Slots[SlotIndex].bLogged)
+	{
+		return false;
+	}
+	Slots[SlotIndex].bLogged = true;
+	return true;
+}
+
+void FTASimilarityCache::Reset()
+{
+	for (FEntry& Entry : Slots)
+	{
+		Entry = FEntry();
+	}
+	NumEntries = 0;
+	ClockHand = 0;
+	Hits = 0;
+	Misses = 0;
+	Evictions = 0;
+}
+
+float FTASimilarityCache::GetHitRate() const
+{
+	const uint64 Lookups = Hits + Misses;
+	return Lookups > 0 ? static_cast<float>(static_cast<double>(Hits) / Lookups) : 0.f;
+}
+
+FString FTASimilarityCache::GetStatsString() const
+{
+	return FString::Printf(TEXT("相似度缓存 %d/%d，命中 %llu，未命中 %llu，命中率 %.2f%%，淘汰 %llu"),
+		NumEntries, Capacity, Hits, Misses, GetHitRate() * 100.f, Evictions);
+}
+
+int32 FTASimilarityCache::FindSlot(const FTATagPairKey& Key, uint32 Hash) const
+{
+	uint32 SlotIndex = Hash & SlotMask;
+	while (Slots[SlotIndex].bOccupied)
+	{
+		const FEntry& Entry = Slots[SlotIndex];
+		if (Entry.Hash == Hash && Entry.Key == Key)
+		{
+			return static_cast<int32>(SlotIndex);
+		}
+		SlotIndex = (SlotIndex + 1) & SlotMask;
+	}
+	return INDEX_NONE;
+}
+
+void FTASimilarityCache::EvictOne()
+{
+	// 槽位数大于容量，满的时候一定能转一圈找到可淘汰的项
+	while (true)
+	{
+		FEntry& Entry = Slots[ClockHand];
+		const uint32 SlotIndex = ClockHand;
+		ClockHand = (ClockHand + 1) & SlotMask;
+		if (!Entry.bOccupied)
+		{
+			continue;
+		}
+		if (Entry.bReferenced)
+		{
+			Entry.bReferenced = false;
+			continue;
+		}
+		RemoveAt(SlotIndex);
+		++Evictions;
+		return;
+	}
+}
+
+void FTASimilarityCache::RemoveAt(uint32 SlotIndex)
+{
+	uint32 Hole = SlotIndex;
+	uint32 Next = (Hole + 1) & SlotMask;
+	while (Slots[Next].bOccupied)
+	{
+		const uint32 Home = Slots[Next].Hash & SlotMask;
+		// Home不在(Hole, Next]这段环形区间里，说明这一项可以挪到空洞处
+		const bool bHomeBetween = Hole <= Next
+			? (Home > Hole && Home <= Next)
+			: (Home > Hole || Home <= Next);
+		if (!bHomeBetween)
+		{
+			Slots[Hole] = Slots[Next];
+			Hole = Next;
+		}
+		Next = (Next + 1) & SlotMask;
+	}
+	Slots[Hole] = FEntry();
+	--NumEntries;
+}
@@ -0,0 +1,200 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Save/TANarrativeSnapshot.h"
+
+namespace
+{
+	constexpr uint32 SnapshotMagic = 0x534E4154; // "TANS"
+}
+
+void FTASnapshotWriter::AppendUInt(TArray<uint8>& Bytes, uint64 Value)
+{
+	while (Value >= 0x80)
+	{
+		Bytes.Add(static_cast<uint8>(Value | 0x80));
+		Value >>= 7;
+	}
+	Bytes.Add(static_cast<uint8>(Value));
+}
+
+void FTASnapshotWriter::AppendString(TArray<uint8>& Bytes, const FString& Value)
+{
+	const FTCHARToUTF8 Utf8(*Value);
+	AppendUInt(Bytes, Utf8.Length());
+	Bytes.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+}
+
+void FTASnapshotWriter::WriteUInt(uint64 Value)
+{
+	AppendUInt(Body, Value);
+}
+
+void FTASnapshotWriter::WriteInt(int64 Value)
+{
+	AppendUInt(Body, (static_cast<uint64>(Value) << 1) ^ static_cast<uint64>(Value >> 63));
+}
+
+void FTASnapshotWriter::WriteString(const FString& Value)
+{
+	AppendString(Body, Value);
+}
+
+void FTASnapshotWriter::WriteName(FName Value)
+{
+	int32* FoundIndex = NameIndices.Find(Value);
+	if (!FoundIndex)
+	{
+		FoundIndex = &NameIndices.Add(Value, Names.Add(Value));
+	}
+	AppendUInt(Body, *FoundIndex);
+}
+
+void FTASnapshotWriter::WriteGuid(const FGuid& Value)
+{
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		const uint32 Component = Value[Index];
+		Body.Append(reinterpret_cast<const uint8*>(&Component), sizeof(uint32));
+	}
+}
+
+void FTASnapshotWriter::WriteFloat(float Value)
+{
+	Body.Append(reinterpret_cast<const uint8*>(&Value), sizeof(float));
+}
+
+void FTASnapshotWriter::Finish(TArray<uint8>& OutBytes) const
+{
+	OutBytes.Reset(Body.Num() + Names.Num() * 16 + 16);
+	OutBytes.Append(reinterpret_cast<const uint8*>(&SnapshotMagic), sizeof(SnapshotMagic));
+	AppendUInt(OutBytes, TANarrativeSnapshot::CurrentVersion);
+	AppendUInt(OutBytes, Names.Num());
+	for (const FName& Name : Names)
+	{
+		AppendString(OutBytes, Name.ToString());
+	}
+	OutBytes.Append(Body);
+}
+
+FTASnapshotReader::FTASnapshotReader(const TArray<uint8>& InBytes)
+	: Bytes(InBytes)
+{
+	uint32 Magic = 0;
+	if (Bytes.Num() < static_cast<int32>(sizeof(Magic)))
+	{
+		bValid = false;
+		return;
+	}
+	FMemory::Memcpy(&Magic, Bytes.GetData(), sizeof(Magic));
+	Offset = sizeof(Magic);
+	Version = static_cast<uint32>(ReadUInt());
+	if (Magic != SnapshotMagic || Version == 0 || Version > TANarrativeSnapshot::CurrentVersion)
+	{
+		bValid = false;
+		return;
+	}
+	const int32 NameCount = ReadCount();
+	Names.Reserve(NameCount);
+	for (int32 Index = 0; Index < NameCount && bValid; ++Index)
+	{
+		Names.Add(FName(*ReadString()));
+	}
+}
+
+uint64 FTASnapshotReader::ReadUInt()
+{
+	uint64 Value = 0;
+	for (int32 Shift = 0; bValid && Shift < 64; Shift += 7)
+	{
+		if (Offset >= Bytes.Num())
+		{
+			break;
+		}
+		const uint8 Byte = Bytes[Offset++];
+		Value |= static_cast<uint64>(Byte & 0x7F) << Shift;
+		if ((Byte & 0x80) == 0)
+		{
+			return Value;
+		}
+	}
+	bValid = false;
+	return 0;
+}
+
+int64 FTASnapshotReader::ReadInt()
+{
+	const uint64 Encoded = ReadUInt();
+	return static_cast<int64>(Encoded >> 1) ^ -static_cast<int64>(Encoded & 1);
+}
+
+bool FTASnapshotReader::ReadBool()
+{
+	if (!bValid || Offset >= Bytes.Num())
+	{
+		bValid = false;
+		return false;
+	}
+	return Bytes[Offset++] != 0;
+}
+
+FString FTASnapshotReader::ReadString()
+{
+	const int32 Length = ReadCount();
+	if (!bValid || Length == 0)
+	{
+		return FString();
+	}
+	const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Bytes.GetData() + Offset), Length);
+	Offset += Length;
+	return FString(Converted.Length(), Converted.Get());
+}
+
+FName FTASnapshotReader::ReadName()
+{
+	const uint64 Index = ReadUInt();
+	if (!bValid || Index >= static_cast<uint64>(Names.Num()))
+	{
+		bValid = false;
+		return NAME_None;
+	}
+	return Names[Index];
+}
+
+FGuid FTASnapshotReader::ReadGuid()
+{
+	constexpr int32 GuidSize = sizeof(uint32) * 4;
+	if (!bValid || Offset + GuidSize > Bytes.Num())
+	{
+		bValid = false;
+		return FGuid();
+	}
+	uint32 Components[4];
+	FMemory::Memcpy(Components, Bytes.GetData() + Offset, GuidSize);
+	Offset += GuidSize;
+	return FGuid(Components[0], Components[1], Components[2], Components[3]);
+}
+
+float FTASnapshotReader::ReadFloat()
+{
+	if (!bValid || Offset + static_cast<int32>(sizeof(float)) > Bytes.Num())
+	{
+		bValid = false;
+		return 0.f;
+	}
+	float Value;
+	FMemory::Memcpy(&Value, Bytes.GetData() + Offset, sizeof(float));
+	Offset += sizeof(float);
+	return Value;
+}
+
+int32 FTASnapshotReader::ReadCount()
+{
+	const uint64 Count = ReadUInt();
+	if (!bValid || Count > static_cast<uint64>(Bytes.Num() - Offset))
+	{
+		bValid = false;
+		return 0;
+	}
+	return static_cast<int32>(Count);
+}
@@ -6,6 +6,7 @@
 #include "Save/TAGuidInterface.h"
 #include "Save/TASaveGame.h"
 #include "Chat/TAChatComponent.h"
+#include "Event/Core/TAEventSubsystem.h"
 #include "Kismet/GameplayStatics.h"
 
 
@@ -33,6 +34,14 @@ void UTASaveGameSubsystem::StoreAllTAData()
 	
 	//存储NameGuidMap到存档实例中
 	SaveGameInstance->NameGuidMap = this->NameGuidMap;
+
+	// 叙事状态整体存一份二进制快照，读档时不用再让大模型重新生成事件
+	if (UTAEventSubsystem* EventSubsystem = GetWorld()->GetSubsystem<UTAEventSubsystem>())
+	{
+		EventSubsystem->WriteNarrativeSnapshot(SaveGameInstance->NarrativeSnapshot);
+		SaveGameInstance->NarrativeSnapshotLevelName = UGameplayStatics::GetCurrentLevelName(GetWorld());
+		UE_LOG(logTASave, Display, TEXT("StoreAllTAData - Narrative snapshot %d bytes."), SaveGameInstance->NarrativeSnapshot.Num());
+	}
 	
 	//存档
 	UGameplayStatics::SaveGameToSlot(SaveGameInstance, "TASaveGameSlot", 0);
@@ -80,6 +89,29 @@ void UTASaveGameSubsystem::RestoreNameTAGuidMap()
 	UE_LOG(logTASave, Display, TEXT("RestoreNameTAGuidMap - Restored NameGuidMap data."));
 }
 
+bool UTASaveGameSubsystem::RestoreNarrativeState()
+{
+	if(!SaveGameInstance || SaveGameInstance->NarrativeSnapshot.Num() == 0)
+	{
+		UE_LOG(logTASave, Display, TEXT("RestoreNarrativeState - No narrative snapshot found."));
+		return false;
+	}
+	const FString LevelName = UGameplayStatics::GetCurrentLevelName(GetWorld());
+	if(SaveGameInstance->NarrativeSnapshotLevelName != LevelName)
+	{
+		UE_LOG(logTASave, Display, TEXT("RestoreNarrativeState - Snapshot is for level %s, current level is %s."), *SaveGameInstance->NarrativeSnapshotLevelName, *LevelName);
+		return false;
+	}
+	UTAEventSubsystem* EventSubsystem = GetWorld()->GetSubsystem<UTAEventSubsystem>();
+	if(!EventSubsystem || !EventSubsystem->RestoreNarrativeSnapshot(SaveGameInstance->NarrativeSnapshot))
+	{
+		UE_LOG(logTASave, Warning, TEXT("RestoreNarrativeState - Restore failed."));
+		return false;
+	}
+	UE_LOG(logTASave, Display, TEXT("RestoreNarrativeState - Restored narrative snapshot."));
+	return true;
+}
+
 /*void UTASaveGameSubsystem::RestoreAllTAData()
 {
 	//从存档槽中加载存档实例
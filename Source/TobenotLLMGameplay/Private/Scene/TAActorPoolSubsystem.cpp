@@ -0,0 +1,259 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Scene/TAActorPoolSubsystem.h"
+
+#include "TASettings.h"
+#include "Chat/TAInteractionComponent.h"
+#include "Common/TAFrameBudgetSubsystem.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/EngineVersionComparison.h"
+#include "Scene/TAInteractiveActor.h"
+#include "Scene/TAPlaceActor.h"
+#include "Scene/TAPoolableInterface.h"
+#include "Scene/TASceneLogCategory.h"
+
+DECLARE_STATS_GROUP(TEXT("TA ActorPool"), STATGROUP_TAActorPool, STATCAT_Advanced);
+DECLARE_CYCLE_STAT(TEXT("Spawn Actor"), STAT_TAActorPoolSpawn, STATGROUP_TAActorPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Spawn Hitches"), STAT_TAActorPoolSpawnHitches, STATGROUP_TAActorPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Reused Actors"), STAT_TAActorPoolReused, STATGROUP_TAActorPool);
+
+static FAutoConsoleCommandWithWorldAndArgs GTAActorPoolReportCommand(
+	TEXT("TA.ActorPool.Report"),
+	TEXT("打印场景Actor池的复用情况和生成卡顿次数，加参数 reset 清空统计"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UTAActorPoolSubsystem* ActorPool = World ? World->GetSubsystem<UTAActorPoolSubsystem>() : nullptr)
+		{
+			UE_LOG(LogTASceneSystem, Log, TEXT("%s"), *ActorPool->GetReportString());
+			if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			{
+				ActorPool->ResetStats();
+			}
+		}
+	}));
+
+void UTAActorPoolSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// 类只在这里解析一次，之后生成时不再TryLoadClass
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	if (Settings)
+	{
+		PlaceActorClass = Settings->PlaceActorClass.TryLoadClass<ATAPlaceActor>();
+		InteractiveActorClass = Settings->InteractiveActorClass.TryLoadClass<ATAInteractiveActor>();
+		InteractionComponentClass = Settings->InteractionComponentClass.TryLoadClass<UTAInteractionComponent>();
+		MaxPooledPerClass = FMath::Max(0, Settings->ActorPoolMaxPerClass);
+		SpawnHitchThresholdMs = FMath::Max(0.f, Settings->SpawnHitchThresholdMilliseconds);
+	}
+	
+	// 如果没有指定类或者类加载失败，使用默认类
+	if (!PlaceActorClass)
+	{
+		PlaceActorClass = ATAPlaceActor::StaticClass();
+	}
+	if (!InteractiveActorClass)
+	{
+		InteractiveActorClass = ATAInteractiveActor::StaticClass();
+	}
+	if (!InteractionComponentClass)
+	{
+		InteractionComponentClass = UTAInteractionComponent::StaticClass();
+	}
+}
+
+void UTAActorPoolSubsystem::Deinitialize()
+{
+	Pools.Empty();
+	Super::Deinitialize();
+}
+
+void UTAActorPoolSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	if (const UTASettings* Settings = GetDefault<UTASettings>())
+	{
+		Prewarm(InteractiveActorClass, Settings->ActorPoolPrewarmInteractiveActors);
+	}
+}
+
+AActor* UTAActorPoolSubsystem::SpawnNewActor(UClass* Class, const FTransform& Transform)
+{
+	SCOPE_CYCLE_COUNTER(STAT_TAActorPoolSpawn);
+	const double StartTime = FPlatformTime::Seconds();
+	
+	AActor* NewActor = GetWorld()->SpawnActor<AActor>(Class, Transform);
+	
+	const double SpawnMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	++Stats.Spawned;
+	Stats.TotalSpawnMs += SpawnMs;
+	Stats.MaxSpawnMs = FMath::Max(Stats.MaxSpawnMs, SpawnMs);
+	if (SpawnMs > SpawnHitchThresholdMs)
+	{
+		++Stats.SpawnHitches;
+		INC_DWORD_STAT(STAT_TAActorPoolSpawnHitches);
+		UE_LOG(LogTASceneSystem, Verbose, TEXT("生成 %s 耗时 %.2f ms"), *GetNameSafe(Class), SpawnMs);
+	}
+	return NewActor;
+}
+
+void UTAActorPoolSubsystem::DeactivateActor(AActor* Actor)
+{
+	Actor->SetActorHiddenInGame(true);
+	Actor->SetActorEnableCollision(false);
+	Actor->SetActorTickEnabled(false);
+}
+
+AActor* UTAActorPoolSubsystem::AcquireActor(UClass* Class, const FTransform& Transform)
+{
+	if (!Class || !GetWorld())
+	{
+		return nullptr;
+	}
+	
+	if (FTAActorPoolBucket* Bucket = Pools.Find(Class))
+	{
+		while (Bucket->Actors.Num() > 0)
+		{
+#if UE_VERSION_OLDER_THAN(5, 4, 0)
+			AActor* Actor = Bucket->Actors.Pop(false);
+#else
+			AActor* Actor = Bucket->Actors.Pop(EAllowShrinking::No);
+#endif
+			if (!IsValid(Actor))
+			{
+				continue;
+			}
+			Actor->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+			Actor->SetActorHiddenInGame(false);
+			Actor->SetActorEnableCollision(true);
+			Actor->SetActorTickEnabled(Actor->PrimaryActorTick.bStartWithTickEnabled);
+			if (ITAPoolableInterface* Poolable = Cast<ITAPoolableInterface>(Actor))
+			{
+				Poolable->OnAcquiredFromPool();
+			}
+			++Stats.Reused;
+			INC_DWORD_STAT(STAT_TAActorPoolReused);
+			return Actor;
+		}
+	}
+	return SpawnNewActor(Class, Transform);
+}
+
+void UTAActorPoolSubsystem::ReleaseActor(AActor* Actor)
+{
+	if (!IsValid(Actor))
+	{
+		return;
+	}
+	
+	FTAActorPoolBucket& Bucket = Pools.FindOrAdd(Actor->GetClass());
+	if (Bucket.Actors.Contains(Actor))
+	{
+		return;
+	}
+	if (Bucket.Actors.Num() >= MaxPooledPerClass)
+	{
+		Actor->Destroy();
+		++Stats.Destroyed;
+		return;
+	}
+	
+	if (ITAPoolableInterface* Poolable = Cast<ITAPoolableInterface>(Actor))
+	{
+		Poolable->OnReleasedToPool();
+	}
+	DeactivateActor(Actor);
+	Bucket.Actors.Add(Actor);
+	++Stats.Released;
+}
+
+void UTAActorPoolSubsystem::AcquireActorsAmortized(const UObject* Owner, UClass* Class, TArray<FTransform>&& Transforms, TFunction<void(AActor*, int32)> OnAcquired)
+{
+	auto AcquireOne = [this, Class, Transforms = MoveTemp(Transforms), OnAcquired = MoveTemp(OnAcquired)](int32 Index)
+	{
+		if (!Transforms.IsValidIndex(Index))
+		{
+			return;
+		}
+		AActor* Actor = AcquireActor(Class, Transforms[Index]);
+		if (OnAcquired)
+		{
+			OnAcquired(Actor, Index);
+		}
+	};
+	const int32 Num = Transforms.Num();
+	
+	UTAFrameBudgetSubsystem* FrameBudget = GetWorld() ? GetWorld()->GetSubsystem<UTAFrameBudgetSubsystem>() : nullptr;
+	if (FrameBudget)
+	{
+		// Owner没了就不用再生成了；池子自己也得在，所以两个都要检查
+		TWeakObjectPtr<const UObject> WeakOwner(Owner);
+		FrameBudget->SubmitForEach(this, TEXT("ActorPool.Acquire"), Num, [WeakOwner, AcquireOne = MoveTemp(AcquireOne)](int32 Index)
+		{
+			if (WeakOwner.IsValid())
+			{
+				AcquireOne(Index);
+			}
+		});
+	}
+	else
+	{
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			AcquireOne(Index);
+		}
+	}
+}
+
+void UTAActorPoolSubsystem::Prewarm(UClass* Class, int32 Num)
+{
+	if (!Class || Num <= 0)
+	{
+		return;
+	}
+	UTAFrameBudgetSubsystem* FrameBudget = GetWorld() ? GetWorld()->GetSubsystem<UTAFrameBudgetSubsystem>() : nullptr;
+	if (!FrameBudget)
+	{
+		return;
+	}
+	const int32 PrewarmNum = FMath::Min(Num, MaxPooledPerClass);
+	FrameBudget->SubmitForEach(this, TEXT("ActorPool.Prewarm"), PrewarmNum, [this, Class](int32 Index)
+	{
+		if (GetNumPooled(Class) >= MaxPooledPerClass)
+		{
+			return;
+		}
+		// 放到原点隐藏起来，取出时再挪到目标位置
+		if (AActor* Actor = SpawnNewActor(Class, FTransform::Identity))
+		{
+			DeactivateActor(Actor);
+			Pools.FindOrAdd(Class).Actors.Add(Actor);
+		}
+	});
+}
+
+int32 UTAActorPoolSubsystem::GetNumPooled(UClass* Class) const
+{
+	const FTAActorPoolBucket* Bucket = Pools.Find(Class);
+	return Bucket ? Bucket->Actors.Num() : 0;
+}
+
+FString UTAActorPoolSubsystem::GetReportString() const
+{
+	FString Report = FString::Printf(TEXT("Actor池：新生成 %d，复用 %d，放回 %d，超上限销毁 %d\n")
+		TEXT("生成耗时：平均 %.2f ms，最大 %.2f ms，超过 %.2f ms 的卡顿 %d 次"),
+		Stats.Spawned, Stats.Reused, Stats.Released, Stats.Destroyed,
+		Stats.Spawned > 0 ? Stats.TotalSpawnMs / Stats.Spawned : 0.0, Stats.MaxSpawnMs, SpawnHitchThresholdMs, Stats.SpawnHitches);
+	for (const TPair<UClass*, FTAActorPoolBucket>& Pair : Pools)
+	{
+		Report += FString::Printf(TEXT("\n  %s：池中 %d"), *GetNameSafe(Pair.Key), Pair.Value.Actors.Num());
+	}
+	return Report;
+}
+
+void UTAActorPoolSubsystem::ResetStats()
+{
+	Stats = FPoolStats();
+}
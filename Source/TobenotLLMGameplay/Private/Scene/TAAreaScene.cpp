@@ -3,10 +3,17 @@
 #include "Scene/TAAreaScene.h"
 #include "Scene/TAInteractiveActor.h"
 #include "TASettings.h"
+#include "Common/TAAsyncParse.h"
 #include "Common/TALLMLibrary.h"
 #include "Common/TASystemLibrary.h"
 #include "Event/Data/TAEventInfo.h"
 #include "Save/TAGuidSubsystem.h"
+#include "Save/TANarrativeSnapshot.h"
+#include "Chat/Dialogue/TADialogueComponent.h"
+#include "Chat/Dialogue/TADialogueInstance.h"
+#include "Misc/Compression.h"
+#include "Scene/TAActorPoolSubsystem.h"
+#include "Scene/TASceneSubsystem.h"
 #include "Scene/TASceneLogCategory.h"
 
 void UTAAreaScene::LoadAreaScene(const FTAEventInfo& EventInfo)
@@ -54,112 +61,454 @@ void UTAAreaScene::LoadAreaScene(const FTAEventInfo& EventInfo)
 	// 异步发送消息
 	CacheChat = UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [this, EventInfo](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
 	{
-		if (Success)
+		CacheChat = nullptr;
+		if (!Success)
 		{
-			TSharedPtr<FJsonObject> JsonObject;
-			const TArray<TSharedPtr<FJsonValue>>* InteractablesArrayJson;
-			const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Message.message.content);
-
-			if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+			return;
+		}
+		// JSON解析在工作线程做，回到游戏线程再生成交互物
+		struct FParsedInteractables
+		{
+			TArray<FInteractableInfo> Interactables;
+			bool bValid = false;
+		};
+		const FString Content = Message.message.content;
+		TAAsyncParse::ParseThenApply<FParsedInteractables>(this,
+			[Content]()
+			{
+				FParsedInteractables Parsed;
+				Parsed.bValid = ParseInteractablesFromJson(Content, Parsed.Interactables);
+				return Parsed;
+			},
+			[this, EventInfo](FParsedInteractables& Parsed)
 			{
-				InteractablesArray.Empty();
-				if (JsonObject->TryGetArrayField(TEXT("Interactables"), InteractablesArrayJson))
+				if (!Parsed.bValid)
 				{
-					// 遍历JSON数组并处理每个交互物
-					// 遍历JSON数组
-					for (int32 Index = 0; Index < InteractablesArrayJson->Num(); ++Index)
-					{
-						// 获取每个交互物的JSON对象
-						TSharedPtr<FJsonObject> InteractableJson = (*InteractablesArrayJson)[Index]->AsObject();
-						if (InteractableJson.IsValid())
-						{
-							// 创建结构体实例并填充数据
-							FInteractableInfo InteractableInfo;
-							InteractableInfo.Name = InteractableJson->GetStringField(TEXT("Name"));
-							InteractableInfo.UniqueFeature = InteractableJson->GetStringField(TEXT("UniqueFeature"));
-							InteractableInfo.Objective = InteractableJson->GetStringField(TEXT("Objective"));
-
-							// 将填充好的结构体添加到数组中
-							InteractablesArray.Add(InteractableInfo);
-						}
-					}
+					return;
+				}
+				InteractablesArray = MoveTemp(Parsed.Interactables);
+				if (InteractablesArray.Num() > 0)
+				{
+					SpawnInteractables(EventInfo);
 				}
 				else
+				{
+					UE_LOG(LogTASceneSystem, Error, TEXT("未解析到数组或者非数组形式的交互物数据"));
+				}
+			});
+	},this);
+}
+
+bool UTAAreaScene::ParseInteractablesFromJson(const FString& Content, TArray<FInteractableInfo>& OutInteractables)
+{
+	TSharedPtr<FJsonObject> JsonObject;
+	const TArray<TSharedPtr<FJsonValue>>* InteractablesArrayJson;
+	const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Content);
+
+	if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+	{
+		OutInteractables.Empty();
+		if (JsonObject->TryGetArrayField(TEXT("Interactables"), InteractablesArrayJson))
+		{
+			// 遍历JSON数组并处理每个交互物
+			// 遍历JSON数组
+			for (int32 Index = 0; Index < InteractablesArrayJson->Num(); ++Index)
+			{
+				// 获取每个交互物的JSON对象
+				TSharedPtr<FJsonObject> InteractableJson = (*InteractablesArrayJson)[Index]->AsObject();
+				if (InteractableJson.IsValid())
 				{
 					// 创建结构体实例并填充数据
 					FInteractableInfo InteractableInfo;
-					if (JsonObject->HasField(TEXT("Name")))
-					{
-						InteractableInfo.Name = JsonObject->GetStringField(TEXT("Name"));
-					}
-					if (JsonObject->HasField(TEXT("UniqueFeature")))
-					{
-						InteractableInfo.UniqueFeature = JsonObject->GetStringField(TEXT("UniqueFeature"));
-					}
-					if (JsonObject->HasField(TEXT("Objective")))
-					{
-						InteractableInfo.Objective = JsonObject->GetStringField(TEXT("Objective"));
-					}
+					InteractableInfo.Name = InteractableJson->GetStringField(TEXT("Name"));
+					InteractableInfo.UniqueFeature = InteractableJson->GetStringField(TEXT("UniqueFeature"));
+					InteractableInfo.Objective = InteractableJson->GetStringField(TEXT("Objective"));
 
 					// 将填充好的结构体添加到数组中
-					InteractablesArray.Add(InteractableInfo);
+					OutInteractables.Add(InteractableInfo);
 				}
-				if (InteractablesArray.Num()>0)
-				{
-					UClass* InteractiveActorClass = nullptr;
-					const UTASettings* Settings = GetDefault<UTASettings>();
-					if (Settings)
-					{
-						InteractiveActorClass = Settings->InteractiveActorClass.TryLoadClass<ATAInteractiveActor>();
-					}
-					// 如果没有指定类或者类加载失败，使用默认的InteractiveActorClass类
-					if (!InteractiveActorClass)
-					{
-						InteractiveActorClass = ATAInteractiveActor::StaticClass();
-					}
-
-					// 定义位置和旋转
-					UTAGuidSubsystem* GuidSubsystem = GetWorld()->GetSubsystem<UTAGuidSubsystem>();
-					if(GuidSubsystem)
-					{
-						AActor* PlaceActor = GuidSubsystem->GetActorByGUID(EventInfo.LocationGuid);
-						if (PlaceActor)
-						{
-							// 获取位置
-							FVector Location = PlaceActor->GetActorLocation();
-							FRotator Rotation = PlaceActor->GetActorRotation();
-					        
-							// 生成交互物
-							for (const FInteractableInfo& Interactable : InteractablesArray)
-							{
-								FVector NewLocation = Location + FMath::VRand() * 200;
-								NewLocation.Z = Location.Z;
-								FRotator NewRotation = Rotation + FRotator(0, (FMath::FRand() - 0.5) * 180, 0);
-
-								// 旋转直接随机数
-								ATAInteractiveActor* NewActor = GetWorld()->SpawnActor<ATAInteractiveActor>(InteractiveActorClass, NewLocation, NewRotation);
-								if (NewActor)
-								{
-									UTAInteractionComponent* InteractionCom = NewActor->GetInteractionComponent();
-									if (InteractionCom)
-									{
-										InteractionCom->InteractableInfo = Interactable;
-										InteractionCom->BelongEventDescription = EventInfo.PresetData.Description;
-									}
-									InteractiveActors.Add(NewActor);
-								}
-							}
-						}else
-						{
-							UE_LOG(LogTASceneSystem, Error, TEXT("LoadAreaScene 未绑定位点，生成交互物失败"));
-						}
-					}
-				}else
+			}
+		}
+		else
+		{
+			// 创建结构体实例并填充数据
+			FInteractableInfo InteractableInfo;
+			if (JsonObject->HasField(TEXT("Name")))
+			{
+				InteractableInfo.Name = JsonObject->GetStringField(TEXT("Name"));
+			}
+			if (JsonObject->HasField(TEXT("UniqueFeature")))
+			{
+				InteractableInfo.UniqueFeature = JsonObject->GetStringField(TEXT("UniqueFeature"));
+			}
+			if (JsonObject->HasField(TEXT("Objective")))
+			{
+				InteractableInfo.Objective = JsonObject->GetStringField(TEXT("Objective"));
+			}
+
+			// 将填充好的结构体添加到数组中
+			OutInteractables.Add(InteractableInfo);
+		}
+		return true;
+	}
+	return false;
+}
+
+void UTAAreaScene::SpawnInteractables(const FTAEventInfo& EventInfo)
+{
+	// 交互物类由Actor池在启动时解析好
+	UTAActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UTAActorPoolSubsystem>();
+	if (!ActorPool)
+	{
+		UE_LOG(LogTASceneSystem, Error, TEXT("LoadAreaScene 无法获取ActorPool，生成交互物失败"));
+		return;
+	}
+
+	// 定义位置和旋转
+	UTAGuidSubsystem* GuidSubsystem = GetWorld()->GetSubsystem<UTAGuidSubsystem>();
+	if(GuidSubsystem)
+	{
+		AActor* PlaceActor = GuidSubsystem->GetActorByGUID(EventInfo.LocationGuid);
+		if (PlaceActor)
+		{
+			// 获取位置
+			FVector Location = PlaceActor->GetActorLocation();
+			FRotator Rotation = PlaceActor->GetActorRotation();
+
+			// 先算好每个交互物的位置，旋转直接随机数
+			TArray<FTransform> Transforms;
+			Transforms.Reserve(InteractablesArray.Num());
+			for (int32 Index = 0; Index < InteractablesArray.Num(); ++Index)
+			{
+				FVector NewLocation = Location + FMath::VRand() * 200;
+				NewLocation.Z = Location.Z;
+				FRotator NewRotation = Rotation + FRotator(0, (FMath::FRand() - 0.5) * 180, 0);
+				Transforms.Add(FTransform(NewRotation, NewLocation));
+			}
+
+			SceneCenter = Location;
+			bHasSceneCenter = true;
+			EventDescription = EventInfo.PresetData.Description;
+
+			// 交互物记进位点所在区域
+			if (UTASceneSubsystem* SceneSubsystem = GetWorld()->GetSubsystem<UTASceneSubsystem>())
+			{
+				TArray<FString> InteractableNames;
+				for (const FInteractableInfo& Info : InteractablesArray)
 				{
-					UE_LOG(LogTASceneSystem, Error, TEXT("未解析到数组或者非数组形式的交互物数据"));
+					InteractableNames.Add(Info.Name);
 				}
+				SceneSubsystem->AddRegionFact(Location, TEXT("Interactables: ") + FString::Join(InteractableNames, TEXT(", ")));
 			}
+			
+			// 交给Actor池分帧生成，每步取一个，池里有回收的就直接复用
+			NumPendingSpawns += Transforms.Num();
+			ActorPool->AcquireActorsAmortized(this, ActorPool->GetInteractiveActorClass(), MoveTemp(Transforms),
+				[this, Generation = SpawnGeneration](AActor* Actor, int32 Index)
+				{
+					OnInteractiveActorAcquired(Actor, InteractablesArray.IsValidIndex(Index) ? InteractablesArray[Index] : FInteractableInfo(), Generation);
+				});
+		}else
+		{
+			UE_LOG(LogTASceneSystem, Error, TEXT("LoadAreaScene 未绑定位点，生成交互物失败"));
 		}
-		CacheChat = nullptr;
-	},this);
+	}
+}
+
+void UTAAreaScene::UnloadAreaScene()
+{
+	// 还在分帧生成的交互物作废，到了也不再加进这个场景
+	++SpawnGeneration;
+	NumPendingSpawns = 0;
+	UTAActorPoolSubsystem* ActorPool = GetWorld() ? GetWorld()->GetSubsystem<UTAActorPoolSubsystem>() : nullptr;
+	for (ATAInteractiveActor* InteractiveActor : InteractiveActors)
+	{
+		if (!IsValid(InteractiveActor))
+		{
+			continue;
+		}
+		if (ActorPool)
+		{
+			ActorPool->ReleaseActor(InteractiveActor);
+		}
+		else
+		{
+			InteractiveActor->Destroy();
+		}
+	}
+	InteractiveActors.Empty();
+}
+
+bool UTAAreaScene::OnInteractiveActorAcquired(AActor* Actor, const FInteractableInfo& Info, int32 Generation)
+{
+	if (Generation != SpawnGeneration)
+	{
+		if (Actor)
+		{
+			UTAActorPoolSubsystem* ActorPool = GetWorld() ? GetWorld()->GetSubsystem<UTAActorPoolSubsystem>() : nullptr;
+			if (ActorPool)
+			{
+				ActorPool->ReleaseActor(Actor);
+			}
+			else
+			{
+				Actor->Destroy();
+			}
+		}
+		return false;
+	}
+	NumPendingSpawns = FMath::Max(0, NumPendingSpawns - 1);
+	ATAInteractiveActor* NewActor = Cast<ATAInteractiveActor>(Actor);
+	if (!NewActor)
+	{
+		return false;
+	}
+	UTAInteractionComponent* InteractionCom = NewActor->GetInteractionComponent();
+	if (InteractionCom)
+	{
+		InteractionCom->InteractableInfo = Info;
+		InteractionCom->BelongEventDescription = EventDescription;
+	}
+	InteractiveActors.Add(NewActor);
+	return true;
+}
+
+bool UTAAreaScene::GetSceneCenter(FVector& OutCenter) const
+{
+	OutCenter = SceneCenter;
+	return bHasSceneCenter;
+}
+
+namespace TAAreaSceneHibernation
+{
+	// 快照里单个交互物的数据
+	struct FInteractableState
+	{
+		FTransform Transform;
+		FInteractableInfo Info;
+		FTAChatComponentSaveData ChatData;
+		TArray<FChatLog> DialogueHistory;
+		TArray<FChatLog> FullDialogueHistory;
+		FString DialogueCompressedStr;
+	};
+
+	void WriteChatLogs(FTASnapshotWriter& Writer, const TArray<FChatLog>& Logs)
+	{
+		Writer.WriteUInt(Logs.Num());
+		for (const FChatLog& Log : Logs)
+		{
+			Writer.WriteUInt(static_cast<uint64>(Log.role));
+			Writer.WriteString(Log.content);
+		}
+	}
+
+	void ReadChatLogs(FTASnapshotReader& Reader, TArray<FChatLog>& OutLogs)
+	{
+		const int32 Num = Reader.ReadCount();
+		OutLogs.Reserve(Num);
+		for (int32 Index = 0; Index < Num && Reader.IsValid(); ++Index)
+		{
+			FChatLog& Log = OutLogs.AddDefaulted_GetRef();
+			Log.role = static_cast<EOAChatRole>(Reader.ReadUInt());
+			Log.content = Reader.ReadString();
+		}
+	}
+
+	void WriteVector(FTASnapshotWriter& Writer, const FVector& Value)
+	{
+		Writer.WriteFloat(Value.X);
+		Writer.WriteFloat(Value.Y);
+		Writer.WriteFloat(Value.Z);
+	}
+
+	FVector ReadVector(FTASnapshotReader& Reader)
+	{
+		const float X = Reader.ReadFloat();
+		const float Y = Reader.ReadFloat();
+		const float Z = Reader.ReadFloat();
+		return FVector(X, Y, Z);
+	}
+}
+
+bool UTAAreaScene::IsInteractableBusy(const AActor* InteractiveActor)
+{
+	if (const UTADialogueComponent* DialogueCom = InteractiveActor->FindComponentByClass<UTADialogueComponent>())
+	{
+		const UTADialogueInstance* DialogueInstance = DialogueCom->GetCurrentDialogueInstance();
+		if (DialogueInstance && DialogueInstance->DialogueState != EDialogueState::End)
+		{
+			return true;
+		}
+	}
+	const UTAChatComponent* ChatCom = InteractiveActor->FindComponentByClass<UTAChatComponent>();
+	return ChatCom && ChatCom->HasPendingRequests();
+}
+
+bool UTAAreaScene::Hibernate()
+{
+	using namespace TAAreaSceneHibernation;
+	if (bIsHibernating || NumPendingSpawns > 0)
+	{
+		return false;
+	}
+	
+	TArray<ATAInteractiveActor*> ValidActors;
+	for (ATAInteractiveActor* InteractiveActor : InteractiveActors)
+	{
+		if (IsValid(InteractiveActor))
+		{
+			// 还在对话或者有请求在途的交互物不能回收，整个场景等下次再试
+			if (IsInteractableBusy(InteractiveActor))
+			{
+				return false;
+			}
+			ValidActors.Add(InteractiveActor);
+		}
+	}
+	FTASnapshotWriter Writer;
+	Writer.WriteUInt(ValidActors.Num());
+	for (ATAInteractiveActor* InteractiveActor : ValidActors)
+	{
+		WriteVector(Writer, InteractiveActor->GetActorLocation());
+		Writer.WriteFloat(InteractiveActor->GetActorRotation().Yaw);
+		
+		const UTAInteractionComponent* InteractionCom = InteractiveActor->GetInteractionComponent();
+		const FInteractableInfo Info = InteractionCom ? InteractionCom->InteractableInfo : FInteractableInfo();
+		Writer.WriteString(Info.Name);
+		Writer.WriteString(Info.UniqueFeature);
+		Writer.WriteString(Info.Objective);
+
+		const UTAChatComponent* ChatCom = InteractiveActor->FindComponentByClass<UTAChatComponent>();
+		const FTAChatComponentSaveData ChatData = ChatCom ? ChatCom->GetChatHistoryData() : FTAChatComponentSaveData();
+		Writer.WriteUInt(ChatData.SavedActorChatHistoryMap.Num());
+		for (const TPair<FGuid, FTAActorChatHistory>& Pair : ChatData.SavedActorChatHistoryMap)
+		{
+			Writer.WriteGuid(Pair.Key);
+			WriteChatLogs(Writer, Pair.Value.ChatHistory);
+		}
+
+		const UTADialogueComponent* DialogueCom = InteractiveActor->FindComponentByClass<UTADialogueComponent>();
+		Writer.WriteBool(DialogueCom != nullptr);
+		if (DialogueCom)
+		{
+			WriteChatLogs(Writer, DialogueCom->GetDialogueHistory());
+			WriteChatLogs(Writer, DialogueCom->GetFullDialogueHistory());
+			Writer.WriteString(DialogueCom->GetDialogueHistoryCompressedStr());
+		}
+	}
+
+	// 聊天记录是大段文本，再压一次
+	TArray<uint8> RawBytes;
+	Writer.Finish(RawBytes);
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, RawBytes.Num());
+	HibernatedBlob.SetNumUninitialized(CompressedSize);
+	if (FCompression::CompressMemory(NAME_Zlib, HibernatedBlob.GetData(), CompressedSize, RawBytes.GetData(), RawBytes.Num()))
+	{
+		HibernatedBlob.SetNum(CompressedSize);
+		HibernatedRawSize = RawBytes.Num();
+	}
+	else
+	{
+		HibernatedBlob = MoveTemp(RawBytes);
+		HibernatedRawSize = 0;
+	}
+	HibernatedBlob.Shrink();
+
+	UE_LOG(LogTASceneSystem, Log, TEXT("区域场景休眠：交互物 %d 个，快照 %d 字节"), ValidActors.Num(), HibernatedBlob.Num());
+	UnloadAreaScene();
+	bIsHibernating = true;
+	return true;
+}
+
+void UTAAreaScene::Rehydrate()
+{
+	using namespace TAAreaSceneHibernation;
+	if (!bIsHibernating)
+	{
+		return;
+	}
+	bIsHibernating = false;
+	
+	TArray<uint8> RawBytes;
+	if (HibernatedRawSize > 0)
+	{
+		RawBytes.SetNumUninitialized(HibernatedRawSize);
+		if (!FCompression::UncompressMemory(NAME_Zlib, RawBytes.GetData(), HibernatedRawSize, HibernatedBlob.GetData(), HibernatedBlob.Num()))
+		{
+			RawBytes.Reset();
+		}
+	}
+	else
+	{
+		RawBytes = MoveTemp(HibernatedBlob);
+	}
+	HibernatedBlob.Empty();
+	HibernatedRawSize = 0;
+
+	FTASnapshotReader Reader(RawBytes);
+	TArray<FInteractableState> States;
+	const int32 Num = Reader.ReadCount();
+	for (int32 Index = 0; Index < Num && Reader.IsValid(); ++Index)
+	{
+		FInteractableState& State = States.AddDefaulted_GetRef();
+		const FVector Location = ReadVector(Reader);
+		const float Yaw = Reader.ReadFloat();
+		State.Transform = FTransform(FRotator(0.f, Yaw, 0.f), Location);
+		State.Info.Name = Reader.ReadString();
+		State.Info.UniqueFeature = Reader.ReadString();
+		State.Info.Objective = Reader.ReadString();
+		
+		const int32 ChatNum = Reader.ReadCount();
+		for (int32 ChatIndex = 0; ChatIndex < ChatNum && Reader.IsValid(); ++ChatIndex)
+		{
+			const FGuid ActorGuid = Reader.ReadGuid();
+			ReadChatLogs(Reader, State.ChatData.SavedActorChatHistoryMap.FindOrAdd(ActorGuid).ChatHistory);
+		}
+		if (Reader.ReadBool())
+		{
+			ReadChatLogs(Reader, State.DialogueHistory);
+			ReadChatLogs(Reader, State.FullDialogueHistory);
+			State.DialogueCompressedStr = Reader.ReadString();
+		}
+	}
+	if (!Reader.IsValid())
+	{
+		UE_LOG(LogTASceneSystem, Error, TEXT("区域场景休眠快照损坏，交互物无法恢复"));
+		return;
+	}
+	
+	UTAActorPoolSubsystem* ActorPool = GetWorld() ? GetWorld()->GetSubsystem<UTAActorPoolSubsystem>() : nullptr;
+	if (!ActorPool)
+	{
+		return;
+	}
+	TArray<FTransform> Transforms;
+	for (const FInteractableState& State : States)
+	{
+		Transforms.Add(State.Transform);
+	}
+	UE_LOG(LogTASceneSystem, Log, TEXT("区域场景重建：交互物 %d 个"), States.Num());
+	
+	NumPendingSpawns += Transforms.Num();
+	TSharedRef<TArray<FInteractableState>> SharedStates = MakeShared<TArray<FInteractableState>>(MoveTemp(States));
+	ActorPool->AcquireActorsAmortized(this, ActorPool->GetInteractiveActorClass(), MoveTemp(Transforms),
+		[this, SharedStates, Generation = SpawnGeneration](AActor* Actor, int32 Index)
+		{
+			const FInteractableState& State = (*SharedStates)[Index];
+			if (!OnInteractiveActorAcquired(Actor, State.Info, Generation))
+			{
+				return;
+			}
+			if (UTAChatComponent* ChatCom = Actor->FindComponentByClass<UTAChatComponent>())
+			{
+				ChatCom->SetChatHistoryData(State.ChatData);
+			}
+			if (UTADialogueComponent* DialogueCom = Actor->FindComponentByClass<UTADialogueComponent>())
+			{
+				if (State.DialogueHistory.Num() > 0 || State.FullDialogueHistory.Num() > 0 || !State.DialogueCompressedStr.IsEmpty())
+				{
+					DialogueCom->RestoreDialogueHistory(State.DialogueHistory, State.FullDialogueHistory, State.DialogueCompressedStr);
+				}
+			}
+		});
 }
@@ -7,15 +7,20 @@
 #include "Chat/TAFunctionInvokeComponent.h"
 #include "Chat/Dialogue/TADialogueComponent.h"
 #include "Components/SphereComponent.h"
+#include "Scene/TAActorPoolSubsystem.h"
 
 void ATAInteractiveActor::OnConstruction(const FTransform& Transform)
 {
 	Super::OnConstruction(Transform);
 	   
-	// 初始化InteractionComponent
+	// 初始化InteractionComponent，类由Actor池解析好，不用每次TryLoadClass
 	UClass* InteractionComponentClass = nullptr;
-	const UTASettings* Settings = GetDefault<UTASettings>();
-	if (Settings)
+	const UTAActorPoolSubsystem* ActorPool = GetWorld() ? GetWorld()->GetSubsystem<UTAActorPoolSubsystem>() : nullptr;
+	if (ActorPool)
+	{
+		InteractionComponentClass = ActorPool->GetInteractionComponentClass();
+	}
+	else if (const UTASettings* Settings = GetDefault<UTASettings>())
 	{
 		InteractionComponentClass = Settings->InteractionComponentClass.TryLoadClass<UTAInteractionComponent>();
 	}
@@ -36,6 +41,9 @@ void ATAInteractiveActor::OnConstruction(const FTransform& Transform)
 
 ATAInteractiveActor::ATAInteractiveActor()
 {
+	// 交互物只响应对话和交互，不需要Tick
+	PrimaryActorTick.bCanEverTick = false;
+	
 	// 初始化一个简单的SceneComponent作为根组件
 	RootSceneComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootSceneComponent"));
 	SetRootComponent(RootSceneComponent);
@@ -80,4 +88,21 @@ const FString& ATAInteractiveActor::GetAgentName() const
 UTAInteractionComponent* ATAInteractiveActor::GetInteractionComponent() const
 {
 	return InteractionComponent;
-}
\ No newline at end of file
+}
+
+void ATAInteractiveActor::OnReleasedToPool()
+{
+	if (InteractionComponent)
+	{
+		InteractionComponent->InteractableInfo = FInteractableInfo();
+		InteractionComponent->BelongEventDescription.Empty();
+	}
+	if (ChatComponent)
+	{
+		ChatComponent->SetChatHistoryData(FTAChatComponentSaveData());
+	}
+	if (DialogueComponent)
+	{
+		DialogueComponent->ResetDialogueHistory();
+	}
+}
@@ -2,12 +2,13 @@
 
 #include "Scene/TAPlaceActor.h"
 #include "Components/SphereComponent.h"
+#include "Save/TAGuidSubsystem.h"
 
 // Sets default values
 ATAPlaceActor::ATAPlaceActor()
 {
-	// Set this actor to call Tick() every frame.
-	PrimaryActorTick.bCanEverTick = true;
+	// Places are static markers; nothing needs to run per frame
+	PrimaryActorTick.bCanEverTick = false;
 
 	// Initialize the sphere component to visualize the place's area
 	AreaDisplaySphere = CreateDefaultSubobject<USphereComponent>(TEXT("AreaDisplaySphere"));
@@ -27,12 +28,6 @@ void ATAPlaceActor::BeginPlay()
 	Super::BeginPlay();
 }
 
-// Called every frame
-void ATAPlaceActor::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-}
-
 void ATAPlaceActor::SetPlaceRadius(float Radius)
 {
 	PlaceRadius = Radius;
@@ -62,3 +57,14 @@ void ATAPlaceActor::SetPlaceTexture(UTexture2DDynamic* NewTexture)
 		OnTextureChanged.Broadcast(NewTexture);
 	}
 }
+
+void ATAPlaceActor::OnReleasedToPool()
+{
+	if (UTAGuidSubsystem* GuidSubsystem = GetWorld() ? GetWorld()->GetSubsystem<UTAGuidSubsystem>() : nullptr)
+	{
+		GuidSubsystem->UnregisterActorGUID(GetTAGuid());
+	}
+	SetTAGuid(FGuid());
+	SetPlaceName(FString());
+	SetPlaceTexture(nullptr);
+}
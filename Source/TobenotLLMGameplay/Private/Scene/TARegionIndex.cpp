@@ -0,0 +1,128 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Scene/TARegionIndex.h"
+
+FIntPoint FTARegionIndex::GetCell(const FVector2D& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void FTARegionIndex::ForEachCoveredCell(const FVector2D& Center, float Radius, TFunctionRef<void(const FIntPoint&)> Functor) const
+{
+	const FIntPoint MinCell = GetCell(Center - FVector2D(Radius));
+	const FIntPoint MaxCell = GetCell(Center + FVector2D(Radius));
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			Functor(FIntPoint(X, Y));
+		}
+	}
+}
+
+int32 FTARegionIndex::AddRegion(const FString& Name, const FVector2D& Center, float Radius, bool bFromLevel)
+{
+	const int32 RegionId = NextRegionId++;
+	FTARegion& Region = Regions.Add(RegionId);
+	Region.Name = Name;
+	Region.Center = Center;
+	Region.Radius = Radius;
+	Region.bFromLevel = bFromLevel;
+	ForEachCoveredCell(Center, Radius, [this, RegionId](const FIntPoint& Cell)
+	{
+		Cells.FindOrAdd(Cell).Add(RegionId);
+	});
+	return RegionId;
+}
+
+void FTARegionIndex::RemoveRegion(int32 RegionId)
+{
+	const FTARegion* Region = Regions.Find(RegionId);
+	if (!Region)
+	{
+		return;
+	}
+	ForEachCoveredCell(Region->Center, Region->Radius, [this, RegionId](const FIntPoint& Cell)
+	{
+		if (TArray<int32>* RegionIds = Cells.Find(Cell))
+		{
+			RegionIds->RemoveSingleSwap(RegionId);
+			if (RegionIds->Num() == 0)
+			{
+				Cells.Remove(Cell);
+			}
+		}
+	});
+	Regions.Remove(RegionId);
+}
+
+int32 FTARegionIndex::FindRegionAt(const FVector2D& Point) const
+{
+	const TArray<int32>* RegionIds = Cells.Find(GetCell(Point));
+	if (!RegionIds)
+	{
+		return INDEX_NONE;
+	}
+	int32 BestRegionId = INDEX_NONE;
+	float BestRadius = TNumericLimits<float>::Max();
+	for (const int32 RegionId : *RegionIds)
+	{
+		const FTARegion& Region = Regions.FindChecked(RegionId);
+		if (Region.Radius < BestRadius && FVector2D::DistSquared(Region.Center, Point) <= FMath::Square(Region.Radius))
+		{
+			BestRadius = Region.Radius;
+			BestRegionId = RegionId;
+		}
+	}
+	return BestRegionId;
+}
+
+bool FTARegionIndex::AddFact(int32 RegionId, const FString& Fact)
+{
+	FTARegion* Region = Regions.Find(RegionId);
+	if (!Region || Fact.IsEmpty())
+	{
+		return false;
+	}
+	if (Region->Facts.Num() >= MaxFactsPerRegion)
+	{
+		Region->Facts.RemoveAt(0);
+	}
+	Region->Facts.Add(Fact);
+	++Region->ContentVersion;
+	return true;
+}
+
+bool FTARegionIndex::SetDescription(int32 RegionId, uint32 ContentVersion, const FString& Description)
+{
+	FTARegion* Region = Regions.Find(RegionId);
+	if (!Region || Region->ContentVersion != ContentVersion)
+	{
+		return false;
+	}
+	Region->Description = Description;
+	Region->DescribedVersion = ContentVersion;
+	return true;
+}
+
+int32 FTARegionIndex::FindStaleRegion() const
+{
+	for (const TPair<int32, FTARegion>& Pair : Regions)
+	{
+		if (Pair.Value.IsDescriptionStale())
+		{
+			return Pair.Key;
+		}
+	}
+	return INDEX_NONE;
+}
+
+FString FTARegionIndex::ComposeDescription(const FTARegion& Region)
+{
+	if (Region.Facts.Num() == 0)
+	{
+		return Region.Name;
+	}
+	return FString::Printf(TEXT("%s: %s"), *Region.Name, *FString::Join(Region.Facts, TEXT("; ")));
+}
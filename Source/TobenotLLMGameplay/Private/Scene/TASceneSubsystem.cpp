@@ -3,63 +3,300 @@
 
 #include "Scene/TASceneSubsystem.h"
 
+#include "EngineUtils.h"
+#include "NavigationData.h"
 #include "NavigationSystem.h"
+#include "Async/Async.h"
+#include "GameFramework/PlayerStart.h"
+#include "Kismet/GameplayStatics.h"
 #include "Scene/TAPlaceActor.h"
 #include "Event/Data/TAEventInfo.h"
 #include "Scene/TASceneLogCategory.h"
 #include "TASettings.h"
 #include "Scene/TAAreaScene.h"
+#include "Scene/TAActorPoolSubsystem.h"
+#include "Common/TALLMLibrary.h"
+#include "Common/TAFrameBudgetSubsystem.h"
+#include "Event/Core/TAProximityTriggerSubsystem.h"
+#include "Save/TAGuidSubsystem.h"
+#include "Save/TANarrativeSnapshot.h"
 
 FString UTASceneSubsystem::QuerySceneMapInfo()
 {
-	return "The Mushroom Village on the grassland, where the mushroom monsters are hostile, mushroom villagers may be friendly.";
+	if (CachedSceneMapInfo.IsEmpty())
+	{
+		const UTASettings* Settings = GetDefault<UTASettings>();
+		CachedSceneMapInfo = Settings ? Settings->SceneMapDescription : FString();
+		TArray<FString> LevelPlaceNames;
+		RegionIndex.ForEachRegion([&LevelPlaceNames](int32 RegionId, const FTARegion& Region)
+		{
+			if (Region.bFromLevel && !Region.Name.IsEmpty())
+			{
+				LevelPlaceNames.Add(Region.Name);
+			}
+		});
+		if (LevelPlaceNames.Num() > 0)
+		{
+			CachedSceneMapInfo += FString::Printf(TEXT(" Places: %s."), *FString::Join(LevelPlaceNames, TEXT(", ")));
+		}
+	}
+	return CachedSceneMapInfo;
 }
 
 FString UTASceneSubsystem::QueryLocationInfo(const FVector& Location)
 {
-	return "High GrassLand";
+	const FTARegion* Region = RegionIndex.GetRegion(RegionIndex.FindRegionAt(FVector2D(Location)));
+	if (!Region)
+	{
+		const UTASettings* Settings = GetDefault<UTASettings>();
+		return Settings ? Settings->DefaultLocationDescription : FString();
+	}
+	if (Region->IsDescriptionStale())
+	{
+		ScheduleRegionDescriptions();
+	}
+	// 新描述还没生成好时先用旧的
+	return Region->Description.IsEmpty() ? FTARegionIndex::ComposeDescription(*Region) : Region->Description;
 }
 
-ATAPlaceActor* UTASceneSubsystem::CreateAndAddPlace(const FVector& Location, float Radius, const FString& Name)
+void UTASceneSubsystem::AddRegionFact(const FVector& Location, const FString& Fact)
 {
-	// 假设这个方法被正确的调用在允许创建Actor的上下文中
-	if (UWorld* World = GetWorld())
+	if (RegionIndex.AddFact(RegionIndex.FindRegionAt(FVector2D(Location)), Fact))
 	{
-		UClass* PlaceActorClass = nullptr;
-        
-		// 从配置文件中获取类路径
-		const UTASettings* Settings = GetDefault<UTASettings>();
-		if (Settings)
+		ScheduleRegionDescriptions();
+	}
+}
+
+void UTASceneSubsystem::ScheduleRegionDescriptions()
+{
+	UWorld* World = GetWorld();
+	if (!World || bIsDescribingRegion || World->GetTimerManager().IsTimerActive(RegionDescribeTimerHandle))
+	{
+		return;
+	}
+	// 交互物、事件往往是一批一批加进来的，等一会儿一起总结
+	World->GetTimerManager().SetTimer(RegionDescribeTimerHandle, this, &UTASceneSubsystem::DescribeStaleRegions, 2.f, false);
+}
+
+void UTASceneSubsystem::DescribeStaleRegions()
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	const bool bSummarize = Settings && Settings->bSummarizeRegionDescriptions;
+	
+	int32 RegionId = RegionIndex.FindStaleRegion();
+	while (RegionId != INDEX_NONE)
+	{
+		const FTARegion* Region = RegionIndex.GetRegion(RegionId);
+		if (bSummarize && Region->Facts.Num() > 0)
 		{
-			PlaceActorClass = Settings->PlaceActorClass.TryLoadClass<ATAPlaceActor>();
+			break;
 		}
+		// 没有内容或者不用大模型时，直接拼接，不发请求
+		RegionIndex.SetDescription(RegionId, Region->ContentVersion, FTARegionIndex::ComposeDescription(*Region));
+		RegionId = RegionIndex.FindStaleRegion();
+	}
+	if (RegionId == INDEX_NONE)
+	{
+		return;
+	}
+	
+	const FTARegion* Region = RegionIndex.GetRegion(RegionId);
+	const uint32 ContentVersion = Region->ContentVersion;
+	TArray<FChatLog> TempMessagesList;
+	TempMessagesList.Add({EOAChatRole::SYSTEM, UTALLMLibrary::PromptToStr(PromptSummarizeRegion)});
+	TempMessagesList.Add({EOAChatRole::USER, FTARegionIndex::ComposeDescription(*Region)});
+	FChatSettings ChatSettings{
+		UTALLMLibrary::GetChatEngineTypeFromQuality(ELLMChatEngineQuality::Fast),
+		TempMessagesList,
+		0
+	};
+	
+	bIsDescribingRegion = true;
+	TWeakObjectPtr<UTASceneSubsystem> WeakThis(this);
+	UTALLMLibrary::SendMessageToOpenAIWithRetry(ChatSettings, [WeakThis, RegionId, ContentVersion](const FChatCompletion& Message, const FString& ErrorMessage, bool Success)
+	{
+		UTASceneSubsystem* SceneSubsystem = WeakThis.Get();
+		if (!SceneSubsystem)
+		{
+			return;
+		}
+		SceneSubsystem->bIsDescribingRegion = false;
+		
+		// 失败时用拼接的描述顶上，等内容再变化时才重试；生成期间内容又变了的话这次结果会被丢掉
+		const FTARegion* Region = SceneSubsystem->RegionIndex.GetRegion(RegionId);
+		if (Region)
+		{
+			const FString Description = Success && !Message.message.content.IsEmpty()
+				? Message.message.content.TrimStartAndEnd()
+				: FTARegionIndex::ComposeDescription(*Region);
+			SceneSubsystem->RegionIndex.SetDescription(RegionId, ContentVersion, Description);
+		}
+		if (SceneSubsystem->RegionIndex.FindStaleRegion() != INDEX_NONE)
+		{
+			SceneSubsystem->ScheduleRegionDescriptions();
+		}
+	}, this);
+}
 
-		// 如果没有指定类或者类加载失败，使用默认的ATAPlaceActor类
-		if (!PlaceActorClass)
+void UTASceneSubsystem::RegisterLevelPlaces()
+{
+	for (TActorIterator<ATAPlaceActor> It(GetWorld()); It; ++It)
+	{
+		ATAPlaceActor* PlaceActor = *It;
+		if (PlaceRegionIds.Contains(PlaceActor) || PlaceActors.Contains(PlaceActor))
 		{
-			PlaceActorClass = ATAPlaceActor::StaticClass();
+			continue;
 		}
+		PlaceRegionIds.Add(PlaceActor, RegionIndex.AddRegion(PlaceActor->PlaceName, FVector2D(PlaceActor->GetActorLocation()), PlaceActor->PlaceRadius, true));
+		SiteAllocator.AddOccupied(PlaceActor->GetActorLocation(), PlaceActor->PlaceRadius);
+	}
+	CachedSceneMapInfo.Empty();
+}
 
-		// 使用加载的类生成Actor实例
-		ATAPlaceActor* NewPlaceActor = World->SpawnActor<ATAPlaceActor>(PlaceActorClass, Location, FRotator::ZeroRotator);
+ATAPlaceActor* UTASceneSubsystem::CreateAndAddPlace(const FVector& Location, float Radius, const FString& Name)
+{
+	ATAPlaceActor* NewPlaceActor = SpawnPlace(Location, Radius, Name);
+	if (NewPlaceActor)
+	{
+		ITAGuidInterface* GuidInterface = Cast<ITAGuidInterface>(NewPlaceActor);
+		if (GuidInterface)
+		{
+			// 读档时Guid由叙事快照恢复，见ReadPlacesSnapshot
+			const FString GuidNameStr = FString::Printf(TEXT("%s%d"),*Name, ++NumCreatedPlaces);
+			GuidInterface->RegisterActorTAGuid(NewPlaceActor, FName(*GuidNameStr));
+		}
+	}
+	return NewPlaceActor;
+}
+
+ATAPlaceActor* UTASceneSubsystem::SpawnPlace(const FVector& Location, float Radius, const FString& Name)
+{
+	// 假设这个方法被正确的调用在允许创建Actor的上下文中
+	if (UWorld* World = GetWorld())
+	{
+		// 位点类由Actor池在启动时解析，回收过的位点会被复用
+		UTAActorPoolSubsystem* ActorPool = World->GetSubsystem<UTAActorPoolSubsystem>();
+		ATAPlaceActor* NewPlaceActor = ActorPool
+			? ActorPool->AcquireActor<ATAPlaceActor>(ActorPool->GetPlaceActorClass(), FTransform(Location))
+			: World->SpawnActor<ATAPlaceActor>(ATAPlaceActor::StaticClass(), Location, FRotator::ZeroRotator);
 		if (NewPlaceActor)
 		{
 			NewPlaceActor->SetPlaceName(Name);
 			NewPlaceActor->SetPlaceRadius(Radius);
 			PlaceActors.Add(NewPlaceActor);
-			ITAGuidInterface* GuidInterface = Cast<ITAGuidInterface>(NewPlaceActor);
-			if (GuidInterface)
-			{
-				// todo: save recoverable name
-				const FString GuidNameStr = FString::Printf(TEXT("%s%d"),*Name, PlaceActors.Num());
-				GuidInterface->RegisterActorTAGuid(NewPlaceActor, FName(*GuidNameStr));
-			}
+			SiteAllocator.AddOccupied(Location, Radius);
+			PlaceRegionIds.Add(NewPlaceActor, RegionIndex.AddRegion(Name, FVector2D(Location), Radius, false));
 			return NewPlaceActor;
 		}
 	}
 	return nullptr;
 }
 
+void UTASceneSubsystem::WritePlacesSnapshot(FTASnapshotWriter& Writer) const
+{
+	TArray<ATAPlaceActor*> SavedPlaces;
+	for (ATAPlaceActor* PlaceActor : PlaceActors)
+	{
+		if (PlaceActor && PlaceActor->GetTAGuid().IsValid())
+		{
+			SavedPlaces.Add(PlaceActor);
+		}
+	}
+	Writer.WriteUInt(NumCreatedPlaces);
+	Writer.WriteUInt(SavedPlaces.Num());
+	for (ATAPlaceActor* PlaceActor : SavedPlaces)
+	{
+		const FVector Location = PlaceActor->GetActorLocation();
+		Writer.WriteGuid(PlaceActor->GetTAGuid());
+		Writer.WriteString(PlaceActor->PlaceName);
+		Writer.WriteFloat(Location.X);
+		Writer.WriteFloat(Location.Y);
+		Writer.WriteFloat(Location.Z);
+		Writer.WriteFloat(PlaceActor->PlaceRadius);
+	}
+}
+
+bool UTASceneSubsystem::ReadPlacesSnapshot(FTASnapshotReader& Reader, TArray<ATAPlaceActor*>& OutRestoredPlaces)
+{
+	struct FSavedPlace
+	{
+		FGuid Guid;
+		FString Name;
+		FVector Location;
+		float Radius;
+	};
+	
+	// 先完整读出来，读的过程中出错就什么都不创建
+	const int32 SavedNumCreatedPlaces = static_cast<int32>(Reader.ReadUInt());
+	const int32 NumPlaces = Reader.ReadCount();
+	TArray<FSavedPlace> SavedPlaces;
+	SavedPlaces.Reserve(NumPlaces);
+	for (int32 Index = 0; Index < NumPlaces && Reader.IsValid(); ++Index)
+	{
+		FSavedPlace& SavedPlace = SavedPlaces.AddDefaulted_GetRef();
+		SavedPlace.Guid = Reader.ReadGuid();
+		SavedPlace.Name = Reader.ReadString();
+		SavedPlace.Location.X = Reader.ReadFloat();
+		SavedPlace.Location.Y = Reader.ReadFloat();
+		SavedPlace.Location.Z = Reader.ReadFloat();
+		SavedPlace.Radius = Reader.ReadFloat();
+	}
+	if (!Reader.IsValid())
+	{
+		UE_LOG(LogTASceneSystem, Error, TEXT("ReadPlacesSnapshot 位点快照损坏"));
+		return false;
+	}
+	
+	NumCreatedPlaces = FMath::Max(NumCreatedPlaces, SavedNumCreatedPlaces);
+	UTAGuidSubsystem* GuidSubsystem = GetWorld() ? GetWorld()->GetSubsystem<UTAGuidSubsystem>() : nullptr;
+	for (const FSavedPlace& SavedPlace : SavedPlaces)
+	{
+		// 已经存在的位点不重复创建
+		if (!SavedPlace.Guid.IsValid() || (GuidSubsystem && GuidSubsystem->GetActorByGUID(SavedPlace.Guid)))
+		{
+			continue;
+		}
+		if (ATAPlaceActor* PlaceActor = SpawnPlace(SavedPlace.Location, SavedPlace.Radius, SavedPlace.Name))
+		{
+			PlaceActor->SetTAGuid(SavedPlace.Guid);
+			if (GuidSubsystem)
+			{
+				GuidSubsystem->RegisterActorGUID(SavedPlace.Guid, PlaceActor);
+			}
+			OutRestoredPlaces.Add(PlaceActor);
+		}
+	}
+	UE_LOG(LogTASceneSystem, Log, TEXT("从叙事快照恢复位点 %d/%d 个"), OutRestoredPlaces.Num(), NumPlaces);
+	return true;
+}
+
+void UTASceneSubsystem::RemovePlace(ATAPlaceActor* PlaceActor)
+{
+	if (!PlaceActor || PlaceActors.Remove(PlaceActor) == 0)
+	{
+		return;
+	}
+	// 放回池子之前先撤掉按这个位点缓存的接近触发，免得Actor复用到别处后还在旧位置触发
+	if (UTAProximityTriggerSubsystem* ProximitySubsystem = GetWorld()->GetSubsystem<UTAProximityTriggerSubsystem>())
+	{
+		ProximitySubsystem->ReleaseTriggersAtLocation(PlaceActor->GetTAGuid());
+	}
+	SiteAllocator.RemoveOccupied(PlaceActor->GetActorLocation(), PlaceActor->PlaceRadius);
+	int32 RegionId;
+	if (PlaceRegionIds.RemoveAndCopyValue(PlaceActor, RegionId))
+	{
+		RegionIndex.RemoveRegion(RegionId);
+	}
+	if (UTAActorPoolSubsystem* ActorPool = GetWorld()->GetSubsystem<UTAActorPoolSubsystem>())
+	{
+		ActorPool->ReleaseActor(PlaceActor);
+	}
+	else
+	{
+		PlaceActor->Destroy();
+	}
+}
+
 UTAAreaScene* UTASceneSubsystem::CreateAndLoadAreaScene(const FTAEventInfo& EventInfo)
 {
 	// 创建区域地图实例
@@ -108,9 +345,8 @@ void UTASceneSubsystem::PopulateMapWithMonsters(const TArray<FVector>& Forbidden
         return;
     }
 
-    int32 GeneratedMonsterCount = 0;
-
-	// 在地图上随机生成怪物
+	// 先收集所有格子的查询，合成一批异步查询，结果回来后再统一生成
+	TArray<FTANavPointQuery> Queries;
 	for (float X = MinX; X < MaxX; X += Interval)
 	{
 		for (float Y = MinY; Y < MaxY; Y += Interval)
@@ -131,101 +367,367 @@ void UTASceneSubsystem::PopulateMapWithMonsters(const TArray<FVector>& Forbidden
 
             if (!bIsForbiddenLocation)
             {
-                // 使用导航系统来确保点是可达的
-                FNavLocation NavLocation;
-                UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
-                if (NavSys && NavSys->GetRandomPointInNavigableRadius(RandomLocation, Interval, NavLocation, nullptr))
-                {
-                    // 在这个位置生成一个怪物
-                    AActor* NewMonster = GetWorld()->SpawnActor<AActor>(MonsterClass, NavLocation.Location, FRotator::ZeroRotator);
-                    if (NewMonster)
-                    {
-                        GeneratedMonsterCount++;
-                    }
-                }
+            	FTANavPointQuery& Query = Queries.AddDefaulted_GetRef();
+            	Query.Origin = RandomLocation;
+            	Query.Radius = Interval;
             }
         }
     }
 
-    UE_LOG(LogTASceneSystem, Log, TEXT("怪物生成完毕，生成数量：%d"), GeneratedMonsterCount);
+	QueryNavigablePointsAsync(MoveTemp(Queries), [this, MonsterClass](const TArray<TOptional<FVector>>& Results)
+	{
+		int32 GeneratedMonsterCount = 0;
+		for (const TOptional<FVector>& Result : Results)
+		{
+			if (!Result.IsSet())
+			{
+				continue;
+			}
+			// 在这个位置生成一个怪物
+			AActor* NewMonster = GetWorld()->SpawnActor<AActor>(MonsterClass, Result.GetValue(), FRotator::ZeroRotator);
+			if (NewMonster)
+			{
+				GeneratedMonsterCount++;
+			}
+		}
+		UE_LOG(LogTASceneSystem, Log, TEXT("怪物生成完毕，生成数量：%d"), GeneratedMonsterCount);
+	});
 }
 
-ATAPlaceActor* UTASceneSubsystem::QueryEventLocationByInfo(const FTAEventInfo& EventInfo)
+void UTASceneSubsystem::OnWorldBeginPlay(UWorld& InWorld)
 {
-    UE_LOG(LogTASceneSystem, Log, TEXT("开始查询事件位置信息..."));
-    // ... 这里可以引入基于EventInfo的更复杂的逻辑 ...
-    bool bIsValidLocation;
-    int32 RetryCount = 0;
+	Super::OnWorldBeginPlay(InWorld);
+	RegisterLevelPlaces();
+	StartSiteGeneration();
 
-    UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
-    FNavLocation NavLocation;
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	if (Settings && Settings->AreaSceneHibernateDistance > 0.f)
+	{
+		InWorld.GetTimerManager().SetTimer(AreaStreamingTimerHandle, this, &UTASceneSubsystem::UpdateAreaSceneStreaming,
+			FMath::Max(0.1f, Settings->AreaSceneStreamingInterval), true);
+	}
+}
 
-    do
-    {
-        bIsValidLocation = true;
-        constexpr float MinX = 2000.0f + 200.f;
-        float MaxX = 20000.0f- 200.f;
-        constexpr float MinY = 0.0f + 200.f;
-        constexpr float MaxY = 5000.0f - 200.f; 
-    	if (!bHasCreatedStartingEvent)
-    	{
-    		MaxX = 4000.0f; // 定义起始区域的X坐标
-    		bHasCreatedStartingEvent = true; // 更新标志位，表明起始事件已经创建
-    	}
-        FVector RandomPoint(FMath::FRandRange(MinX, MaxX), FMath::FRandRange(MinY, MaxY), 0);
-
-        constexpr float MinRadius = 1000.0f;
-        constexpr float MaxRadius = 1500.0f;
-        const float RandomRadius = FMath::RandRange(MinRadius, MaxRadius);
-
-        // 使用导航系统来确保点是可达的
-    	if (!NavSys || !NavSys->GetRandomPointInNavigableRadius(RandomPoint, RandomRadius, NavLocation, nullptr))
-    	{
-    		UE_LOG(LogTASceneSystem, Warning, TEXT("Failed to find a navigable point."));
-    		bIsValidLocation = false;
-    	}
-
-    	if(bIsValidLocation)
-    	{
-    		// 测试新生成的点与现有位点之间的距离
-    		for (ATAPlaceActor* PlaceActor : PlaceActors)
-    		{
-    			if (PlaceActor)
-    			{
-    				float Distance = (PlaceActor->GetActorLocation() - NavLocation.Location).Size();
-    				if (Distance < (PlaceActor->PlaceRadius + RandomRadius))
-    				{
-    					bIsValidLocation = false;
-    					break;
-    				}
-    			}
-    		}
-    	}
-
-        if (bIsValidLocation)
-        {
-            UE_LOG(LogTASceneSystem, Log, TEXT("位置有效，位置选取重试次数：%d，开始创建并添加新的位点到列表中..."), RetryCount);
-            // 创建并添加新的位点到列表中
-            ATAPlaceActor* NewPlaceActor = CreateAndAddPlace(NavLocation.Location, RandomRadius, EventInfo.PresetData.LocationName);
-            return NewPlaceActor;
-        }
-        else
-        {
-            // 如果位置不合适，增加重试计数
-            RetryCount++;
-            // 如果达到最大重试次数，退出循环
-            if (RetryCount >= MaxQueryEventLocationRetryCount)
-            {
-                UE_LOG(LogTASceneSystem, Error, TEXT("达到最大重试次数%d，查询失败，返回空指针。"), MaxQueryEventLocationRetryCount);
-                break;
-            }
-        }
+void UTASceneSubsystem::Deinitialize()
+{
+	if (UWorld* World = GetWorld())
+	{
+		World->GetTimerManager().ClearTimer(AreaStreamingTimerHandle);
+		World->GetTimerManager().ClearTimer(RegionDescribeTimerHandle);
+	}
+	Super::Deinitialize();
+}
 
-    } while (!bIsValidLocation);
+void UTASceneSubsystem::UpdateAreaSceneStreaming()
+{
+	const APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	if (!PlayerPawn || !Settings || Settings->AreaSceneHibernateDistance <= 0.f)
+	{
+		return;
+	}
+	const FVector PlayerLocation = PlayerPawn->GetActorLocation();
+	const float HibernateDistanceSquared = FMath::Square(Settings->AreaSceneHibernateDistance);
+	const float RehydrateDistanceSquared = FMath::Square(FMath::Min(Settings->AreaSceneRehydrateDistance, Settings->AreaSceneHibernateDistance));
+	
+	for (const TPair<int32, UTAAreaScene*>& Pair : AreaScenesMap)
+	{
+		UTAAreaScene* AreaScene = Pair.Value;
+		FVector SceneCenter;
+		if (!AreaScene || !AreaScene->GetSceneCenter(SceneCenter))
+		{
+			continue;
+		}
+		const float DistanceSquared = FVector::DistSquared2D(PlayerLocation, SceneCenter);
+		if (AreaScene->IsHibernating())
+		{
+			if (DistanceSquared < RehydrateDistanceSquared)
+			{
+				AreaScene->Rehydrate();
+			}
+		}
+		else if (DistanceSquared > HibernateDistanceSquared)
+		{
+			AreaScene->Hibernate();
+		}
+	}
+}
 
-    return nullptr;
+FBox2D UTASceneSubsystem::GetSiteBounds() const
+{
+	// 离边界留一点余量，和旧的写死范围一致
+	constexpr float Margin = 200.f;
+	if (const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		const FBox NavBounds = NavSys->GetNavigableWorldBounds();
+		if (NavBounds.IsValid)
+		{
+			const FBox2D Bounds(FVector2D(NavBounds.Min) + Margin, FVector2D(NavBounds.Max) - Margin);
+			if (Bounds.GetSize().X > 0.f && Bounds.GetSize().Y > 0.f)
+			{
+				return Bounds;
+			}
+		}
+	}
+	UE_LOG(LogTASceneSystem, Warning, TEXT("关卡没有导航范围，事件位点使用默认范围"));
+	return FBox2D(FVector2D(2000.f + Margin, 0.f + Margin), FVector2D(20000.f - Margin, 5000.f - Margin));
 }
 
+void UTASceneSubsystem::StartSiteGeneration()
+{
+	if (bIsGeneratingSites || SiteAllocator.IsReady())
+	{
+		return;
+	}
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	const float MaxRadius = Settings ? Settings->EventSiteMaxRadius : 1500.f;
+	// 候选点间距取两倍最大半径，候选点之间不会重叠
+	const float MinDistance = MaxRadius * 2.f;
+	SiteAllocator.SetCellSize(MinDistance);
+	const FBox2D Bounds = GetSiteBounds();
+	const int32 Seed = FMath::Rand();
+	bIsGeneratingSites = true;
+	
+	TWeakObjectPtr<UTASceneSubsystem> WeakThis(this);
+	Async(EAsyncExecution::ThreadPool, [WeakThis, Bounds, MinDistance, Seed]()
+	{
+		TArray<FVector2D> Points;
+		FTASiteAllocator::GeneratePoissonDisk(Bounds, MinDistance, Seed, Points);
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Points = MoveTemp(Points), Seed]() mutable
+		{
+			if (UTASceneSubsystem* SceneSubsystem = WeakThis.Get())
+			{
+				UE_LOG(LogTASceneSystem, Log, TEXT("事件候选位点生成完成：%d 个"), Points.Num());
+				SceneSubsystem->SiteAllocator.SetCandidates(MoveTemp(Points), Seed);
+				SceneSubsystem->bIsGeneratingSites = false;
+			}
+		});
+	});
+}
+
+const ANavigationData* UTASceneSubsystem::GetNavData() const
+{
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	return NavSys ? NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate) : nullptr;
+}
+
+TOptional<FVector> UTASceneSubsystem::RunNavPointQuery(const ANavigationData& NavData, const FTANavPointQuery& Query)
+{
+	FNavLocation NavLocation;
+	const bool bFound = Query.bProjectOnly
+		? NavData.ProjectPoint(Query.Origin, NavLocation, FVector(Query.Radius, Query.Radius, 100000.f))
+		: NavData.GetRandomPointInNavigableRadius(Query.Origin, Query.Radius, NavLocation);
+	return bFound ? TOptional<FVector>(NavLocation.Location) : TOptional<FVector>();
+}
+
+void UTASceneSubsystem::QueryNavigablePointsAsync(TArray<FTANavPointQuery>&& Queries, FTANavPointsCallback&& OnComplete)
+{
+	FNavPointRequest& Request = PendingNavRequests.AddDefaulted_GetRef();
+	Request.Queries = MoveTemp(Queries);
+	Request.Results.Reserve(Request.Queries.Num());
+	Request.OnComplete = MoveTemp(OnComplete);
+	
+	// 已经排上了就等下一步一起做，同一帧提交的查询会在同一批里
+	if (bIsNavQueryScheduled)
+	{
+		return;
+	}
+	bIsNavQueryScheduled = true;
+	
+	UTAFrameBudgetSubsystem* FrameBudget = GetWorld() ? GetWorld()->GetSubsystem<UTAFrameBudgetSubsystem>() : nullptr;
+	if (!FrameBudget)
+	{
+		// 没有分帧执行器时当场做完，回调里新提交的查询也在这个循环里处理
+		while (!ProcessNavRequests())
+		{
+		}
+		bIsNavQueryScheduled = false;
+		return;
+	}
+	FrameBudget->SubmitWork(this, TEXT("Scene.NavQuery"), [this]()
+	{
+		const bool bDone = ProcessNavRequests();
+		bIsNavQueryScheduled = !bDone;
+		return bDone;
+	});
+}
+
+bool UTASceneSubsystem::ProcessNavRequests()
+{
+	const ANavigationData* NavData = GetNavData();
+	if (NavData)
+	{
+		NavData->BeginBatchQuery();
+	}
+	
+	TArray<FNavPointRequest> CompletedRequests;
+	int32 QueryBudget = NavQueriesPerStep;
+	while (PendingNavRequests.Num() > 0 && QueryBudget > 0)
+	{
+		FNavPointRequest& Request = PendingNavRequests[0];
+		while (Request.Results.Num() < Request.Queries.Num() && QueryBudget > 0)
+		{
+			const FTANavPointQuery& Query = Request.Queries[Request.Results.Num()];
+			Request.Results.Add(NavData ? RunNavPointQuery(*NavData, Query) : TOptional<FVector>());
+			--QueryBudget;
+		}
+		if (Request.Results.Num() < Request.Queries.Num())
+		{
+			break;
+		}
+		CompletedRequests.Add(MoveTemp(Request));
+		PendingNavRequests.RemoveAt(0);
+	}
+	
+	if (NavData)
+	{
+		NavData->FinishBatchQuery();
+	}
+
+	// 批量查询结束后再回调，回调里可能会生成Actor或者提交新的查询
+	for (FNavPointRequest& Request : CompletedRequests)
+	{
+		if (Request.OnComplete)
+		{
+			Request.OnComplete(Request.Results);
+		}
+	}
+	return PendingNavRequests.Num() == 0;
+}
+
+void UTASceneSubsystem::BuildEventSiteQuery(FTANavPointQuery& OutQuery, float& OutRadius)
+{
+	const UTASettings* Settings = GetDefault<UTASettings>();
+	const float MinRadius = Settings ? Settings->EventSiteMinRadius : 1000.f;
+	const float MaxRadius = Settings ? FMath::Max(MinRadius, Settings->EventSiteMaxRadius) : 1500.f;
+	OutRadius = FMath::RandRange(MinRadius, MaxRadius);
+
+	// 第一个事件放在离玩家出生点最近的地方
+	FVector2D StartLocation;
+	const FVector2D* PreferredLocation = nullptr;
+	if (!bHasCreatedStartingEvent)
+	{
+		bHasCreatedStartingEvent = true;
+		TActorIterator<APlayerStart> PlayerStartIt(GetWorld());
+		if (PlayerStartIt)
+		{
+			StartLocation = FVector2D(PlayerStartIt->GetActorLocation());
+			PreferredLocation = &StartLocation;
+		}
+	}
+	
+	// 候选点本身互不重叠，只需要投影到导航网格上
+	FVector2D Candidate;
+	if (SiteAllocator.TakeCandidate(Candidate, PreferredLocation))
+	{
+		OutQuery.Origin = FVector(Candidate, 0.f);
+		OutQuery.Radius = MaxRadius * 0.5f;
+		OutQuery.bProjectOnly = true;
+		return;
+	}
+
+	// 候选点还没生成好或者已经用完，退回旧做法：在范围内随机一个点，再找它附近可达的点
+	if (!SiteAllocator.IsReady())
+	{
+		StartSiteGeneration();
+	}
+	const FBox2D Bounds = GetSiteBounds();
+	const FVector2D RandomPoint = PreferredLocation ? *PreferredLocation
+		: FVector2D(FMath::FRandRange(Bounds.Min.X, Bounds.Max.X), FMath::FRandRange(Bounds.Min.Y, Bounds.Max.Y));
+	OutQuery.Origin = FVector(RandomPoint, 0.f);
+	OutQuery.Radius = OutRadius;
+	OutQuery.bProjectOnly = false;
+}
+
+ATAPlaceActor* UTASceneSubsystem::TryCreateEventSite(const TOptional<FVector>& NavLocation, float Radius, const FTAEventInfo& EventInfo)
+{
+	// 测试新生成的点与现有位点是否重叠，只查网格里附近的格子
+	if (!NavLocation.IsSet() || SiteAllocator.IsOverlapping(NavLocation.GetValue(), Radius))
+	{
+		return nullptr;
+	}
+	return CreateAndAddPlace(NavLocation.GetValue(), Radius, EventInfo.PresetData.LocationName);
+}
+
+ATAPlaceActor* UTASceneSubsystem::QueryEventLocationByInfo(const FTAEventInfo& EventInfo)
+{
+	UE_LOG(LogTASceneSystem, Log, TEXT("开始查询事件位置信息..."));
+	const ANavigationData* NavData = GetNavData();
+	if (!NavData)
+	{
+		UE_LOG(LogTASceneSystem, Warning, TEXT("Failed to find a navigable point."));
+		return nullptr;
+	}
+	
+	for (int32 RetryCount = 0; RetryCount < MaxQueryEventLocationRetryCount; ++RetryCount)
+	{
+		FTANavPointQuery Query;
+		float Radius;
+		BuildEventSiteQuery(Query, Radius);
+		if (ATAPlaceActor* NewPlaceActor = TryCreateEventSite(RunNavPointQuery(*NavData, Query), Radius, EventInfo))
+		{
+			UE_LOG(LogTASceneSystem, Log, TEXT("位置有效，位置选取重试次数：%d"), RetryCount);
+			return NewPlaceActor;
+		}
+	}
+	UE_LOG(LogTASceneSystem, Error, TEXT("达到最大重试次数%d，查询失败，返回空指针。"), MaxQueryEventLocationRetryCount);
+	return nullptr;
+}
+
+void UTASceneSubsystem::QueryEventLocationsAsync(const TArray<FTAEventInfo>& EventInfos, FTAEventSitesCallback&& OnComplete)
+{
+	UE_LOG(LogTASceneSystem, Log, TEXT("开始批量查询事件位置信息，事件数：%d"), EventInfos.Num());
+	const TSharedRef<FEventSiteRequest> Request = MakeShared<FEventSiteRequest>();
+	Request->EventInfos = EventInfos;
+	Request->Places.Init(nullptr, EventInfos.Num());
+	Request->OnComplete = MoveTemp(OnComplete);
+	DispatchEventSiteQueries(Request);
+}
+
+void UTASceneSubsystem::DispatchEventSiteQueries(const TSharedRef<FEventSiteRequest>& Request)
+{
+	// 还没选到位点的事件各出一个查询，放在同一批里
+	TArray<FTANavPointQuery> Queries;
+	TArray<int32> EventIndices;
+	TArray<float> Radii;
+	for (int32 Index = 0; Index < Request->Places.Num(); ++Index)
+	{
+		if (Request->Places[Index])
+		{
+			continue;
+		}
+		FTANavPointQuery& Query = Queries.AddDefaulted_GetRef();
+		BuildEventSiteQuery(Query, Radii.AddDefaulted_GetRef());
+		EventIndices.Add(Index);
+	}
+	
+	QueryNavigablePointsAsync(MoveTemp(Queries), [this, Request, EventIndices = MoveTemp(EventIndices), Radii = MoveTemp(Radii)](const TArray<TOptional<FVector>>& Results)
+	{
+		// 按顺序创建，前面创建的位点已经登记到网格里，后面的会和它做重叠检查
+		bool bAllPlaced = true;
+		for (int32 ResultIndex = 0; ResultIndex < Results.Num(); ++ResultIndex)
+		{
+			const int32 EventIndex = EventIndices[ResultIndex];
+			Request->Places[EventIndex] = TryCreateEventSite(Results[ResultIndex], Radii[ResultIndex], Request->EventInfos[EventIndex]);
+			bAllPlaced &= Request->Places[EventIndex] != nullptr;
+		}
+		
+		++Request->RetryCount;
+		if (!bAllPlaced)
+		{
+			if (Request->RetryCount < MaxQueryEventLocationRetryCount)
+			{
+				DispatchEventSiteQueries(Request);
+				return;
+			}
+			UE_LOG(LogTASceneSystem, Error, TEXT("达到最大重试次数%d，部分事件没有找到位点。"), MaxQueryEventLocationRetryCount);
+		}
+		if (Request->OnComplete)
+		{
+			Request->OnComplete(Request->Places);
+		}
+	});
+}
 
 UClass* UTASceneSubsystem::GetMonsterClass() const
 {
@@ -269,4 +771,13 @@ ATAPlaceActor* UTASceneSubsystem::CreatePlaceActorAtLocation(const FVector& NewL
 		UE_LOG(LogTASceneSystem, Error, TEXT("无法获取世界上下文（UWorld*），位点Actor创建失败。"));
 	}
 	return nullptr;
-}
\ No newline at end of file
+}
+
+const FTAPrompt UTASceneSubsystem::PromptSummarizeRegion = FTAPrompt{
+	"In an adventure game, the USER message lists a place name followed by things that have happened or exist there. "
+	"Write a short description of this place (at most two sentences) that another game system can use as location context. "
+	"Keep the place name, mention the most notable current content, and do not invent facts that are not listed. "
+	"Write in English and output only the description."
+	,1
+	,false
+};
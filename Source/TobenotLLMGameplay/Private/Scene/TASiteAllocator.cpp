@@ -0,0 +1,179 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+
+#include "Scene/TASiteAllocator.h"
+
+void FTASiteAllocator::GeneratePoissonDisk(const FBox2D& Bounds, float MinDistance, int32 Seed, TArray<FVector2D>& OutPoints, int32 MaxAttemptsPerPoint)
+{
+	OutPoints.Reset();
+	if (!Bounds.bIsValid || MinDistance <= 0.f)
+	{
+		return;
+	}
+	const FVector2D Size = Bounds.GetSize();
+	if (Size.X <= 0.f || Size.Y <= 0.f)
+	{
+		return;
+	}
+
+	// 背景网格格子边长为 r/√2，每格最多一个点，邻近检查只看周围5x5格
+	const float GridCellSize = MinDistance / UE_SQRT_2;
+	const int32 GridWidth = FMath::Max(1, FMath::CeilToInt(Size.X / GridCellSize));
+	const int32 GridHeight = FMath::Max(1, FMath::CeilToInt(Size.Y / GridCellSize));
+	TArray<int32> Grid;
+	Grid.Init(INDEX_NONE, GridWidth * GridHeight);
+
+	FRandomStream RandomStream(Seed);
+	auto GridIndexOf = [&](const FVector2D& Point)
+	{
+		const int32 X = FMath::Clamp(FMath::FloorToInt((Point.X - Bounds.Min.X) / GridCellSize), 0, GridWidth - 1);
+		const int32 Y = FMath::Clamp(FMath::FloorToInt((Point.Y - Bounds.Min.Y) / GridCellSize), 0, GridHeight - 1);
+		return FIntPoint(X, Y);
+	};
+	auto AddPoint = [&](const FVector2D& Point, TArray<int32>& ActiveList)
+	{
+		const int32 PointIndex = OutPoints.Add(Point);
+		const FIntPoint Cell = GridIndexOf(Point);
+		Grid[Cell.Y * GridWidth + Cell.X] = PointIndex;
+		ActiveList.Add(PointIndex);
+	};
+
+	TArray<int32> ActiveList;
+	AddPoint(FVector2D(RandomStream.FRandRange(Bounds.Min.X, Bounds.Max.X), RandomStream.FRandRange(Bounds.Min.Y, Bounds.Max.Y)), ActiveList);
+	const float MinDistanceSquared = FMath::Square(MinDistance);
+
+	while (ActiveList.Num() > 0)
+	{
+		const int32 ActiveSlot = RandomStream.RandHelper(ActiveList.Num());
+		const FVector2D Origin = OutPoints[ActiveList[ActiveSlot]];
+		bool bFound = false;
+		for (int32 Attempt = 0; Attempt < MaxAttemptsPerPoint && !bFound; ++Attempt)
+		{
+			// 在 [r, 2r] 的圆环里取点
+			const float Angle = RandomStream.FRandRange(0.f, 2.f * PI);
+			const float Distance = RandomStream.FRandRange(MinDistance, 2.f * MinDistance);
+			const FVector2D Candidate = Origin + FVector2D(FMath::Cos(Angle), FMath::Sin(Angle)) * Distance;
+			if (!Bounds.IsInside(Candidate))
+			{
+				continue;
+			}
+			const FIntPoint Cell = GridIndexOf(Candidate);
+			bool bTooClose = false;
+			for (int32 Y = FMath::Max(0, Cell.Y - 2); Y <= FMath::Min(GridHeight - 1, Cell.Y + 2) && !bTooClose; ++Y)
+			{
+				for (int32 X = FMath::Max(0, Cell.X - 2); X <= FMath::Min(GridWidth - 1, Cell.X + 2); ++X)
+				{
+					const int32 NeighborIndex = Grid[Y * GridWidth + X];
+					if (NeighborIndex != INDEX_NONE && FVector2D::DistSquared(OutPoints[NeighborIndex], Candidate) < MinDistanceSquared)
+					{
+						bTooClose = true;
+						break;
+					}
+				}
+			}
+			if (!bTooClose)
+			{
+				AddPoint(Candidate, ActiveList);
+				bFound = true;
+			}
+		}
+		if (!bFound)
+		{
+			ActiveList.RemoveAtSwap(ActiveSlot);
+		}
+	}
+}
+
+void FTASiteAllocator::SetCandidates(TArray<FVector2D>&& InCandidates, int32 Seed)
+{
+	FreeCandidates = MoveTemp(InCandidates);
+	FRandomStream RandomStream(Seed);
+	for (int32 Index = FreeCandidates.Num() - 1; Index > 0; --Index)
+	{
+		FreeCandidates.Swap(Index, RandomStream.RandHelper(Index + 1));
+	}
+	bReady = true;
+}
+
+bool FTASiteAllocator::TakeCandidate(FVector2D& OutPoint, const FVector2D* PreferredLocation)
+{
+	if (FreeCandidates.Num() == 0)
+	{
+		return false;
+	}
+	int32 ChosenIndex = FreeCandidates.Num() - 1;
+	if (PreferredLocation)
+	{
+		float BestDistanceSquared = TNumericLimits<float>::Max();
+		for (int32 Index = 0; Index < FreeCandidates.Num(); ++Index)
+		{
+			const float DistanceSquared = FVector2D::DistSquared(FreeCandidates[Index], *PreferredLocation);
+			if (DistanceSquared < BestDistanceSquared)
+			{
+				BestDistanceSquared = DistanceSquared;
+				ChosenIndex = Index;
+			}
+		}
+	}
+	OutPoint = FreeCandidates[ChosenIndex];
+	FreeCandidates.RemoveAtSwap(ChosenIndex);
+	return true;
+}
+
+FIntPoint FTASiteAllocator::GetCell(const FVector2D& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void FTASiteAllocator::AddOccupied(const FVector& Center, float Radius)
+{
+	const FVector2D Center2D(Center);
+	OccupiedCells.FindOrAdd(GetCell(Center2D)).Add({Center2D, Radius});
+	MaxOccupiedRadius = FMath::Max(MaxOccupiedRadius, Radius);
+}
+
+void FTASiteAllocator::RemoveOccupied(const FVector& Center, float Radius)
+{
+	const FVector2D Center2D(Center);
+	const FIntPoint Cell = GetCell(Center2D);
+	if (TArray<FOccupiedSite>* Sites = OccupiedCells.Find(Cell))
+	{
+		const int32 Index = Sites->IndexOfByPredicate([&Center2D, Radius](const FOccupiedSite& Site)
+		{
+			return Site.Center.Equals(Center2D, 1.f) && FMath::IsNearlyEqual(Site.Radius, Radius);
+		});
+		if (Index != INDEX_NONE)
+		{
+			Sites->RemoveAtSwap(Index);
+		}
+		if (Sites->Num() == 0)
+		{
+			OccupiedCells.Remove(Cell);
+		}
+	}
+}
+
+bool FTASiteAllocator::IsOverlapping(const FVector& Center, float Radius) const
+{
+	// 两个位点相交的最远距离是两个半径之和，据此决定要查几圈格子
+	const FVector2D Center2D(Center);
+	const int32 Range = FMath::CeilToInt((Radius + MaxOccupiedRadius) / CellSize);
+	const FIntPoint Cell = GetCell(Center2D);
+	for (int32 X = Cell.X - Range; X <= Cell.X + Range; ++X)
+	{
+		for (int32 Y = Cell.Y - Range; Y <= Cell.Y + Range; ++Y)
+		{
+			if (const TArray<FOccupiedSite>* Sites = OccupiedCells.Find(FIntPoint(X, Y)))
+			{
+				for (const FOccupiedSite& Site : *Sites)
+				{
+					if (FVector2D::DistSquared(Site.Center, Center2D) < FMath::Square(Site.Radius + Radius))
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
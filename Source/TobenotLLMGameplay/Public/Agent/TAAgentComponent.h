@@ -14,13 +14,15 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
-	// Called every frame
-	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
-
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Agent")
 	bool bEnableScheduleShout;
+
+	// 开关定时喊话，打开时马上按重试间隔排一次
+	UFUNCTION(BlueprintCallable, Category="Agent")
+	void SetEnableScheduleShout(bool bEnable);
 	
 	// 函数用于调用Owner上的ShoutComponent的RequestToSpeak
 	UFUNCTION(BlueprintCallable, Category="Agent")
@@ -39,8 +41,11 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Agent")
 	float MaxTimeBetweenRetryShouts;
 private:
-	// 内部追踪下一次应该喊话的时间
-	float TimeToNextShout;
+	// 用定时器等下一次喊话，不需要每帧Tick
+	FTimerHandle ShoutTimerHandle;
+	void ScheduleShoutIn(float Seconds);
+	void OnShoutTimer();
+	
 	// 内部用于生成下一次喊话的时间间隔
 	void ScheduleNextShout();
 };
\ No newline at end of file
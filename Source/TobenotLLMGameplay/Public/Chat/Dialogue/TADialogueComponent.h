@@ -33,19 +33,26 @@ public:
 	void SetCurrentDialogue(UTADialogueInstance* NewDialogueInstance);
 	UFUNCTION(BlueprintCallable, Category = "TADialogueComponent")
 	UTADialogueInstance* GetCurrentDialogueInstance() const{return CurrentDialogueInstance;};
+	int32 GetDialogueCursor() const { return DialogueCursor; }
 	UFUNCTION(BlueprintCallable, Category = "TADialogueComponent")
 	void HandleReceivedMessage(const FChatCompletion& ReceivedMessage, AActor* Sender);
 
 	// Functions related to chat log history
+	// 对话记录由对话实例统一保存，这里按自己的游标和视角现拼
 	UFUNCTION(BlueprintCallable, Category = "TADialogueComponent")
-	TArray<FChatLog> GetDialogueHistory() const{return DialogueHistory;};
+	TArray<FChatLog> GetDialogueHistory() const;
 	UFUNCTION(BlueprintCallable, Category = "TADialogueComponent")
-	FString GetDialogueHistoryCompressedStr() const{return DialogueHistoryCompressedStr;};
+	FString GetDialogueHistoryCompressedStr() const;
 	UFUNCTION(BlueprintCallable, Category = "TADialogueComponent")
 	void SendMessageToDialogue(const FChatCompletion& Message);
 	UFUNCTION(BlueprintCallable, Category = "TADialogueComponent")
 	void RequestToSpeak();
 	void RefuseToSay();
+
+	// 按当前对话记录拼好发言请求发出去，回调只给结果不改对话状态，对话实例提前推测发言时也用这个
+	class UOpenAIChat* SendSpeakRequest(TFunction<void(const FChatCompletion& Message, bool Success)> Callback);
+	// 把拿到的回复交给对话，失败时当作拒绝发言
+	void CommitSpokenReply(const FChatCompletion& Message, bool Success);
 	
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "TADialogueComponent")
 	bool IsPlayer;
@@ -60,17 +67,24 @@ private:
 	UPROPERTY()
 	UTADialogueInstance* CurrentDialogueInstance;
 
-	// Chat log history within the component
-	UPROPERTY()
-	TArray<FChatLog> DialogueHistory;
+	// 加入当前对话时对话实例里已有的消息数，之前的消息不属于自己
+	int32 DialogueCursor = 0;
 
+	// 之前几段对话留下的记忆，离开对话或者从休眠恢复时写入，不随每条消息更新
 	UPROPERTY()
-	TArray<FChatLog> FullDialogueHistory;
+	TArray<FChatLog> PreviousDialogueHistory;
 	
 	FString DialogueHistoryCompressedStr;
-	
-	// Handles updating the chat history
-	void UpdateDialogueHistory(const FChatCompletion& NewChatLog);
+
+	// 带到下一段对话的记忆超过这个字数就再压一次，不然每换一段对话都会变长
+	static constexpr int32 CarriedMemoryCompressLength = 2000;
+	bool bIsCompressingCarriedMemory = false;
+	// 记忆被清空或者整体替换时加一，之前的压缩结果作废
+	int32 CarriedMemorySerial = 0;
+	void CompressCarriedMemoryIfNeeded();
+
+	// 离开当前对话前把它的摘要和自己看到的记录留下来
+	void ArchiveCurrentDialogue();
 	
 	// Notifies UI of dialogue history update
 	void NotifyUIOfDialogueHistoryUpdate(const FChatCompletion& ReceivedMessage, AActor* Sender);
@@ -104,13 +118,18 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Chat")
 	void RequestDialogueCompression();
 
+	// 清空对话记录和压缩摘要，离开当前对话，Actor回收复用时调用
+	void ResetDialogueHistory();
+
+	TArray<FChatLog> GetFullDialogueHistory() const;
+
+	// 区域休眠后重建时写回对话记录和压缩摘要
+	void RestoreDialogueHistory(const TArray<FChatLog>& History, const TArray<FChatLog>& FullHistory, const FString& CompressedStr);
+
+	// 对话实例里有任一参与者开着就会压缩，压缩结果所有参与者共用
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "TADialogueComponent")
 	bool bEnableCompressDialogue = true;
 	
-private:
-	bool bIsCompressingDialogue = false;
-	int32 LastCompressedIndex;
-	
 public:
 	static const FTAPrompt PromptCompressDialogueHistory;
 	
@@ -4,11 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
-#include "TimerManager.h"
+#include "OpenAIDefinitions.h"
 #include "TADialogueInstance.generated.h"
 
-struct FChatCompletion;
-struct FChatLog;
+class UTADialogueComponent;
+class UOpenAIChat;
 // 声明一个枚举，用于描述对话的状态
 UENUM(BlueprintType)
 enum class EDialogueState : uint8
@@ -19,6 +19,23 @@ enum class EDialogueState : uint8
     End UMETA(DisplayName = "End"),
 };
 
+// 对话历史里每一条消息的附加信息，和DialogueHistory一一对应
+USTRUCT()
+struct FTADialogueEntry
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TWeakObjectPtr<AActor> Sender;
+
+    // 其他人只看得到message字段，解析不出message字段时其他人看不到这条
+    UPROPERTY()
+    FChatLog SharedMessage;
+
+    UPROPERTY()
+    bool bHasSharedMessage = false;
+};
+
 /**
  * DialogueInstance represents an ongoing dialogue environment with multiple participants
  */
@@ -38,14 +55,22 @@ public:
     UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Dialogue Instance")
     TArray<AActor*> Participants;
 
-    // 对话的历史记录
+    // 对话的历史记录，所有参与者共用这一份，各自只记一个加入时的游标
     UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Dialogue Instance")
     TArray<FChatLog> DialogueHistory;
 
+    // [SummaryStartIndex, SummarizedCount)这段消息压缩成的摘要，游标不晚于SummaryStartIndex的参与者共用
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Dialogue Instance")
+    FString DialogueSummary;
+
     // 对话的状态
     UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Dialogue Instance")
     EDialogueState DialogueState;
 
+    // 流水线发言，默认取UTASettings::bPipelineDialogueTurns
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Dialogue Instance")
+    bool bEnablePipelinedTurns;
+
     // 添加参与者
     UFUNCTION(BlueprintCallable, Category = "Dialogue Instance")
     void AddParticipant(AActor* Participant);
@@ -65,6 +90,7 @@ public:
     UFUNCTION(BlueprintCallable, Category = "Dialogue Instance")
     void RefuseToSay(AActor* Sender);
     
+    // 轮到下一个参与者发言，由UTADialogueManager在对话被唤醒时调用
     UFUNCTION()
     void CycleParticipants();
     
@@ -76,13 +102,86 @@ public:
 
     UFUNCTION(BlueprintCallable, Category = "Dialogue Instance")
     FString GetParticipantsNamesStringFromAgents() const;
+
+    int32 GetNumMessages() const { return DialogueHistory.Num(); }
+
+    // 按参与者的视角拼出从游标开始的对话记录：自己说的是原文，别人说的只有message字段
+    // bIncludeSummarized为false时跳过已经压进摘要的部分，用来拼提示词
+    void BuildHistoryFor(const AActor* Participant, int32 Cursor, TArray<FChatLog>& OutHistory, bool bIncludeSummarized = false) const;
+
+    // 游标之前的内容不属于这个参与者，摘要从游标之前开始时不给，没有摘要时也返回空
+    FString GetSummaryFor(int32 Cursor) const;
+
+    // 把较早的消息压进共用摘要，同一时间只有一个压缩请求
+    UFUNCTION(BlueprintCallable, Category = "Dialogue Instance")
+    void RequestCompression();
+
+    int32 GetNumSpeculationsCommitted() const { return NumSpeculationsCommitted; }
+    int32 GetNumSpeculationsDiscarded() const { return NumSpeculationsDiscarded; }
     
 private:
     // 内部方法用于添加消息到历史记录和分发消息给参与者
     void AddMessageToHistory(const FChatLog& Message, AActor* Sender);
     void DistributeMessage(const FChatCompletion& Message, AActor* Sender);
-    	
-    FTimerHandle DialogueTimerHandle;
+
+    UPROPERTY()
+    TArray<FTADialogueEntry> DialogueEntries;
+
+    // 摘要开始的位置，取开始压缩时在场参与者里最早的游标，之后加入的参与者用不了这份摘要
+    int32 SummaryStartIndex = 0;
+    int32 SummarizedCount = 0;
+    bool bIsCompressing = false;
+
+    // 这个游标的参与者能不能用摘要代替前面的记录
+    bool CanUseSummary(int32 Cursor) const { return Cursor <= SummaryStartIndex; }
+
+    // 参与者加入时缓存好会话组件和说话优先级，按优先级排好的发言顺序
+    struct FParticipantEntry
+    {
+        TWeakObjectPtr<AActor> Actor;
+        TWeakObjectPtr<UTADialogueComponent> DialogueComponent;
+        int32 Priority = 0;
+        // 没有实现ITAAgentInterface的参与者只收消息，不参与轮流发言
+        bool bCanSpeak = false;
+    };
+    TArray<FParticipantEntry> Rotation;
+    void RebuildRotation();
+
+    // 能轮流发言的参与者排在Rotation前面，返回他们的数量
+    int32 GetNumSpeakers() const;
+
+    // 推测发言：上一条消息一到就替下一位发言者提前发请求，记下当时的对话记录条数
+    // 轮到它时条数没变才采用，否则丢弃。回调用Serial判断是不是已经被丢弃的请求
+    struct FSpeculativeTurn
+    {
+        TWeakObjectPtr<UTADialogueComponent> Speaker;
+        int32 PrefixCount = INDEX_NONE;
+        bool bInFlight = false;
+        bool bReady = false;
+        bool bSucceeded = false;
+        // 轮到它时回复还没到，到了直接采用
+        bool bCommitOnArrival = false;
+        FChatCompletion Reply;
+    };
+    FSpeculativeTurn SpeculativeTurn;
+    int32 SpeculationSerial = 0;
+    int32 NumSpeculationsCommitted = 0;
+    int32 NumSpeculationsDiscarded = 0;
+
+    UPROPERTY()
+    UOpenAIChat* SpeculativeChat = nullptr;
+
+    void StartSpeculativeTurn(const AActor* Sender);
+    void DiscardSpeculativeTurn();
+    // 轮到Speaker时能用上推测结果就返回true
+    bool TryUseSpeculativeTurn(UTADialogueComponent* Speaker);
+    void CommitSpeculativeTurn();
+    void OnSpeculativeReply(int32 Serial, const FChatCompletion& Message, bool Success);
+
+    // 状态变为Active后让调度器在Delay秒后唤醒
+    void WakeAfter(float Delay);
+    void CancelWake();
+    
     int32 CurrentParticipantIndex;
 protected:
     virtual void BeginDestroy() override;
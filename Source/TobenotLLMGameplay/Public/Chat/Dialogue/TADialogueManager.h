@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "TADialogueInstance.h"
+#include "Engine/TimerHandle.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "TADialogueManager.generated.h"
 
@@ -35,7 +36,29 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Dialogue Manager")
 	bool InviteToDialogue(AActor* InvitedActor, UTADialogueInstance* DialogueInstance);
 
+	virtual void Deinitialize() override;
+
+	// 对话状态变化时由对话实例调用，Delay秒后轮到下一个人发言，已经排上的会被新的时间覆盖
+	void ScheduleDialogueTurn(UTADialogueInstance* DialogueInstance, float Delay);
+	void CancelDialogueTurn(UTADialogueInstance* DialogueInstance);
+
+	int32 GetNumDialogueInstances() const { return DialogueInstances.Num(); }
+	void ForEachDialogueInstance(TFunctionRef<void(const UTADialogueInstance*)> Visitor) const;
+	int32 GetNumScheduledTurns() const { return ScheduledTurns.Num(); }
+
 private:
 	UPROPERTY()
 	TMap<FGuid, UTADialogueInstance*> DialogueInstances;
+
+	// 所有对话共用一个定时器，只在最早的唤醒时间点触发；没有要唤醒的对话时定时器不存在
+	struct FScheduledTurn
+	{
+		TWeakObjectPtr<UTADialogueInstance> DialogueInstance;
+		double WakeTime = 0.0;
+	};
+	TArray<FScheduledTurn> ScheduledTurns;
+	FTimerHandle SchedulerTimerHandle;
+
+	void RunDueTurns();
+	void ArmSchedulerTimer();
 };
\ No newline at end of file
@@ -134,7 +134,8 @@ public:
 public:
 	UFUNCTION(BlueprintCallable, Category = "Chat")
 	void RequestChoices();
-	TArray<FString> ParseChoicesFromResponse(const FString& Response);
+	// 纯数据解析，在工作线程调用
+	static TArray<FString> ParseChoicesFromResponse(const FString& Response);
 
 private:
 	FString LastMessageContent;
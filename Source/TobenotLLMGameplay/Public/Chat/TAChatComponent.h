@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "Containers/RingBuffer.h"
 #include "OpenAIDefinitions.h"
 #include "TAChatCallback.h"
 #include "TAChatComponent.generated.h"
@@ -31,8 +32,8 @@ struct FTAActorMessageQueue
 {
 	GENERATED_BODY()
 
-	UPROPERTY()
-	TArray<FString> MessageQueue;
+	// 先进先出，出队是O(1)
+	TRingBuffer<FString> MessageQueue;
 
 	UPROPERTY()
 	UTAChatCallback* CallbackObject;
@@ -61,6 +62,14 @@ public:
 	
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "LLM")
 	bool ChatMessageJsonFormat = true;
+
+	// 同时和多少个Actor对话，每个Actor同一时间只有一个请求，超出的排队。0表示不限制（默认）
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "LLM", meta = (ClampMin = "0"))
+	int32 MaxConcurrentActors = 0;
+
+	// 排队的多条消息在轮到时合并成一条用户消息发出去，玩家连续输入时只走一次请求
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "LLM")
+	bool bCoalesceQueuedMessages = false;
 	
 	// Called every frame
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
@@ -74,6 +83,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "TAChatComponent")
 	FString GetSystemPromptFromOwner() const;
 
+	// 还有在途的请求或排队的消息
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "TAChatComponent")
+	bool HasPendingRequests() const;
+
 	UFUNCTION(BlueprintCallable, Category = "TAChatComponent")
 	TArray<FChatLog>& GetChatHistoryWithActor(AActor* OtherActor);
 
@@ -95,8 +108,11 @@ private:
 	UFUNCTION()
 	void HandleFailedMessage();
 	
-	void ProcessMessage(AActor* OriActor, const FString& UserMessage, UTAChatCallback* CallbackObject, bool IsSystemMessage);
+	// 不接受消息时返回false，调用方负责通知回调对象
+	bool ProcessMessage(AActor* OriActor, const FString& UserMessage, UTAChatCallback* CallbackObject, bool IsSystemMessage);
+	void OnChatCompleted(AActor* OriActor, const FChatCompletion& Message, bool Success);
 	void CheckMessageQueue();
+	bool HasFreeSlot() const { return MaxConcurrentActors <= 0 || ActiveActors.Num() < MaxConcurrentActors; }
 	
 	UPROPERTY()
 	TMap<FGuid, FTAActorChatHistory> ActorChatHistoryMap;
@@ -104,8 +120,9 @@ private:
 	UPROPERTY()
 	TMap<AActor*, class UTAChatCallback*> CallbackMap; // 用于缓存 Callback 对象
 
+	// 每个Actor在途的请求，不同Actor的请求可以并行
 	UPROPERTY()
-	class UOpenAIChat* CacheChat;
+	TMap<AActor*, class UOpenAIChat*> ActiveChats;
 
 	UPROPERTY()
 	TSet<AActor*> ActiveActors;
@@ -0,0 +1,35 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TAAsyncParse.h
+// 大模型回复的后处理分两段：解析和校验放到任务图工作线程，修改世界的部分回到游戏线程
+//
+// 线程约定：
+// - Parse在工作线程执行，只能读它按值捕获的数据，产出纯数据结果（FString、FName、数值、只含这些的结构体和数组），不能碰任何UObject
+// - Apply在游戏线程执行，拿到结果后再生成Actor、广播委托、写UObject
+// - Owner在Apply之前被销毁时，Apply不会被调用，结果直接丢弃
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Async.h"
+
+namespace TAAsyncParse
+{
+	template <typename ResultType>
+	void ParseThenApply(const UObject* Owner, TUniqueFunction<ResultType()>&& Parse, TUniqueFunction<void(ResultType&)>&& Apply)
+	{
+		check(IsInGameThread());
+		TWeakObjectPtr<const UObject> WeakOwner(Owner);
+		AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [WeakOwner, Parse = MoveTemp(Parse), Apply = MoveTemp(Apply)]() mutable
+		{
+			TSharedRef<ResultType> Result = MakeShared<ResultType>(Parse());
+			AsyncTask(ENamedThreads::GameThread, [WeakOwner, Result, Apply = MoveTemp(Apply)]() mutable
+			{
+				if (WeakOwner.IsValid())
+				{
+					Apply(*Result);
+				}
+			});
+		});
+	}
+}
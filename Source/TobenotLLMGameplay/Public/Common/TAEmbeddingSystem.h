@@ -4,11 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "OpenAIDefinitions.h"
+#include "Common/TAEmbeddingVector.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "TAEmbeddingSystem.generated.h"
 
 const int32 MaxRetryCount = 3;
 class UOpenAIEmbedding;
+class UTABakedEmbeddingAsset;
 
 UENUM(BlueprintType)
 enum class ETagEmbeddingStatus : uint8
@@ -30,10 +32,13 @@ struct FTagEmbeddingData
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FName Tag;
 
-	// 词嵌向量
+	// 词嵌向量，缓存里不存这份，只在GetTagEmbeddingData返回的拷贝里解压填充
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	FHighDimensionalVector EmbeddingVector = FHighDimensionalVector();
 
+	// 归一化并按存储精度压缩后的向量，缓存里真正保存的数据。用共享指针是为了缓存扩容时外面拿着的引用依然有效
+	TSharedPtr<const FTAPackedEmbedding> PackedEmbedding;
+
 	// 标签的词嵌状态
 	UPROPERTY(EditAnywhere, BlueprintReadOnly)
 	ETagEmbeddingStatus Status = ETagEmbeddingStatus::NotEmbedded;
@@ -62,6 +67,26 @@ struct FEmbeddingArchive
 	}
 };
 
+// 压缩存储精度下的加载缓存，文件名带精度后缀。原始精度的FEmbeddingArchive总会另存一份，设置变了就从它重新打包
+struct FTAPackedEmbeddingArchive
+{
+	static constexpr int32 CurrentVersion = 1;
+	
+	int32 Version = CurrentVersion;
+	FName Tag;
+	FString ModelKey;
+	FTAPackedEmbedding PackedEmbedding;
+
+	friend FArchive& operator<<(FArchive& Ar, FTAPackedEmbeddingArchive& ArchiveData)
+	{
+		Ar << ArchiveData.Version;
+		Ar << ArchiveData.Tag;
+		Ar << ArchiveData.ModelKey;
+		Ar << ArchiveData.PackedEmbedding;
+		return Ar;
+	}
+};
+
 /**
  * 词嵌系统基类，继承自游戏实例子系统
  */
@@ -71,9 +96,25 @@ class UTAEmbeddingSystem : public UGameInstanceSubsystem
 	GENERATED_BODY()
 
 public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	
 	// 请求一个Tag的词嵌
 	// 调用它时，如果Tag还未嵌入完成，会返回false并开始嵌入过程
 	bool GetTagEmbedding(const FName& Tag, FHighDimensionalVector& OutEmbeddingVec);
+
+	// 同GetTagEmbedding，但直接返回压缩后的向量，未嵌入完成时返回空。相似度计算请用这个，免去解压
+	TSharedPtr<const FTAPackedEmbedding> GetPackedTagEmbedding(const FName& Tag);
+
+	ETAEmbeddingStorageMode GetStorageMode() const { return StorageMode; }
+
+	// 缓存里向量的实际维度，0表示完整维度
+	int32 GetDimensions() const { return Dimensions; }
+
+	// 当前使用的词嵌模型名，也是原始精度存档文件名的后缀
+	static const FString& GetEmbeddingModelName();
+
+	// 把离线烘焙的词嵌放进缓存，已在缓存中的标签跳过。返回新加入的数量
+	int32 RegisterBakedEmbeddings(const UTABakedEmbeddingAsset* BakedAsset);
 	
 	// 请求词嵌的接口
 	UOpenAIEmbedding* SendEmbeddingToOpenAIWithRetry(const FEmbeddingSettings& EmbeddingSettings, TFunction<void(const FEmbeddingResult& Message, const FString& ErrorMessage,  bool Success)> Callback, const UObject* LogObject, const int32 NewRetryCount = MaxRetryCount);
@@ -90,6 +131,18 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Embedding")
 	static float CalculateCosineSimilarity(const FHighDimensionalVector& VectorA, const FHighDimensionalVector& VectorB);
 
+	// 用同一批原始向量比较各存储精度在给定阈值下的召回率、误报和误差
+	static FString BuildQuantizationReport(const TArray<FHighDimensionalVector>& Vectors, float Threshold);
+
+	// 读取本地存档里的原始精度词嵌，生成精度报告，最多取MaxVectors个向量
+	static FString BuildQuantizationReportFromSavedEmbeddings(float Threshold, int32 MaxVectors);
+
+	// 在256/512/1024/3072维下分别计时两两相似度循环，并以完整维度为准统计阈值上的召回率
+	static FString BuildDimensionBenchmarkReport(const TArray<FHighDimensionalVector>& Vectors, float Threshold, int32 Iterations);
+
+	// 读取本地存档里的原始精度词嵌，最多取MaxVectors个
+	static TArray<FHighDimensionalVector> LoadSavedFullPrecisionEmbeddings(int32 MaxVectors);
+
 protected:
 
 	// 存储所有标签及其词嵌数据，使用FName作为键
@@ -98,7 +151,23 @@ protected:
 
 private:
 	bool bHasTagEmbedding = false;
+	ETAEmbeddingStorageMode StorageMode = ETAEmbeddingStorageMode::Float32;
+	int32 Dimensions = 0;
+
+	// 存档文件名里的模型标识，原始精度完整维度沿用旧文件名，降维和压缩存储会带上维度和精度后缀
+	FString GetModelKey() const;
+	bool UsesFullPrecisionArchive() const;
+	static FString GetSaveDirectory();
 	FString GetSaveFilePath(const FName& Tag, const FString& ModelName) const;
+	
+	// 压缩并放入缓存
+	TSharedPtr<const FTAPackedEmbedding> AddEmbeddedTag(const FName& Tag, const FHighDimensionalVector& EmbeddingVector);
+	
 	bool SaveEmbeddingToArchive(const FName& Tag, const FHighDimensionalVector& EmbeddingVector, const FString& ModelName);
-	bool LoadEmbeddingFromArchive(const FName& Tag, const FString& ModelName, FHighDimensionalVector& OutEmbeddingVector);
+	bool LoadEmbeddingFromArchive(const FName& Tag, const FString& ModelName, FHighDimensionalVector& OutEmbeddingVector) const;
+	bool SavePackedEmbeddingToArchive(const FName& Tag, const FTAPackedEmbedding& PackedEmbedding);
+	bool LoadPackedEmbeddingFromArchive(const FName& Tag, FTAPackedEmbedding& OutPackedEmbedding) const;
+
+	// 按当前存储精度从本地存档恢复一个Tag到缓存
+	bool RestoreTagFromArchive(const FName& Tag);
 };
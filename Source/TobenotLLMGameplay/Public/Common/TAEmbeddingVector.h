@@ -0,0 +1,65 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Float16.h"
+#include "TAEmbeddingVector.generated.h"
+
+struct FHighDimensionalVector;
+
+// 词嵌向量的存储精度
+UENUM(BlueprintType)
+enum class ETAEmbeddingStorageMode : uint8
+{
+	Float32 UMETA(DisplayName = "Float32（原始精度）"),
+	Float16 UMETA(DisplayName = "Float16（半精度）"),
+	Int8 UMETA(DisplayName = "Int8（逐向量缩放）"),
+};
+
+/**
+ * 压缩后的词嵌向量
+ * 入库时就已经归一化，所以两个向量的余弦相似度就是点积，直接在压缩数据上算，不用再解压
+ */
+struct TOBENOTLLMGAMEPLAY_API FTAPackedEmbedding
+{
+	ETAEmbeddingStorageMode Mode = ETAEmbeddingStorageMode::Float32;
+
+	// Int8模式下每个分量乘上它才是原值，其他模式恒为1
+	float Scale = 1.f;
+
+	// 按Mode只有一个数组有数据
+	TArray<float> Float32Data;
+	TArray<FFloat16> Float16Data;
+	TArray<int8> Int8Data;
+
+	int32 Num() const;
+
+	// 向量数据占用的字节数，用于统计内存
+	SIZE_T GetDataSize() const;
+
+	// 归一化并按指定精度压缩。MaxDimension大于0时先截断到前MaxDimension维再归一化（Matryoshka式降维）
+	static FTAPackedEmbedding Pack(const FHighDimensionalVector& Source, ETAEmbeddingStorageMode InMode, int32 MaxDimension = 0);
+
+	// 解压成归一化后的浮点向量，主要给蓝图和旧接口用
+	void Unpack(FHighDimensionalVector& OutVector) const;
+
+	float GetComponent(int32 Index) const;
+
+	// 两个归一化向量的点积，即余弦相似度。精度相同时走SIMD内核
+	static float DotProduct(const FTAPackedEmbedding& A, const FTAPackedEmbedding& B);
+
+	static const TCHAR* GetModeSuffix(ETAEmbeddingStorageMode InMode);
+
+	friend FArchive& operator<<(FArchive& Ar, FTAPackedEmbedding& Packed)
+	{
+		uint8 ModeByte = static_cast<uint8>(Packed.Mode);
+		Ar << ModeByte;
+		Packed.Mode = static_cast<ETAEmbeddingStorageMode>(ModeByte);
+		Ar << Packed.Scale;
+		Ar << Packed.Float32Data;
+		Ar << Packed.Float16Data;
+		Ar << Packed.Int8Data;
+		return Ar;
+	}
+};
@@ -0,0 +1,62 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TAFrameBudgetSubsystem.h
+// 插件内共享的分帧执行器：各系统提交可续做的工作，每帧只在预算内推进，超预算按系统统计
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TAFrameBudgetSubsystem.generated.h"
+
+UCLASS()
+class TOBENOTLLMGAMEPLAY_API UTAFrameBudgetSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// 提交一项工作。Step每次调用做一小段，返回true表示做完了；Owner被销毁时工作自动丢弃
+	void SubmitWork(const UObject* Owner, FName SystemName, TFunction<bool()> Step);
+
+	// 把Num次循环分摊到多帧，每次调用Body处理一个下标
+	void SubmitForEach(const UObject* Owner, FName SystemName, int32 Num, TFunction<void(int32)> Body);
+
+	int32 GetNumPendingWork() const { return WorkItems.Num(); }
+
+	FString GetReportString() const;
+	void ResetStats();
+
+private:
+	struct FWorkItem
+	{
+		TWeakObjectPtr<const UObject> Owner;
+		FName SystemName;
+		TFunction<bool()> Step;
+	};
+
+	struct FSystemStats
+	{
+		int32 Steps = 0;
+		int32 CompletedItems = 0;
+		double TotalMs = 0.0;
+		double MaxStepMs = 0.0;
+		// 单步就超过整帧预算的次数
+		int32 StepOverruns = 0;
+		// 这个系统的工作让当帧总耗时超过预算的次数
+		int32 FrameOverruns = 0;
+	};
+
+	// 轮转执行，每项一次只跑一步，保证各系统都有进展
+	TArray<FWorkItem> WorkItems;
+	int32 NextItemIndex = 0;
+	
+	TMap<FName, FSystemStats> Stats;
+	
+	// 每帧预算（毫秒），从UTASettings读取
+	double BudgetMs = 2.0;
+};
@@ -10,7 +10,8 @@
 class ITAAgentInterface;
 class UTAAreaScene;
 /**
- * 
+ * 事件结束后实例由事件池重置并复用给别的事件。
+ * 蓝图里存下来的实例引用在事件结束后可能已经指向别的事件，用IsBoundToEvent确认，或者按EventID重新取。
  */
 UCLASS()
 class TOBENOTLLMGAMEPLAY_API UTAEventInstance : public UObject
@@ -18,9 +19,21 @@ class TOBENOTLLMGAMEPLAY_API UTAEventInstance : public UObject
 	GENERATED_BODY()
 
 public:
-	// 绑定到此实例的事件信息
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Event")
-	FTAEventInfo EventInfo;
+	// 绑定事件池里的事件
+	void InitEventInstance(FTAEventHandle InEventHandle);
+
+	// 绑定到此实例的事件信息，读的是事件池里唯一的那一份
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Event")
+	const FTAEventInfo& GetEventInfo() const;
+
+	FTAEventHandle GetEventHandle() const { return EventHandle; }
+
+	// 实例当前是否还绑定着这个事件，事件结束回收后返回false
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Event")
+	bool IsBoundToEvent(int32 EventID) const;
+
+	// 事件结束后回收前调用，清空所有状态，之后可以再InitEventInstance复用
+	void ResetEventInstance();
 
 	// 用于打印信息的函数，以模拟事件的触发
 	UFUNCTION(BlueprintCallable, Category = "Event")
@@ -32,6 +45,8 @@ public:
 private:
 	bool bTriggered = false;
 
+	FTAEventHandle EventHandle;
+
 public:
 	// Assigning desires to NPC.
 	UFUNCTION(BlueprintCallable, Category = "Event")
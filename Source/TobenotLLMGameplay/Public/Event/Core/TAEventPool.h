@@ -9,6 +9,60 @@
 #include "TAEventInstance.h"
 #include "TAEventPool.generated.h"
 
+class FTASnapshotWriter;
+class FTASnapshotReader;
+
+// 事件状态
+enum class ETAEventState : uint8
+{
+	Pending,
+	Active,
+	Completed,
+};
+
+// 定时检查要用到的热数据，和AllEventInfo一一对应，紧凑存放，检查循环不用去碰整个FTAEventInfo
+struct FTAEventHotData
+{
+	FGuid LocationGuid;
+	// 在PendingEventHandles里的下标，不在里面时为INDEX_NONE，移除时O(1)
+	int32 PendingSlot = INDEX_NONE;
+	ETAEventState State = ETAEventState::Pending;
+	// 还没满足的前置事件数，由前置事件完成时推送更新
+	uint16 UnmetDependencyCount = 0;
+	uint8 bPlotConditionMet : 1;
+	uint8 bHasAgentConditions : 1;
+	// 已经在就绪队列里
+	uint8 bQueuedReady : 1;
+	// 已经在等剧情前置的列表里
+	uint8 bQueuedPlotCheck : 1;
+
+	FTAEventHotData()
+		: bPlotConditionMet(false)
+		, bHasAgentConditions(false)
+		, bQueuedReady(false)
+		, bQueuedPlotCheck(false)
+	{}
+};
+
+// 已结束事件的归档记录，事件实例回收后只留这些
+struct FTAArchivedEventRecord
+{
+	FTAEventHandle Handle;
+	int32 OutcomeID = 0;
+	// 世界时间（秒）
+	float FinishedTime = 0.f;
+};
+
+// 批量导入的事件，可以在工作线程里整理好，再一次性发布到事件池
+// 下标都是批次内的下标，发布时再加上事件池里已有的数量
+struct FTAEventCatalogBatch
+{
+	TArray<FTAEventInfo> EventInfos;
+	TArray<FTAEventHotData> HotData;
+	TMap<int32, TArray<int32>> DependentsByPrecedingEventID;
+	bool bPrepared = false;
+};
+
 UCLASS()
 class TOBENOTLLMGAMEPLAY_API UTAEventPool : public UObject
 {
@@ -16,9 +70,16 @@ class TOBENOTLLMGAMEPLAY_API UTAEventPool : public UObject
 
 	virtual void BeginDestroy() override;
 public:
+	// 返回的引用在下一次AddEvent前有效，长期持有请用EventID或句柄
 	UFUNCTION(BlueprintCallable, Category = "Event")
 	FTAEventInfo& AddEvent(FTAEventInfo EventInfo);
 
+	// 不碰任何UObject，可以在工作线程调用
+	static void PrepareEventBatch(FTAEventCatalogBatch& Batch);
+
+	// 游戏线程调用，一次性把整批事件并入事件池。批次内容会被移走
+	void PublishEventBatch(FTAEventCatalogBatch& Batch);
+
 	UFUNCTION(BlueprintCallable, Category = "Event")
 	FTAEventInfo& GetEventByID(int32 EventID, bool& bSuccess);
 
@@ -30,18 +91,82 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Event")
 	void AddCompletedEvent(int32 EventID, int32 OutcomeID);
 
+	// 实例会被池子复用，不要长期持有返回值，需要时按EventID重新取
 	UTAEventInstance* GetEventInstanceByID(int32 EventID);
+
+	int32 GetNumEvents() const { return AllEventInfo.Num(); }
+	int32 GetNumLiveInstances() const { return ActiveEvents.Num(); }
+	int32 GetNumPooledInstances() const { return InstancePool.Num(); }
+	const TArray<FTAArchivedEventRecord>& GetArchivedEvents() const { return ArchivedEvents; }
+
+	FTAEventHandle FindEventHandle(int32 EventID) const;
+
+	// 快照里事件按句柄顺序存，状态和依赖都只存ID和句柄
+	void WriteSnapshot(FTASnapshotWriter& Writer) const;
+	// 只能恢复到空的事件池，保证句柄和存档时一致。进行中的事件会重新触发
+	bool ReadSnapshot(FTASnapshotReader& Reader);
+	const FTAEventInfo& GetEventInfo(FTAEventHandle Handle) const { return AllEventInfo[Handle.Index]; }
+	
 private:
-	// 所有事件信息的集合，这里是唯一的最持久的保存事件信息的地方。由EventSubsystem管理。请用指针指它
+	// 所有事件信息的集合，这里是唯一的最持久的保存事件信息的地方。由EventSubsystem管理。其他地方请用EventID或句柄指它
 	UPROPERTY(VisibleAnywhere, Category = "Event")
 	TArray<FTAEventInfo> AllEventInfo;
+
+	// 和AllEventInfo下标一一对应
+	TArray<FTAEventHotData> EventHotData;
+
+	// EventID到AllEventInfo下标
+	TMap<int32, int32> EventIndexByID;
 	
-	// 活跃事件的集合
+	// 活跃事件的集合，按EventID索引
 	UPROPERTY(VisibleAnywhere, Category = "Event")
-	TArray<UTAEventInstance*> ActiveEvents;
+	TMap<int32, TObjectPtr<UTAEventInstance>> ActiveEvents;
+
+	// 待触发事件，只存句柄，顺序不重要，移除时和最后一个交换
+	TArray<FTAEventHandle> PendingEventHandles;
+	void AddPendingEvent(FTAEventHandle Handle);
+	void RemovePendingEvent(FTAEventHandle Handle);
 
+	// 前置事件都完成了、只差剧情前置的事件，定时检查只看这些。不再等待的在检查时顺手移掉
+	TArray<FTAEventHandle> PlotWaitingHandles;
+
+	// 移出待触发集合，创建事件实例并触发。已经激活或完成的事件直接忽略
+	void ActivateEvent(FTAEventHandle Handle);
+
+	// 空闲的事件实例，激活事件时优先从这里取
 	UPROPERTY()
-	TArray<FTAEventInfo> PendingEventInfos;
+	TArray<TObjectPtr<UTAEventInstance>> InstancePool;
+
+	// 事件池里最多留几个空闲实例，多的交给GC
+	static constexpr int32 MaxPooledInstances = 16;
+
+	// 最近结束的事件，只给调试报告看，最多留MaxArchivedEvents条
+	TArray<FTAArchivedEventRecord> ArchivedEvents;
+
+	static constexpr int32 MaxArchivedEvents = 256;
+
+	// 结束的事件实例移出ActiveEvents，写归档记录，实例重置后放回池子
+	void RetireEventInstance(int32 EventID, int32 OutcomeID);
+
+	// 前置事件ID到依赖它的事件
+	TMap<int32, TArray<FTAEventHandle>> DependentsByPrecedingEventID;
+
+	// 剧情前置和前置事件都满足、等待触发的事件
+	TArray<FTAEventHandle> ReadyEventHandles;
+
+	// 满足条件时放进就绪队列
+	void RefreshEventReadiness(FTAEventHandle Handle);
+	int32 CountUnmetDependencies(FTAEventHandle Handle);
+
+	// 检查就绪队列里的Agent条件并触发
+	void ProcessReadyEvents();
+
+	// 检查一批事件的剧情前置，满足的放进就绪队列
+	void CheckPlotConditions(TArrayView<const FTAEventHandle> Handles);
+
+	// 剧情前置检查在分帧执行器里分批做，没做完之前定时器不再重复提交
+	bool bIsCheckingPlotConditions = false;
+	static constexpr int32 PlotConditionCheckBatchSize = 16;
 	// 傻眼了吧孩子，这个结构体指针不能暴露给蓝图
 private:
 	bool bHasStartedProximityCheck = false;
@@ -52,6 +177,9 @@ private:
 	// 此函数用于开启周期性检查
 	void StartTriggerCheck();
 
+	// AddEvent和批量发布共用，下标对应的事件信息和热数据都已经放进数组
+	void RegisterEventAt(int32 Index);
+
 	UPROPERTY(VisibleAnywhere, Category = "Event")
 	TMap<int32, int32> CompletedEventsOutcomeMap;
 	
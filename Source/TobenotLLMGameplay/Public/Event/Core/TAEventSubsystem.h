@@ -9,11 +9,21 @@
 
 #include "CoreMinimal.h"
 #include "Subsystems/WorldSubsystem.h"
+#include "Event/Data/TAEventInfo.h"
 #include "TAEventSubsystem.generated.h"
 
-struct FTAPresetEventData;
-struct FTAEventInfo;
 class UTAEventPool;
+struct FTAEventCatalogBatch;
+class UTAEventGenerator;
+class ATAPlaceActor;
+
+// 预生成储备里的一个事件，记下生成时的场景信息，用来判断是否过期
+struct FTAReservedEvent
+{
+	FTAEventInfo EventInfo;
+	uint32 SceneInfoHash = 0;
+	double CreatedTime = 0.0;
+};
 
 UCLASS()
 class TOBENOTLLMGAMEPLAY_API UTAEventSubsystem : public UWorldSubsystem
@@ -26,13 +36,32 @@ public:
 	
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
 	virtual void Start(const int32& GenEventNum);
 
 	UFUNCTION(BlueprintCallable, Category = "Event")
 	bool HasAnyEventsInPool() const;
 
+	// 活跃/空闲/归档事件数和事件系统在GC里的大致占比，TA.Event.Stats打印的就是这个
+	FString GetEventStatsString();
+
+	// 事件池和剧情记录的叙事快照，存进UTASaveGame
+	void WriteNarrativeSnapshot(TArray<uint8>& OutBytes);
+	// 只能在还没有事件的时候恢复，成功后就不用再调用Start生成事件了
+	bool RestoreNarrativeSnapshot(const TArray<uint8>& Bytes);
+
+	// 批量发布预设事件，批次可以在工作线程里先整理好
+	void PublishEventCatalog(FTAEventCatalogBatch& Batch);
+
 	UFUNCTION(BlueprintCallable, Category = "Event")
 	void GenerateEventByDescriptionInLocation(const FString& Description, const FVector& InLocation);
+
+	// 开始在后台维持事件储备，世界开始时和Start时会自动调用
+	UFUNCTION(BlueprintCallable, Category = "Event")
+	void WarmUpEventReserve();
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Event")
+	int32 GetNumReservedEvents() const { return ReservedEvents.Num(); }
 	
 public:
 	UFUNCTION()
@@ -45,6 +74,9 @@ private:
 	UFUNCTION()
 	void HandleGeneratedEvents(TArray<FTAEventInfo>& GeneratedEvents);
 
+	// 位点选好后把事件放进事件池，位点为空时只记日志
+	void AddGeneratedEventAtPlace(FTAEventInfo& EventInfo, ATAPlaceActor* PlaceActor);
+
 	UFUNCTION()
 	void HandleGeneratedEventsByDescriptionInLocation(TArray<FTAEventInfo>& GeneratedEvents, const FVector& InLocation);
 
@@ -52,4 +84,34 @@ private:
 
 	UPROPERTY()
 	UTAEventPool* EventPoolRef;
+
+	// 记录上一次GC的耗时，用来估算事件系统的GC开销
+	FDelegateHandle PreGarbageCollectHandle;
+	FDelegateHandle PostGarbageCollectHandle;
+	double GarbageCollectStartTime = 0.0;
+	double LastGarbageCollectSeconds = 0.0;
+
+	// 按UTASettings创建事件生成器，未配置时返回空
+	UTAEventGenerator* CreateEventGenerator();
+
+	// 预生成储备：后台低频补货，Start时直接从这里取，不用等大模型
+	TArray<FTAReservedEvent> ReservedEvents;
+	FTimerHandle ReserveRefillTimerHandle;
+	// 补货请求的发起时间，生成整个结束时清掉，用来防止同时有两个补货请求和判断请求是否已经丢了
+	double ReserveRefillStartTime = -1.0;
+	uint32 ReserveRefillSceneInfoHash = 0;
+
+	void RefillEventReserve();
+
+	UFUNCTION()
+	void HandleReserveGeneratedEvents(TArray<FTAEventInfo>& GeneratedEvents);
+
+	UFUNCTION()
+	void HandleReserveGenerationFinished();
+
+	// 丢掉场景信息已变化或放太久的储备
+	void PruneStaleReservedEvents(uint32 CurrentSceneInfoHash);
+	
+	// 从储备里取最多Num个事件，返回取到的数量
+	int32 DrawReservedEvents(int32 Num, TArray<FTAEventInfo>& OutEvents);
 };
\ No newline at end of file
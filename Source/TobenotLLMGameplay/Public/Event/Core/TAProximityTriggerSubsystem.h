@@ -0,0 +1,61 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TAProximityTriggerSubsystem.h
+// 靠近位点触发的事件的空间索引，按位点中心和半径放进均匀网格，每个玩家每次只查自己所在的格子
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Event/Data/TAEventInfo.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TAProximityTriggerSubsystem.generated.h"
+
+UCLASS()
+class TOBENOTLLMGAMEPLAY_API UTAProximityTriggerSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// 登记一个靠近位点触发的事件。位点Actor暂时找不到时会在之后的查询里重试
+	void RegisterTrigger(FTAEventHandle EventHandle, const FGuid& LocationGuid);
+
+	void UnregisterTrigger(FTAEventHandle EventHandle);
+
+	// 位点被移除（放回Actor池）时调用，丢掉按它缓存的中心和半径，这些事件退回未解析状态
+	// 同一个Guid的位点之后再出现（比如读档）还能重新解析
+	void ReleaseTriggersAtLocation(const FGuid& LocationGuid);
+
+	// 对所有玩家控制器的Pawn做一次查询，返回进入范围的事件并把它们移出索引
+	void QueryPlayers(TArray<FTAEventHandle>& OutTriggeredEvents);
+
+	int32 GetNumTriggers() const { return Triggers.Num(); }
+
+private:
+	struct FTrigger
+	{
+		FTAEventHandle EventHandle;
+		FGuid LocationGuid;
+		FVector Center = FVector::ZeroVector;
+		float Radius = 0.f;
+		FIntPoint MinCell = FIntPoint::ZeroValue;
+		FIntPoint MaxCell = FIntPoint::ZeroValue;
+	};
+
+	// 网格格子边长，从UTASettings读取
+	float CellSize = 2000.f;
+
+	TSparseArray<FTrigger> Triggers;
+	TMap<FTAEventHandle, int32> TriggerIndexByHandle;
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	// 位点Actor还没生成或还没注册GUID的事件
+	TMap<FTAEventHandle, FGuid> UnresolvedTriggers;
+
+	FIntPoint GetCell(const FVector& Location) const;
+	bool TryAddResolvedTrigger(FTAEventHandle EventHandle, const FGuid& LocationGuid);
+	void RemoveTriggerAt(int32 TriggerIndex);
+	void ResolvePendingTriggers();
+};
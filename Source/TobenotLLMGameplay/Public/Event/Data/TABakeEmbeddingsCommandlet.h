@@ -0,0 +1,31 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TABakeEmbeddingsCommandlet.h
+// 离线烘焙预设事件表的前置剧情标签词嵌
+// 用法：UnrealEditor-Cmd.exe <项目>.uproject -run=TABakeEmbeddings [-Tables=/Game/A,/Game/B] [-Concurrency=4] [-Timeout=600] [-Force]
+// 不指定 -Tables 时遍历项目里所有行结构为 FTAPresetEventData 的数据表
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TABakeEmbeddingsCommandlet.generated.h"
+
+class UDataTable;
+
+UCLASS()
+class TOBENOTLLMGAMEPLAY_API UTABakeEmbeddingsCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTABakeEmbeddingsCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	TArray<UDataTable*> FindPresetEventTables(const FString& TablesParam) const;
+
+	// 并发请求词嵌，手动驱动Http和Ticker直到全部完成或超时
+	bool EmbedTags(const TArray<FName>& Tags, int32 Concurrency, double TimeoutSeconds, TMap<FName, TArray<float>>& OutEmbeddings) const;
+};
@@ -0,0 +1,50 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TABakedEmbeddingAsset.h
+// 预设事件表里前置剧情标签的离线词嵌结果，由 TABakeEmbeddings 命令行工具生成
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "TABakedEmbeddingAsset.generated.h"
+
+class UDataTable;
+
+USTRUCT()
+struct FTABakedTagEmbedding
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, Category = "Embedding")
+	FName Tag;
+
+	// 模型的完整原始输出，运行时再按当前的维度和存储精度压缩
+	UPROPERTY()
+	TArray<float> Components;
+};
+
+/**
+ * 与事件数据表放在同一目录下，命名为 <表名>_Embeddings
+ * UTAEventWarehouse::LoadEventsFromDataTable 加载表时会一起加载它，预设前置标签就不用在运行时等网络了
+ * 注意：没有别的资源引用它，打包时需要把所在目录加到 DirectoriesToAlwaysCook 里
+ */
+UCLASS()
+class TOBENOTLLMGAMEPLAY_API UTABakedEmbeddingAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// 生成时使用的词嵌模型，和运行时模型不一致时不会被使用
+	UPROPERTY(VisibleAnywhere, Category = "Embedding")
+	FString ModelName;
+
+	UPROPERTY(VisibleAnywhere, Category = "Embedding")
+	TArray<FTABakedTagEmbedding> Embeddings;
+
+	// 数据表对应的词嵌资源包名
+	static FString GetPackageNameForTable(const UDataTable* DataTable);
+
+	// 数据表对应的词嵌资源存在时加载它，不存在返回空
+	static UTABakedEmbeddingAsset* LoadForTable(const UDataTable* DataTable);
+};
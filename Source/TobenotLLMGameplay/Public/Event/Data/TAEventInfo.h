@@ -159,4 +159,18 @@ struct FTAEventInfo
     
 	// 事件转换为字符串的函数，用于调试打印输出
 	FString ToString() const;
-};
\ No newline at end of file
+};
+// 事件在事件池里的句柄，对应事件池里唯一那份FTAEventInfo。事件只增不删，句柄一直有效
+struct FTAEventHandle
+{
+	int32 Index = INDEX_NONE;
+
+	FTAEventHandle() {}
+	explicit FTAEventHandle(int32 InIndex) : Index(InIndex) {}
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+
+	bool operator==(const FTAEventHandle& Other) const { return Index == Other.Index; }
+
+	friend uint32 GetTypeHash(const FTAEventHandle& Handle) { return GetTypeHash(Handle.Index); }
+};
@@ -9,6 +9,11 @@
 #include "TAEventInfo.h"
 #include "TAEventWarehouse.generated.h"
 
+struct FTAEventCatalogBatch;
+
+// 异步导入完成，Num是发布到事件池的事件数
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FTAEventCatalogImportedDelegate, UDataTable*, DataTable, int32, Num);
+
 UCLASS()
 class TOBENOTLLMGAMEPLAY_API UTAEventWarehouse : public UWorldSubsystem
 {
@@ -22,4 +27,25 @@ public:
 	// 声明一个函数，用于加载数据表并添加事件到事件池
 	UFUNCTION(BlueprintCallable, Category = "Event")
 	void LoadEventsFromDataTable(UDataTable* DataTable);
+
+	// 在工作线程里复制行数据、建好依赖索引，完成后回到游戏线程一次性发布到事件池
+	// 发布前事件池里看不到这张表的任何事件
+	UFUNCTION(BlueprintCallable, Category = "Event")
+	void LoadEventsFromDataTableAsync(UDataTable* DataTable);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Event")
+	bool IsImportingEvents() const { return NumImportsInFlight > 0; }
+
+	UPROPERTY(BlueprintAssignable, Category = "Event")
+	FTAEventCatalogImportedDelegate OnEventCatalogImported;
+
+private:
+	int32 NumImportsInFlight = 0;
+
+	void RegisterBakedEmbeddings(UDataTable* DataTable);
+	
+	// 只读数据表，可以在工作线程调用
+	static void BuildEventCatalogBatch(const UDataTable* DataTable, FTAEventCatalogBatch& OutBatch);
+	
+	int32 PublishEventCatalogBatch(FTAEventCatalogBatch& Batch);
 };
\ No newline at end of file
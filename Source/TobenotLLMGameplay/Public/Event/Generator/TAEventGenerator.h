@@ -4,10 +4,10 @@
 
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
+#include "OpenAIDefinitions.h"
 #include "Common/TAPromptDefinitions.h"
 #include "TAEventGenerator.generated.h"
 
-struct FChatCompletion;
 class UTAChatCallback;
 struct FTAEventInfo;
 
@@ -16,6 +16,8 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FTAEventGenerationSuccessDelegate, T
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FTAEventGenerationSuccessInLocationDelegate, TArray<FTAEventInfo>&, GeneratedEvents, const FVector&, InLocation);
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FTAEventGenerationFinishedDelegate);
+
 UCLASS()
 class TOBENOTLLMGAMEPLAY_API UTAEventGenerator : public UObject
 {
@@ -31,6 +33,10 @@ public:
 	UPROPERTY(BlueprintAssignable)
 	FTAEventGenerationSuccessInLocationDelegate OnEventGenerationSuccessInLocation;
 
+	// 一次生成请求整个结束时广播，成功失败都会有。拆分请求时在所有子请求都结束后才广播
+	UPROPERTY(BlueprintAssignable)
+	FTAEventGenerationFinishedDelegate OnEventGenerationFinished;
+
 	// 使用地理人文信息生成事件
 	UFUNCTION(BlueprintCallable, Category = "Event|Generation")
 	void RequestEventGeneration(const FString& SceneInfo, const int32& Num);
@@ -52,10 +58,22 @@ protected:
 	void OnChatFailure();
 	
 private:
-	// 解析大模型返回的JSON字符串并转换为事件数组
-	TArray<FTAEventInfo> ParseEventsFromJson(const FString& JsonString);
+	// 解析大模型返回的JSON字符串并转换为事件数组，纯数据，在工作线程调用
+	static TArray<FTAEventInfo> ParseEventsFromJson(const FString& JsonString);
 	
-	void ProcessEventObject(const TSharedPtr<FJsonObject>& EventObject, TArray<FTAEventInfo>& ParsedEvents);
+	static void ProcessEventObject(const TSharedPtr<FJsonObject>& EventObject, TArray<FTAEventInfo>& ParsedEvents);
+
+	FChatSettings MakeEventGenerationSettings(const FString& SceneInfo, int32 Num, const FString& AvoidHint) const;
+
+	// 拆分请求：每个子请求独立解析，结果去重后立刻广播，不等其他子请求
+	void StartFanOut(const FString& SceneInfo, int32 Num, int32 MaxEventsPerRequest);
+	void DispatchFanOutRequests();
+	void HandleFanOutResponse(int32 Serial, const FChatCompletion& Message, bool Success);
+	// 子请求的结果解析完回到游戏线程后调用，解析期间子请求仍算在途
+	void FinishFanOutResponse(int32 Serial, TArray<FTAEventInfo>& ParsedEvents);
+	
+	// 按地点和描述去重，返回的是本次新出现的事件
+	TArray<FTAEventInfo> FilterDuplicateEvents(TArray<FTAEventInfo>& Events);
 	
 	UPROPERTY()
 	UTAChatCallback* CacheCallbackObject;
@@ -65,4 +83,19 @@ private:
 
 	bool IsInLocation = false;
 	FVector GenerateInLocation;
+
+	// 在途的子请求，按序号记录。发请求前先占位，回调即使同步触发也能正确移除
+	UPROPERTY()
+	TMap<int32, UOpenAIChat*> FanOutChats;
+	int32 FanOutSerial = 0;
+	
+	FString FanOutSceneInfo;
+	TArray<int32> PendingChunkSizes;
+	int32 FanOutRequestedNum = 0;
+	int32 FanOutDeliveredNum = 0;
+	int32 MaxConcurrentRequests = 1;
+	// 全部子请求结束后数量不够时补一次，只补一次
+	bool bFanOutToppedUp = false;
+	TSet<FString> GeneratedEventKeys;
+	TArray<FString> GeneratedEventSummaries;
 };
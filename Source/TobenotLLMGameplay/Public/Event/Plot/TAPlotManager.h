@@ -4,14 +4,19 @@
 
 #include "CoreMinimal.h"
 #include "Common/TAPromptDefinitions.h"
+#include "Event/Plot/TASimilarityCache.h"
 
 #include "Subsystems/WorldSubsystem.h"
 #include "TAPlotManager.generated.h"
 
 struct FTAEventInfo;
 struct FHighDimensionalVector;
+struct FTAPackedEmbedding;
 struct FChatLog;
 struct FChatCompletion;
+class FJsonObject;
+class FTASnapshotWriter;
+class FTASnapshotReader;
 /**
  * Structure to represent a group of FName tags.
  */
@@ -35,6 +40,15 @@ struct FTATagGroup
     FTATagGroup() {}
 };
 
+// 拆标签回复的解析结果，纯数据，在工作线程产出、游戏线程消费
+struct FTAParsedTagRecords
+{
+    TArray<FTATagGroup> TagGroups;
+    int32 RecordNum = 0;
+    int32 TagGroupNum = 0;
+    bool bValid = false;
+};
+
 /**
  * UTAPlotManager
  *
@@ -71,7 +85,14 @@ public:
 
     // TAPlotManager提供发起检测的接口，让别的系统定时调用。
     // Checks for event prerequisites and triggers them if satisfied
-    void CheckEventsTagGroupCondition(TArray<FTAEventInfo>& Events);
+    void CheckEventsTagGroupCondition(const TArray<FTAEventInfo*>& Events);
+
+    // 剧情记录和压缩过的上下文写进叙事快照，标签走快照的名字表
+    void WriteSnapshot(FTASnapshotWriter& Writer) const;
+    bool ReadSnapshot(FTASnapshotReader& Reader);
+
+    static void WriteTagGroup(FTASnapshotWriter& Writer, const FTATagGroup& TagGroup);
+    static void ReadTagGroup(FTASnapshotReader& Reader, FTATagGroup& OutTagGroup);
 
 protected:
     UPROPERTY()
@@ -85,8 +106,25 @@ protected:
         每一个记录本身应当只表达一件事。
         所有的标签组PlotTag组成事件记录（Plot记录）。
         */
+    // 现在一次处理PendingTagLines里攒下的所有新消息，一个回复里可以有多条主动/被动记录
+    UFUNCTION()
     void ParseNewEventToTagGroups();
 
+    // 防抖：新消息到来后重新计时，安静一段时间或攒够一批再拆标签
+    void ScheduleTagging();
+
+    // 本地的廉价判断，太短或者是配置里的寒暄语就算闲聊，不发去拆标签
+    bool IsPlotChatter(const FString& Content) const;
+
+    // 解析整条拆标签回复，不碰UObject，在工作线程调用
+    static FTAParsedTagRecords ParseTagRecords(const FString& Content);
+
+    // 拆标签请求（包括回复的解析）结束，有攒下的新消息就接着排
+    void OnTaggingRequestFinished();
+
+    // 解析proactive_action/passive_action其中一个对象
+    static bool ParseActionToTagGroup(const TSharedPtr<FJsonObject>& ActionObject, FTATagGroup& OutTagGroup);
+
     //在标签组记录录入的时候，调用嵌入模型对所有的标签进行词嵌（缓存单个标签的词嵌结果，这样子大量的重复记录不会重复进行词嵌）
     // 获取tag的嵌入，调用它时，如果Tag还未嵌入完成，会返回false并开始嵌入过程，此时请跳过处理。
     bool GetTagEmbeddingsFromSystem(const FName& Tag, FHighDimensionalVector& OutEmbeddingVec);
@@ -102,6 +140,19 @@ private:
     TArray<FChatLog> FullShoutHistory;
 	
     FString ShoutHistoryCompressedStr;
+
+    // 还没拆标签的新消息
+    UPROPERTY()
+    TArray<FChatLog> PendingTagLines;
+
+    FTimerHandle TagDebounceTimerHandle;
+    bool bIsTaggingInFlight = false;
+    // 请求被取消时大模型库不回调，超过这么久还没回来就当它丢了
+    double TaggingStartTime = -1.0;
+    static constexpr double TaggingTimeoutSeconds = 120.0;
+
+    // 只留最近几条作为拆标签的上下文
+    void TrimShoutHistory();
     
     void RequestShoutCompression();
 
@@ -117,9 +168,14 @@ public:
     FString JoinShoutHistory();
     
 private:
-    TSet<FString> PrintedLogPairs;
-    TMap<TPair<FName, FName>, float> SimilarityCache;
+    // 相似度缓存，同时用项上的标记给调试日志去重
+    FTASimilarityCache SimilarityCache;
 
 public:
-    float GetCachedCosineSimilarity(FName TagA, FName TagB, const FHighDimensionalVector& VectorA, const FHighDimensionalVector& VectorB);
+    float GetCachedCosineSimilarity(FName TagA, FName TagB, const FTAPackedEmbedding& VectorA, const FTAPackedEmbedding& VectorB);
+
+    const FTASimilarityCache& GetSimilarityCache() const { return SimilarityCache; }
+
+    // 剧情标签与预设前置标签的词嵌相似度超过它才算匹配
+    static constexpr float TagSimilarityThreshold = 0.62f;
 };
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 两个标签组成的无序键，(A,B)和(B,A)是同一个键
+ * 只存FName的索引和编号，不拼字符串
+ */
+struct TOBENOTLLMGAMEPLAY_API FTATagPairKey
+{
+	uint64 Low = 0;
+	uint64 High = 0;
+
+	FTATagPairKey() {}
+	FTATagPairKey(const FName& TagA, const FName& TagB);
+
+	uint32 GetHash() const;
+
+	bool operator==(const FTATagPairKey& Other) const
+	{
+		return Low == Other.Low && High == Other.High;
+	}
+};
+
+/**
+ * 固定容量的标签相似度缓存
+ * 线性探测的开放寻址表，满了之后用CLOCK算法淘汰最近没被访问过的项，内存不会随标签数的平方增长
+ */
+class TOBENOTLLMGAMEPLAY_API FTASimilarityCache
+{
+public:
+	explicit FTASimilarityCache(int32 InCapacity = 8192);
+
+	// 命中时返回true并写入OutSimilarity
+	bool Find(const FTATagPairKey& Key, float& OutSimilarity);
+
+	void Add(const FTATagPairKey& Key, float Similarity);
+
+	// 给缓存中的项打上已打印日志的标记，第一次标记时返回true。项不存在时返回false
+	bool MarkLogged(const FTATagPairKey& Key);
+
+	void Reset();
+
+	int32 Num() const { return NumEntries; }
+	int32 GetCapacity() const { return Capacity; }
+	uint64 GetHits() const { return Hits; }
+	uint64 GetMisses() const { return Misses; }
+	uint64 GetEvictions() const { return Evictions; }
+	float GetHitRate() const;
+	FString GetStatsString() const;
+
+private:
+	struct FEntry
+	{
+		FTATagPairKey Key;
+		uint32 Hash = 0;
+		float Similarity = 0.f;
+		bool bOccupied = false;
+		// CLOCK的访问位
+		bool bReferenced = false;
+		bool bLogged = false;
+	};
+
+	TArray<FEntry> Slots;
+	uint32 SlotMask = 0;
+	int32 Capacity = 0;
+	int32 NumEntries = 0;
+	uint32 ClockHand = 0;
+
+	uint64 Hits = 0;
+	uint64 Misses = 0;
+	uint64 Evictions = 0;
+
+	int32 FindSlot(const FTATagPairKey& Key, uint32 Hash) const;
+	void EvictOne();
+	// 删除后把后面同一探测链上的项往前挪，保证线性探测不断链
+	void RemoveAt(uint32 SlotIndex);
+};
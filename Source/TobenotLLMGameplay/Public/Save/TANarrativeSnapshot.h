@@ -0,0 +1,69 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TANarrativeSnapshot.h
+// 事件池和剧情标签的紧凑二进制快照
+// 布局：魔数 | 版本 | 名字表 | 正文。整数都是变长编码，FName只在名字表里存一次，正文里存下标
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class TOBENOTLLMGAMEPLAY_API FTASnapshotWriter
+{
+public:
+	void WriteUInt(uint64 Value);
+	// ZigZag编码，小的负数也只占一两个字节
+	void WriteInt(int64 Value);
+	void WriteBool(bool bValue) { Body.Add(bValue ? 1 : 0); }
+	void WriteString(const FString& Value);
+	void WriteName(FName Value);
+	void WriteGuid(const FGuid& Value);
+	// 原样存4个字节
+	void WriteFloat(float Value);
+
+	// 拼上魔数、版本和名字表，输出完整快照
+	void Finish(TArray<uint8>& OutBytes) const;
+
+private:
+	TArray<uint8> Body;
+	TArray<FName> Names;
+	TMap<FName, int32> NameIndices;
+
+	static void AppendUInt(TArray<uint8>& Bytes, uint64 Value);
+	static void AppendString(TArray<uint8>& Bytes, const FString& Value);
+};
+
+// 读取时只顺序扫一遍字节数组，任何越界或格式错误都会让IsValid变成false，之后读到的都是默认值
+class TOBENOTLLMGAMEPLAY_API FTASnapshotReader
+{
+public:
+	explicit FTASnapshotReader(const TArray<uint8>& InBytes);
+
+	bool IsValid() const { return bValid; }
+	uint32 GetVersion() const { return Version; }
+
+	uint64 ReadUInt();
+	int64 ReadInt();
+	bool ReadBool();
+	FString ReadString();
+	FName ReadName();
+	FGuid ReadGuid();
+	float ReadFloat();
+
+	// 读数组长度，超过剩余字节数的一律当作损坏，防止按坏数据去分配内存
+	int32 ReadCount();
+
+private:
+	const TArray<uint8>& Bytes;
+	int32 Offset = 0;
+	uint32 Version = 0;
+	bool bValid = true;
+	TArray<FName> Names;
+};
+
+namespace TANarrativeSnapshot
+{
+	// 快照格式改了就加一，读到不认识的版本直接放弃
+	// 2：事件池前面加了运行时位点
+	constexpr uint32 CurrentVersion = 2;
+}
@@ -27,4 +27,12 @@ public:
 	
 	UPROPERTY(VisibleAnywhere, Category = "Chat")
 	TMap<FGuid, FTAChatComponentSaveData> TAChatDataMap;
+
+	// 事件池和剧情记录的二进制快照，格式见TANarrativeSnapshot.h
+	UPROPERTY(VisibleAnywhere, Category = "Narrative")
+	TArray<uint8> NarrativeSnapshot;
+
+	// 快照对应的关卡，读档时关卡不一致就不恢复
+	UPROPERTY(VisibleAnywhere, Category = "Narrative")
+	FString NarrativeSnapshotLevelName;
 };
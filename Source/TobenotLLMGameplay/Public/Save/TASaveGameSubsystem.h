@@ -35,6 +35,11 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveGame")
 	void StoreAllTAData();
 
+	// 从存档恢复事件池和剧情记录，要在RestoreNameTAGuidMap之后、事件子系统Start之前调用
+	// 返回true说明恢复成功，不需要再生成事件
+	UFUNCTION(BlueprintCallable, Category = "SaveGame")
+	bool RestoreNarrativeState();
+
 	// 现在是每个actor生成时自己来拿存档
 	//UFUNCTION(BlueprintCallable, Category = "SaveGame")
 	//void RestoreAllTAData();
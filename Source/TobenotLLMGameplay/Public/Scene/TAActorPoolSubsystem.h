@@ -0,0 +1,90 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TAActorPoolSubsystem.h
+// 场景Actor的对象池：配置里的类只解析一次，用完的Actor隐藏起来放回池里，批量生成时分帧进行
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TAActorPoolSubsystem.generated.h"
+
+USTRUCT()
+struct FTAActorPoolBucket
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<AActor*> Actors;
+};
+
+UCLASS()
+class TOBENOTLLMGAMEPLAY_API UTAActorPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// 从UTASettings解析好的类，没配置或加载失败时是默认类
+	UClass* GetPlaceActorClass() const { return PlaceActorClass; }
+	UClass* GetInteractiveActorClass() const { return InteractiveActorClass; }
+	UClass* GetInteractionComponentClass() const { return InteractionComponentClass; }
+
+	// 取一个Actor：池里有同类的就复用，没有就当场生成
+	AActor* AcquireActor(UClass* Class, const FTransform& Transform);
+
+	template<typename T>
+	T* AcquireActor(UClass* Class, const FTransform& Transform)
+	{
+		return Cast<T>(AcquireActor(Class, Transform));
+	}
+
+	// 放回池里，这一类已经存满时直接销毁
+	void ReleaseActor(AActor* Actor);
+
+	// 批量取Actor，交给分帧执行器每步取一个，取到后调用OnAcquired（下标和Transforms对应）
+	void AcquireActorsAmortized(const UObject* Owner, UClass* Class, TArray<FTransform>&& Transforms, TFunction<void(AActor*, int32)> OnAcquired);
+
+	// 分帧预先生成Num个隐藏的Actor放进池里
+	void Prewarm(UClass* Class, int32 Num);
+
+	int32 GetNumPooled(UClass* Class) const;
+
+	FString GetReportString() const;
+	void ResetStats();
+
+private:
+	UPROPERTY()
+	UClass* PlaceActorClass;
+
+	UPROPERTY()
+	UClass* InteractiveActorClass;
+
+	UPROPERTY()
+	UClass* InteractionComponentClass;
+
+	UPROPERTY()
+	TMap<UClass*, FTAActorPoolBucket> Pools;
+
+	int32 MaxPooledPerClass = 16;
+	double SpawnHitchThresholdMs = 1.0;
+
+	AActor* SpawnNewActor(UClass* Class, const FTransform& Transform);
+	static void DeactivateActor(AActor* Actor);
+
+	struct FPoolStats
+	{
+		int32 Spawned = 0;
+		int32 Reused = 0;
+		int32 Released = 0;
+		int32 Destroyed = 0;
+		// 单次生成超过SpawnHitchThresholdMs的次数
+		int32 SpawnHitches = 0;
+		double MaxSpawnMs = 0.0;
+		double TotalSpawnMs = 0.0;
+	};
+	FPoolStats Stats;
+};
@@ -20,12 +20,57 @@ public:
 	// 加载区域地图时调用，生成交互点
 	void LoadAreaScene(const FTAEventInfo& EventInfo);
 
+	// 卸载区域地图，交互物放回Actor池
+	void UnloadAreaScene();
+
+	// 休眠：交互物的信息、位置和聊天记录存成压缩快照，Actor放回池里。
+	// 还有交互物在生成中、在对话里或者有聊天请求在途时不休眠
+	bool Hibernate();
+
+	// 按快照分帧重建交互物
+	void Rehydrate();
+
+	bool IsHibernating() const { return bIsHibernating; }
+	
+	// 区域中心，交互物生成出来之前无效
+	bool GetSceneCenter(FVector& OutCenter) const;
+
+	int32 GetHibernatedBytes() const { return HibernatedBlob.Num(); }
+
 protected:
+	// 交互物还在对话里或者聊天请求没回来
+	static bool IsInteractableBusy(const AActor* InteractiveActor);
+
+	// 解析生成交互物的回复，纯数据，在工作线程调用
+	static bool ParseInteractablesFromJson(const FString& Content, TArray<FInteractableInfo>& OutInteractables);
+
+	// 游戏线程，按InteractablesArray在事件位点周围生成交互物
+	void SpawnInteractables(const FTAEventInfo& EventInfo);
+	
 	// 存储所有生成的交互点actors
 	TArray<ATAInteractiveActor*> InteractiveActors;
 	
 	TArray<FInteractableInfo> InteractablesArray;
 
+	// 交互物所属事件的描述，重建时写回交互组件
+	FString EventDescription;
+
+	FVector SceneCenter = FVector::ZeroVector;
+	bool bHasSceneCenter = false;
+
+	// 已提交给Actor池、还没生成出来的交互物数量
+	int32 NumPendingSpawns = 0;
+	// 卸载时加一，之前提交的分帧生成作废，之后取到的Actor直接放回池里
+	int32 SpawnGeneration = 0;
+
+	bool bIsHibernating = false;
+	// 压缩后的休眠快照和压缩前的大小
+	TArray<uint8> HibernatedBlob;
+	int32 HibernatedRawSize = 0;
+
+	// 生成或重建交互物时每个Actor取到后的处理，生成已经作废时放回池里并返回false
+	bool OnInteractiveActorAcquired(AActor* Actor, const FInteractableInfo& Info, int32 Generation);
+
 private:
 	UPROPERTY()
 	class UOpenAIChat* CacheChat;
@@ -9,6 +9,7 @@
 #include "Chat/TAChatComponent.h"
 #include "Agent/TAAgentInterface.h"
 #include "Save/TAGuidInterface.h"
+#include "Scene/TAPoolableInterface.h"
 #include "TAInteractiveActor.generated.h"
 
 class UTADialogueComponent;
@@ -21,6 +22,7 @@ UCLASS()
 class TOBENOTLLMGAMEPLAY_API ATAInteractiveActor : public AActor
 	,public ITAAgentInterface
 	,public ITAGuidInterface
+	,public ITAPoolableInterface
 {
 	GENERATED_BODY()
 	virtual void OnConstruction(const FTransform& Transform) override;
@@ -60,6 +62,9 @@ protected:
 
 	virtual int32 GetAgentSpeakPriority() const override{return 150;}; //交互物先说
 
+	// 放回池里时清掉交互物信息和聊天、对话记录
+	virtual void OnReleasedToPool() override;
+
 public:
 	UFUNCTION(BlueprintCallable, Category = "TAInteractiveActor")
 	UTAInteractionComponent* GetInteractionComponent() const;
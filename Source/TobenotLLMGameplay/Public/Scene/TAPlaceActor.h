@@ -6,6 +6,7 @@
 #include "GameFramework/Actor.h"
 #include "Components/SphereComponent.h"
 #include "Save/TAGuidInterface.h"
+#include "Scene/TAPoolableInterface.h"
 #include "UObject/NoExportTypes.h"
 #include "TAPlaceActor.generated.h"
 
@@ -16,6 +17,7 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnTextureChanged, UTexture2DDynamic
 UCLASS()
 class TOBENOTLLMGAMEPLAY_API ATAPlaceActor : public AActor
     , public ITAGuidInterface
+    , public ITAPoolableInterface
 {
     GENERATED_BODY()
 
@@ -48,13 +50,13 @@ protected:
     virtual void BeginPlay() override;
 
 public:
-    // Called every frame
-    virtual void Tick(float DeltaTime) override;
-
     void SetPlaceRadius(float Radius);
     void SetPlaceName(const FString& NewName);
     void SetPlaceTexture(UTexture2DDynamic* NewTexture);
 
+    // Clears name, texture and GUID registration before the actor goes back to the pool
+    virtual void OnReleasedToPool() override;
+
     // Used to show the place's area of effect
     UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Place")
     class USphereComponent* AreaDisplaySphere;
@@ -0,0 +1,25 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "TAPoolableInterface.generated.h"
+
+UINTERFACE(BlueprintType, NotBlueprintable)
+class UTAPoolableInterface : public UInterface
+{
+	GENERATED_BODY()
+};
+
+// 可以放进UTAActorPoolSubsystem复用的Actor实现这个接口，在这里清掉上一次使用留下的状态
+class TOBENOTLLMGAMEPLAY_API ITAPoolableInterface
+{
+	GENERATED_BODY()
+public:
+	// 从池里取出、重新显示之后调用，新生成的Actor不会调用
+	virtual void OnAcquiredFromPool() {}
+
+	// 放回池里、隐藏之前调用
+	virtual void OnReleasedToPool() {}
+};
@@ -0,0 +1,79 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TARegionIndex.h
+// 有名字的区域（位点）的空间索引。每个区域记录它里面发生过的内容，内容一变版本号就加一，
+// 描述文本带着生成时的版本号，版本对不上就说明描述过期了，需要在后台重新生成
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FTARegion
+{
+	FString Name;
+	FVector2D Center = FVector2D::ZeroVector;
+	float Radius = 0.f;
+	// 关卡里摆好的区域，会出现在整张地图的介绍里
+	bool bFromLevel = false;
+
+	// 区域里发生过的内容，只保留最近的若干条
+	TArray<FString> Facts;
+	uint32 ContentVersion = 1;
+
+	// 当前描述对应的内容版本，和ContentVersion不同说明描述过期了
+	uint32 DescribedVersion = 0;
+	FString Description;
+
+	bool IsDescriptionStale() const { return DescribedVersion != ContentVersion; }
+};
+
+class TOBENOTLLMGAMEPLAY_API FTARegionIndex
+{
+public:
+	int32 AddRegion(const FString& Name, const FVector2D& Center, float Radius, bool bFromLevel);
+	void RemoveRegion(int32 RegionId);
+
+	// 找包含这个点的区域，有多个时取半径最小、最具体的那个。只查点所在的一个格子
+	int32 FindRegionAt(const FVector2D& Point) const;
+
+	const FTARegion* GetRegion(int32 RegionId) const { return Regions.Find(RegionId); }
+
+	// 记一条区域内容，内容版本加一。超过MaxFactsPerRegion时丢掉最旧的
+	bool AddFact(int32 RegionId, const FString& Fact);
+
+	// 只有版本还对得上时才写入，生成期间内容又变了的话这次结果作废
+	bool SetDescription(int32 RegionId, uint32 ContentVersion, const FString& Description);
+
+	// 找一个描述过期的区域，没有返回INDEX_NONE
+	int32 FindStaleRegion() const;
+
+	// 没有生成好的描述时，直接用名字和内容拼一段
+	static FString ComposeDescription(const FTARegion& Region);
+
+	template<typename FunctorType>
+	void ForEachRegion(FunctorType&& Functor) const
+	{
+		for (const TPair<int32, FTARegion>& Pair : Regions)
+		{
+			Functor(Pair.Key, Pair.Value);
+		}
+	}
+
+	int32 Num() const { return Regions.Num(); }
+
+	// 只能在添加区域之前设置
+	void SetCellSize(float InCellSize) { CellSize = FMath::Max(100.f, InCellSize); }
+
+	static constexpr int32 MaxFactsPerRegion = 8;
+
+private:
+	float CellSize = 4000.f;
+	int32 NextRegionId = 0;
+	TMap<int32, FTARegion> Regions;
+
+	// 区域登记到它覆盖的所有格子里，查询时只看点所在的格子
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	FIntPoint GetCell(const FVector2D& Location) const;
+	void ForEachCoveredCell(const FVector2D& Center, float Radius, TFunctionRef<void(const FIntPoint&)> Functor) const;
+};
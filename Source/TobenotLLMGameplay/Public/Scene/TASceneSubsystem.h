@@ -3,12 +3,32 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Scene/TARegionIndex.h"
+#include "Scene/TASiteAllocator.h"
+#include "Common/TAPromptDefinitions.h"
 #include "Subsystems/WorldSubsystem.h"
 #include "TASceneSubsystem.generated.h"
 
 class UTAAreaScene;
 class ATAPlaceActor;
+class FTASnapshotWriter;
+class FTASnapshotReader;
 struct FTAEventInfo;
+class ANavigationData;
+
+// 一次导航点查询。bProjectOnly为true时把Origin投影到导航网格上（Radius作为水平范围），否则在Radius内取一个随机可达点
+struct FTANavPointQuery
+{
+	FVector Origin = FVector::ZeroVector;
+	float Radius = 0.f;
+	bool bProjectOnly = false;
+};
+
+// 结果和查询一一对应，没找到的为空
+using FTANavPointsCallback = TFunction<void(const TArray<TOptional<FVector>>&)>;
+// 位点和事件一一对应，没找到的为空
+using FTAEventSitesCallback = TFunction<void(const TArray<ATAPlaceActor*>&)>;
+
 /**
  * 
  */
@@ -18,24 +38,46 @@ class TOBENOTLLMGAMEPLAY_API UTASceneSubsystem : public UWorldSubsystem
 	GENERATED_BODY()
 
 public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	
 	// 在地图上生成怪物，请在gamemode中适当的时候调用
 	UFUNCTION(BlueprintCallable, Category = "Scene")
 	void PopulateMapWithMonsters(const TArray<FVector>& ForbiddenLocations);
 	
-	// 查询当前关卡的人文、地理信息
+	// 查询当前关卡的人文、地理信息：基础介绍加上关卡里摆好的位点。运行时生成的位点不放进来，避免场景信息频繁变化
 	FString QuerySceneMapInfo();
 
-	// 查询指定位置所在的区域地点
+	// 查询指定位置所在的区域地点，返回缓存的区域描述，描述过期时在后台重新生成
 	FString QueryLocationInfo(const FVector& Location);
 
+	// 记录某个位置所在区域里发生的内容，区域描述会在后台更新
+	void AddRegionFact(const FVector& Location, const FString& Fact);
+
 	// 根据事件信息查询推荐的事件位置
 	UFUNCTION(BlueprintCallable, Category = "Scene")
 	ATAPlaceActor* QueryEventLocationByInfo(const FTAEventInfo& EventInfo);
 	
+	// 同时为多个事件选位点，共用一批导航查询，选好后回调
+	void QueryEventLocationsAsync(const TArray<FTAEventInfo>& EventInfos, FTAEventSitesCallback&& OnComplete);
+
+	// 批量异步导航点查询。同一帧提交的查询合成一批，在分帧执行器里做，整个请求做完后回调
+	void QueryNavigablePointsAsync(TArray<FTANavPointQuery>&& Queries, FTANavPointsCallback&& OnComplete);
+	
 	// 创建并添加新的位点到列表中，返回创建的位点Actor
 	UFUNCTION(BlueprintCallable, Category = "Scene")
 	ATAPlaceActor* CreateAndAddPlace(const FVector& Location, float Radius, const FString& Name);
 
+	// 移除位点，Actor放回池里复用
+	UFUNCTION(BlueprintCallable, Category = "Scene")
+	void RemovePlace(ATAPlaceActor* PlaceActor);
+
+	// 运行时创建的位点写进叙事快照，生成的事件靠LocationGuid找到它们
+	void WritePlacesSnapshot(FTASnapshotWriter& Writer) const;
+	// 按快照重建位点并沿用原来的Guid，要在恢复事件池之前调用
+	// 整段读完校验通过才创建，创建出来的位点放进OutRestoredPlaces，后面恢复失败时由调用方RemovePlace
+	bool ReadPlacesSnapshot(FTASnapshotReader& Reader, TArray<ATAPlaceActor*>& OutRestoredPlaces);
+
 	// 创建并返回一个UTAAreaScene实例的函数，同时加载区域地图
 	UTAAreaScene* CreateAndLoadAreaScene(const FTAEventInfo& EventInfo);
 
@@ -48,8 +90,78 @@ private:
 	
 	int32 MaxQueryEventLocationRetryCount = 100;
 
+	// 已创建过的位点数，用来生成不重复的Guid名字，位点被移除后也不回退
+	int32 NumCreatedPlaces = 0;
+
+	// 取Actor、登记占用和区域，不分配Guid
+	ATAPlaceActor* SpawnPlace(const FVector& Location, float Radius, const FString& Name);
+
+	// 预计算的候选位点和已占用位点网格
+	FTASiteAllocator SiteAllocator;
+	bool bIsGeneratingSites = false;
+
+	// 在工作线程里按关卡导航范围生成候选位点
+	void StartSiteGeneration();
+
+	// 导航范围取不到时退回旧的写死范围
+	FBox2D GetSiteBounds() const;
+
+	// 为一个事件准备位点查询：优先取候选点，候选点没生成好或者用完时退回范围内随机
+	void BuildEventSiteQuery(FTANavPointQuery& OutQuery, float& OutRadius);
+
+	// 查询结果可用且不和已有位点重叠时创建位点
+	ATAPlaceActor* TryCreateEventSite(const TOptional<FVector>& NavLocation, float Radius, const FTAEventInfo& EventInfo);
+
+	struct FEventSiteRequest
+	{
+		TArray<FTAEventInfo> EventInfos;
+		TArray<ATAPlaceActor*> Places;
+		FTAEventSitesCallback OnComplete;
+		int32 RetryCount = 0;
+	};
+	void DispatchEventSiteQueries(const TSharedRef<FEventSiteRequest>& Request);
+
+	struct FNavPointRequest
+	{
+		TArray<FTANavPointQuery> Queries;
+		TArray<TOptional<FVector>> Results;
+		FTANavPointsCallback OnComplete;
+	};
+	TArray<FNavPointRequest> PendingNavRequests;
+	bool bIsNavQueryScheduled = false;
+	
+	// 分帧执行时每步最多做几次导航查询
+	int32 NavQueriesPerStep = 16;
+
+	// 按顺序推进待处理的查询，返回true表示全部做完
+	bool ProcessNavRequests();
+	
+	const ANavigationData* GetNavData() const;
+	static TOptional<FVector> RunNavPointQuery(const ANavigationData& NavData, const FTANavPointQuery& Query);
+
+	UPROPERTY()
 	TMap<int32, UTAAreaScene*> AreaScenesMap;
 
+	// 位点的区域索引和描述缓存
+	FTARegionIndex RegionIndex;
+	TMap<const ATAPlaceActor*, int32> PlaceRegionIds;
+	FString CachedSceneMapInfo;
+
+	// 一次只总结一个区域，内容连续变化时等一会儿再发
+	FTimerHandle RegionDescribeTimerHandle;
+	bool bIsDescribingRegion = false;
+	void ScheduleRegionDescriptions();
+	void DescribeStaleRegions();
+
+	// 关卡里摆好的位点登记到区域索引和位点网格里
+	void RegisterLevelPlaces();
+
+	static const FTAPrompt PromptSummarizeRegion;
+
+	// 定时按玩家距离让区域场景休眠或重建，内存里只留玩家附近的交互物
+	FTimerHandle AreaStreamingTimerHandle;
+	void UpdateAreaSceneStreaming();
+
 	bool bHasPopulateMapWithMonsters = false;
 	
 	UClass* GetMonsterClass() const;
@@ -0,0 +1,53 @@
+// Copyright (c) 2024 tobenot, See LICENSE in the project root for license information.
+
+// TASiteAllocator.h
+// 事件位点分配：预先按泊松圆盘采样出一批候选点，已占用的位点放进均匀网格
+// 候选点之间的距离不小于两倍最大位点半径，所以候选点之间天然不重叠，只需要和网格里的已有位点比
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class TOBENOTLLMGAMEPLAY_API FTASiteAllocator
+{
+public:
+	// Bridson泊松圆盘采样，纯计算，可以在工作线程调用
+	static void GeneratePoissonDisk(const FBox2D& Bounds, float MinDistance, int32 Seed, TArray<FVector2D>& OutPoints, int32 MaxAttemptsPerPoint = 30);
+
+	// 设置候选点并打乱顺序，之后按顺序发放
+	void SetCandidates(TArray<FVector2D>&& InCandidates, int32 Seed);
+
+	bool HasCandidates() const { return FreeCandidates.Num() > 0; }
+	bool IsReady() const { return bReady; }
+	int32 GetNumFreeCandidates() const { return FreeCandidates.Num(); }
+
+	// 取出一个候选点。有偏好位置时取离它最近的一个（只在需要时用，是O(N)）
+	bool TakeCandidate(FVector2D& OutPoint, const FVector2D* PreferredLocation = nullptr);
+
+	// 登记一个已占用的位点，所有位点（包括手动放的）都要登记
+	void AddOccupied(const FVector& Center, float Radius);
+
+	// 位点被回收时取消登记，MaxOccupiedRadius不回缩，只会让检查范围偏大
+	void RemoveOccupied(const FVector& Center, float Radius);
+
+	// 检查和已占用位点是否重叠，只查附近几个格子
+	bool IsOverlapping(const FVector& Center, float Radius) const;
+
+	void SetCellSize(float InCellSize) { CellSize = FMath::Max(100.f, InCellSize); }
+
+private:
+	struct FOccupiedSite
+	{
+		FVector2D Center;
+		float Radius;
+	};
+
+	float CellSize = 3000.f;
+	float MaxOccupiedRadius = 0.f;
+	bool bReady = false;
+	
+	TArray<FVector2D> FreeCandidates;
+	TMap<FIntPoint, TArray<FOccupiedSite>> OccupiedCells;
+
+	FIntPoint GetCell(const FVector2D& Location) const;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "TAPromptSetting.h"
+#include "Common/TAEmbeddingVector.h"
 #include "Engine/DeveloperSettings.h"
 #include "TASettings.generated.h"
 
@@ -20,6 +21,30 @@ public:
 	UPROPERTY(config, EditAnywhere, Category="Event")
 	FSoftClassPath EventGeneratorClass;
 
+	// 靠近位点触发事件的空间网格边长（厘米），最好比常见的位点半径大一些
+	UPROPERTY(config, EditAnywhere, Category="Event", meta = (ClampMin = "100"))
+	float ProximityGridCellSize = 2000.f;
+
+	// 后台预生成并储备的事件数量，0表示不预生成。开启后会在后台定期调用大模型补货
+	UPROPERTY(config, EditAnywhere, Category="Event", meta = (ClampMin = "0"))
+	int32 EventReserveDepth = 0;
+
+	// 储备事件最长保留时间（秒），超过后丢弃重新生成。场景信息变化时储备也会作废
+	UPROPERTY(config, EditAnywhere, Category="Event", meta = (ClampMin = "0"))
+	float EventReserveMaxAgeSeconds = 600.f;
+
+	// 检查并补充储备的间隔（秒），一次只会有一个补货请求
+	UPROPERTY(config, EditAnywhere, Category="Event", meta = (ClampMin = "1"))
+	float EventReserveRefillInterval = 10.f;
+
+	// 一次生成多个事件时，每个子请求最多生成几个，超过就拆成多个并发请求，0表示不拆（默认）
+	UPROPERTY(config, EditAnywhere, Category="Event", meta = (ClampMin = "0"))
+	int32 EventGenerationMaxEventsPerRequest = 0;
+
+	// 拆分后同时在途的子请求上限
+	UPROPERTY(config, EditAnywhere, Category="Event", meta = (ClampMin = "1"))
+	int32 EventGenerationMaxConcurrentRequests = 3;
+
 	// 设置要使用的ATAPlaceActor的子类的类名。
 	UPROPERTY(config, EditAnywhere, Category="Scene")
 	FSoftClassPath PlaceActorClass;
@@ -36,7 +61,91 @@ public:
 	UPROPERTY(config, EditAnywhere, Category="Event")
 	FSoftClassPath InteractionComponentClass;
 	
+	// 事件位点半径范围，位点候选点按两倍最大半径做泊松圆盘采样
+	UPROPERTY(config, EditAnywhere, Category = "Scene", meta = (ClampMin = "100"))
+	float EventSiteMinRadius = 1000.f;
+
+	UPROPERTY(config, EditAnywhere, Category = "Scene", meta = (ClampMin = "100"))
+	float EventSiteMaxRadius = 1500.f;
+
+	// 整张地图的基础介绍，会和关卡里摆好的位点名字一起作为场景信息发给事件生成
+	UPROPERTY(config, EditAnywhere, Category = "Scene")
+	FString SceneMapDescription = TEXT("The Mushroom Village on the grassland, where the mushroom monsters are hostile, mushroom villagers may be friendly.");
+
+	// 查询的位置不在任何位点里时返回的描述
+	UPROPERTY(config, EditAnywhere, Category = "Scene")
+	FString DefaultLocationDescription = TEXT("High GrassLand");
+
+	// 位点内容变化后，是否在后台用大模型重新总结位点描述。关闭时直接用位点名字和内容拼接
+	UPROPERTY(config, EditAnywhere, Category = "Scene")
+	bool bSummarizeRegionDescriptions = true;
+
+	// 玩家离区域场景超过这个距离时，交互物存成快照并回收，0表示不休眠（默认）
+	UPROPERTY(config, EditAnywhere, Category = "Scene", meta = (ClampMin = "0"))
+	float AreaSceneHibernateDistance = 0.f;
+
+	// 玩家回到这个距离以内时重建交互物，比休眠距离小一些，避免在边界上来回切换
+	UPROPERTY(config, EditAnywhere, Category = "Scene", meta = (ClampMin = "0"))
+	float AreaSceneRehydrateDistance = 7000.f;
+
+	// 检查区域场景休眠的间隔（秒）
+	UPROPERTY(config, EditAnywhere, Category = "Scene", meta = (ClampMin = "0.1"))
+	float AreaSceneStreamingInterval = 1.f;
+
 	// 设置要使用的怪物类，UAActor类的子类
 	UPROPERTY(config, EditAnywhere, Category = "Scene")
 	FSoftClassPath MonsterClass;
+
+	// 词嵌向量在内存和磁盘上的存储精度。切换前可以用控制台命令 TA.Embedding.QuantizationReport 看一下召回率
+	UPROPERTY(config, EditAnywhere, Category = "Embedding")
+	ETAEmbeddingStorageMode EmbeddingStorageMode = ETAEmbeddingStorageMode::Float32;
+
+	// 词嵌向量保留的维度，0表示使用模型的完整输出（3072维）。剧情标签都是短词，256~1024维通常就够了，可以用控制台命令 TA.Embedding.Benchmark 对比
+	UPROPERTY(config, EditAnywhere, Category = "Embedding", meta = (ClampMin = "0"))
+	int32 EmbeddingDimensions = 0;
+
+	// 剧情标签相似度缓存最多保存的标签对数量，超出后淘汰最近没用到的
+	UPROPERTY(config, EditAnywhere, Category = "Embedding", meta = (ClampMin = "16"))
+	int32 SimilarityCacheCapacity = 8192;
+
+	// 剧情拆标签的防抖时间（秒），这段时间内没有新消息才发请求，0表示每条消息立即处理
+	UPROPERTY(config, EditAnywhere, Category = "Plot", meta = (ClampMin = "0"))
+	float PlotTaggingDebounceSeconds = 2.f;
+
+	// 攒够这么多条新消息就不再等防抖，直接发一次请求
+	UPROPERTY(config, EditAnywhere, Category = "Plot", meta = (ClampMin = "1"))
+	int32 PlotTaggingMaxBatchLines = 8;
+
+	// 去掉标点后字数少于它的消息当作闲聊，不拆标签。0表示不按长度过滤（默认）
+	// "好""行""不"这种短回答往往就是接受或拒绝任务，按长度过滤会把它们丢掉
+	UPROPERTY(config, EditAnywhere, Category = "Plot", meta = (ClampMin = "0"))
+	int32 PlotChatterMinLength = 0;
+
+	// 去掉标点后和这些完全一样的消息当作闲聊，不拆标签。只放纯寒暄，"好的""是的"这类应答可能是剧情相关的回答，不要放进来
+	UPROPERTY(config, EditAnywhere, Category = "Plot")
+	TArray<FString> PlotChatterPhrases = {
+		TEXT("你好"), TEXT("您好"), TEXT("谢谢"), TEXT("哈哈哈"), TEXT("再见"),
+		TEXT("hello"), TEXT("thanks"), TEXT("bye")
+	};
+
+	// 对话流水线：当前发言者的回复一到就提前请求下一位发言者的回复，轮到它时对话记录没变才采用，否则丢弃重来
+	// 能省掉大部分轮次之间的等待，代价是被打断时多花一次请求。用控制台命令 TA.Dialogue.Report 查看采用和丢弃次数
+	UPROPERTY(config, EditAnywhere, Category = "Dialogue")
+	bool bPipelineDialogueTurns = false;
+
+	// 分帧执行器每帧最多占用的游戏线程时间（毫秒），超出的工作留到下一帧。用控制台命令 TA.FrameBudget.Report 查看各系统超预算情况
+	UPROPERTY(config, EditAnywhere, Category = "Performance", meta = (ClampMin = "0.1"))
+	float FrameBudgetMilliseconds = 2.f;
+
+	// 场景Actor池每个类最多保留的空闲Actor数量，超出的放回时直接销毁
+	UPROPERTY(config, EditAnywhere, Category = "Performance", meta = (ClampMin = "0"))
+	int32 ActorPoolMaxPerClass = 16;
+
+	// 开局时分帧预先生成的交互物数量，0表示不预热
+	UPROPERTY(config, EditAnywhere, Category = "Performance", meta = (ClampMin = "0"))
+	int32 ActorPoolPrewarmInteractiveActors = 0;
+
+	// 单个Actor生成超过这个时间（毫秒）记一次卡顿，用控制台命令 TA.ActorPool.Report 或 stat TAActorPool 查看
+	UPROPERTY(config, EditAnywhere, Category = "Performance", meta = (ClampMin = "0"))
+	float SpawnHitchThresholdMilliseconds = 1.f;
 };
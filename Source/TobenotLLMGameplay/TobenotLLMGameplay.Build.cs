@@ -52,6 +52,7 @@ public class TobenotLLMGameplay : ModuleRules
 				
 				"TobenotToolkit",
 				"NavigationSystem", // 场景系统用
+				"AssetRegistry", // 词嵌烘焙命令行查找数据表
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);